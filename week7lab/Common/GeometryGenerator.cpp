@@ -3,16 +3,122 @@
 //***************************************************************************************
 
 #include "GeometryGenerator.h"
+#include "TaskScheduler.h"
 #include <algorithm>
+#include <type_traits>
 
 using namespace DirectX;
 
+namespace
+{
+	// Target work per task when a generator splits its rows across threads.
+	const std::uint32_t VerticesPerTask = 4096;
+
+	// Maps an undirected edge to the index of its midpoint vertex.  Open addressing
+	// with linear probing over one flat array; the table is sized up front for the
+	// worst case of three distinct edges per triangle, so it never rehashes.
+	class EdgeMidpointCache
+	{
+	public:
+		explicit EdgeMidpointCache(size_t numTris)
+		{
+			size_t capacity = 16;
+			while(capacity < numTris*6)
+				capacity *= 2;
+
+			mMask = capacity - 1;
+			mSlots.resize(capacity, Slot{ EmptyKey, 0 });
+		}
+
+		// Returns the midpoint index already stored for edge (a, b), or stores and
+		// returns next if the edge has not been seen.
+		std::uint32_t FindOrInsert(std::uint32_t a, std::uint32_t b, std::uint32_t next)
+		{
+			if(a > b)
+				std::swap(a, b);
+
+			std::uint64_t key = ((std::uint64_t)a << 32) | b;
+			size_t k = (size_t)((key*0x9E3779B97F4A7C15ull) >> 32) & mMask;
+			for(;; k = (k + 1) & mMask)
+			{
+				Slot& slot = mSlots[k];
+				if(slot.Key == key)
+					return slot.Index;
+				if(slot.Key == EmptyKey)
+				{
+					slot.Key = key;
+					slot.Index = next;
+					return next;
+				}
+			}
+		}
+
+	private:
+		// a < b for every stored edge, so (~0, ~0) never occurs as a key.
+		static const std::uint64_t EmptyKey = ~0ull;
+
+		struct Slot
+		{
+			std::uint64_t Key;
+			std::uint32_t Index;
+		};
+
+		std::vector<Slot> mSlots;
+		size_t mMask = 0;
+	};
+}
+
+void GeometryGenerator::MeshData::ResizeIndices(size_t count)
+{
+	// Starting from an empty buffer zeroes the indices whichever width is chosen.
+	mIndexStride = Fits16BitIndices(Vertices.size()) ? sizeof(uint16) : sizeof(uint32);
+	mIndexCount = count;
+	mIndexData.clear();
+	mIndexData.resize(count*mIndexStride);
+}
+
+void GeometryGenerator::MeshData::AssignIndices(const uint32* indices, size_t count)
+{
+	ResizeIndices(count);
+	VisitIndices([&](auto* out)
+	{
+		typedef std::remove_pointer_t<decltype(out)> Index;
+		for(size_t i = 0; i < count; ++i)
+			out[i] = static_cast<Index>(indices[i]);
+	});
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
 {
     MeshData meshData;
 
+	MeshSize size = BoxSize(numSubdivisions);
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.ResizeIndices(size.IndexCount);
+	meshData.VisitIndices([&](auto* indices)
+	{
+		FillBox(width, height, depth, numSubdivisions, meshData.Vertices.data(), indices);
+	});
+
+    return meshData;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::BoxSize(uint32 numSubdivisions)const
+{
+	size_t cells = (size_t)1 << std::min(numSubdivisions, mMaxSubdivisions);
+
+	MeshSize size;
+	size.VertexCount = 6*(cells+1)*(cells+1);
+	size.IndexCount  = 6*cells*cells*6;
+	return size;
+}
+
+template<typename Index>
+void GeometryGenerator::FillBox(float width, float height, float depth, uint32 numSubdivisions,
+								Vertex* vertices, Index* indices)
+{
     //
-	// Create the vertices.
+	// Create the corner vertices of each face.
 	//
 
 	Vertex v[24];
@@ -57,53 +163,103 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
 	v[22] = Vertex(+w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
 	v[23] = Vertex(+w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
 
-	meshData.Vertices.assign(&v[0], &v[24]);
- 
-	//
-	// Create the indices.
-	//
-
-	uint32 i[36];
-
-	// Fill in the front face index data
-	i[0] = 0; i[1] = 1; i[2] = 2;
-	i[3] = 0; i[4] = 2; i[5] = 3;
-
-	// Fill in the back face index data
-	i[6] = 4; i[7]  = 5; i[8]  = 6;
-	i[9] = 4; i[10] = 6; i[11] = 7;
-
-	// Fill in the top face index data
-	i[12] = 8; i[13] =  9; i[14] = 10;
-	i[15] = 8; i[16] = 10; i[17] = 11;
+    // Put a cap on the number of subdivisions.
+    numSubdivisions = std::min<uint32>(numSubdivisions, mMaxSubdivisions);
 
-	// Fill in the bottom face index data
-	i[18] = 12; i[19] = 13; i[20] = 14;
-	i[21] = 12; i[22] = 14; i[23] = 15;
+	// Subdividing a face's triangles (0,1,2) and (0,2,3) numSubdivisions times gives
+	// a lattice of cells x cells quads, each split along the 0-2 diagonal, so every
+	// face is generated directly as a grid.  Rows step from corner 0 towards corner 1
+	// and columns towards corner 3.
+	uint32 cells = 1u << numSubdivisions;
+	uint32 side  = cells + 1;
+	float step   = 1.0f / cells;
 
-	// Fill in the left face index data
-	i[24] = 16; i[25] = 17; i[26] = 18;
-	i[27] = 16; i[28] = 18; i[29] = 19;
+	ParallelRows(6*side, side, [&](uint32 r0, uint32 r1)
+	{
+		for(uint32 r = r0; r < r1; ++r)
+		{
+			uint32 face = r / side;
+			uint32 t    = r % side;
+
+			const Vertex& c0 = v[face*4+0];
+			const Vertex& c1 = v[face*4+1];
+			const Vertex& c3 = v[face*4+3];
+
+			float a = t*step;
+			Vertex* row = vertices + (size_t)face*side*side + (size_t)t*side;
+			for(uint32 u = 0; u < side; ++u)
+			{
+				float b = u*step;
+				auto lerp = [a, b](float x0, float x1, float x3) { return x0 + a*(x1 - x0) + b*(x3 - x0); };
+
+				row[u].Position = XMFLOAT3(
+					lerp(c0.Position.x, c1.Position.x, c3.Position.x),
+					lerp(c0.Position.y, c1.Position.y, c3.Position.y),
+					lerp(c0.Position.z, c1.Position.z, c3.Position.z));
+				row[u].Normal   = c0.Normal;
+				row[u].TangentU = c0.TangentU;
+				row[u].TexC     = XMFLOAT2(
+					lerp(c0.TexC.x, c1.TexC.x, c3.TexC.x),
+					lerp(c0.TexC.y, c1.TexC.y, c3.TexC.y));
+			}
+
+			if(t == cells)
+				continue;
+
+			// Two triangles per quad, wound like the face's corner triangles.
+			uint32 base = face*side*side + t*side;
+			Index* out = indices + ((size_t)face*cells*cells + (size_t)t*cells)*6;
+			for(uint32 u = 0; u < cells; ++u)
+			{
+				uint32 i0 = base + u;
+				uint32 i1 = i0 + side;
+
+				uint32 quad[6] = { i0, i1, i1+1, i0, i1+1, i0+1 };
+				for(uint32 c = 0; c < 6; ++c)
+					out[c] = static_cast<Index>(quad[c]);
+				out += 6;
+			}
+		}
+	});
+}
 
-	// Fill in the right face index data
-	i[30] = 20; i[31] = 21; i[32] = 22;
-	i[33] = 20; i[34] = 22; i[35] = 23;
+void GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions, Vertex* vertices, uint32* indices)
+{
+	FillBox(width, height, depth, numSubdivisions, vertices, indices);
+}
 
-	meshData.Indices32.assign(&i[0], &i[36]);
+void GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions, Vertex* vertices, uint16* indices)
+{
+	FillBox(width, height, depth, numSubdivisions, vertices, indices);
+}
 
-    // Put a cap on the number of subdivisions.
-    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
+{
+    MeshData meshData;
 
-    for(uint32 i = 0; i < numSubdivisions; ++i)
-        Subdivide(meshData);
+	MeshSize size = SphereSize(sliceCount, stackCount);
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.ResizeIndices(size.IndexCount);
+	meshData.VisitIndices([&](auto* indices)
+	{
+		FillSphere(radius, sliceCount, stackCount, meshData.Vertices.data(), indices);
+	});
 
     return meshData;
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
+GeometryGenerator::MeshSize GeometryGenerator::SphereSize(uint32 sliceCount, uint32 stackCount)
 {
-    MeshData meshData;
+	MeshSize size;
+	size.VertexCount = 2 + (size_t)(stackCount-1)*(sliceCount+1);
+	size.IndexCount  = (size_t)(stackCount-1)*sliceCount*6;
+	return size;
+}
 
+template<typename Index>
+void GeometryGenerator::FillSphere(float radius, uint32 sliceCount, uint32 stackCount,
+								   Vertex* vertices, Index* indices)
+{
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
 	//
@@ -114,47 +270,78 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
 	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 
-	meshData.Vertices.push_back( topVertex );
+    uint32 ringVertexCount = sliceCount + 1;
+	uint32 southPoleIndex = 1 + (stackCount-1)*ringVertexCount;
+
+	vertices[0] = topVertex;
+	vertices[southPoleIndex] = bottomVertex;
 
 	float phiStep   = XM_PI/stackCount;
 	float thetaStep = 2.0f*XM_PI/sliceCount;
 
-	// Compute vertices for each stack ring (do not count the poles as rings).
-	for(uint32 i = 1; i <= stackCount-1; ++i)
-	{
-		float phi = i*phiStep;
+	// The top stack's indices come first, then the inner stacks, then the bottom stack.
+	Index* innerIndices  = indices + sliceCount*3;
+	Index* bottomIndices = innerIndices + (size_t)(stackCount-2)*sliceCount*6;
 
-		// Vertices of ring.
-        for(uint32 j = 0; j <= sliceCount; ++j)
+	// Compute vertices for each stack ring (do not count the poles as rings).  The
+	// task that builds ring i also builds the inner stack between rings i and i+1.
+	ParallelRows(stackCount-1, ringVertexCount, [&](uint32 r0, uint32 r1)
+	{
+		for(uint32 r = r0; r < r1; ++r)
 		{
-			float theta = j*thetaStep;
-
-			Vertex v;
-
-			// spherical to cartesian
-			v.Position.x = radius*sinf(phi)*cosf(theta);
-			v.Position.y = radius*cosf(phi);
-			v.Position.z = radius*sinf(phi)*sinf(theta);
-
-			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius*sinf(phi)*sinf(theta);
-			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius*sinf(phi)*cosf(theta);
-
-			XMVECTOR T = XMLoadFloat3(&v.TangentU);
-			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
-
-			XMVECTOR p = XMLoadFloat3(&v.Position);
-			XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
-
-			v.TexC.x = theta / XM_2PI;
-			v.TexC.y = phi / XM_PI;
-
-			meshData.Vertices.push_back( v );
+			uint32 i = r + 1;
+			float phi = i*phiStep;
+
+			// Vertices of ring.
+			Vertex* ring = vertices + 1 + (size_t)r*ringVertexCount;
+			for(uint32 j = 0; j <= sliceCount; ++j)
+			{
+				float theta = j*thetaStep;
+
+				Vertex v;
+
+				// spherical to cartesian
+				v.Position.x = radius*sinf(phi)*cosf(theta);
+				v.Position.y = radius*cosf(phi);
+				v.Position.z = radius*sinf(phi)*sinf(theta);
+
+				// Partial derivative of P with respect to theta
+				v.TangentU.x = -radius*sinf(phi)*sinf(theta);
+				v.TangentU.y = 0.0f;
+				v.TangentU.z = +radius*sinf(phi)*cosf(theta);
+
+				XMVECTOR T = XMLoadFloat3(&v.TangentU);
+				XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+
+				XMVECTOR p = XMLoadFloat3(&v.Position);
+				XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+
+				v.TexC.x = theta / XM_2PI;
+				v.TexC.y = phi / XM_PI;
+
+				ring[j] = v;
+			}
+
+			if(r >= stackCount-2)
+				continue;
+
+			// Offset the indices to the index of the first vertex in the first ring.
+			// This is just skipping the top pole vertex.
+			uint32 baseIndex = 1;
+			Index* out = innerIndices + (size_t)r*sliceCount*6;
+			for(uint32 j = 0; j < sliceCount; ++j)
+			{
+				out[0] = static_cast<Index>(baseIndex + r*ringVertexCount + j);
+				out[1] = static_cast<Index>(baseIndex + r*ringVertexCount + j+1);
+				out[2] = static_cast<Index>(baseIndex + (r+1)*ringVertexCount + j);
+
+				out[3] = static_cast<Index>(baseIndex + (r+1)*ringVertexCount + j);
+				out[4] = static_cast<Index>(baseIndex + r*ringVertexCount + j+1);
+				out[5] = static_cast<Index>(baseIndex + (r+1)*ringVertexCount + j+1);
+				out += 6;
+			}
 		}
-	}
-
-	meshData.Vertices.push_back( bottomVertex );
+	});
 
 	//
 	// Compute indices for top stack.  The top stack was written first to the vertex buffer
@@ -163,31 +350,9 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 
     for(uint32 i = 1; i <= sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(0);
-		meshData.Indices32.push_back(i+1);
-		meshData.Indices32.push_back(i);
-	}
-	
-	//
-	// Compute indices for inner stacks (not connected to poles).
-	//
-
-	// Offset the indices to the index of the first vertex in the first ring.
-	// This is just skipping the top pole vertex.
-    uint32 baseIndex = 1;
-    uint32 ringVertexCount = sliceCount + 1;
-	for(uint32 i = 0; i < stackCount-2; ++i)
-	{
-		for(uint32 j = 0; j < sliceCount; ++j)
-		{
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j+1);
-		}
+		indices[(i-1)*3+0] = static_cast<Index>(0);
+		indices[(i-1)*3+1] = static_cast<Index>(i+1);
+		indices[(i-1)*3+2] = static_cast<Index>(i);
 	}
 
 	//
@@ -195,31 +360,29 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	// and connects the bottom pole to the bottom ring.
 	//
 
-	// South pole vertex was added last.
-	uint32 southPoleIndex = (uint32)meshData.Vertices.size()-1;
-
 	// Offset the indices to the index of the first vertex in the last ring.
-	baseIndex = southPoleIndex - ringVertexCount;
-	
+	uint32 baseIndex = southPoleIndex - ringVertexCount;
+
 	for(uint32 i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(southPoleIndex);
-		meshData.Indices32.push_back(baseIndex+i);
-		meshData.Indices32.push_back(baseIndex+i+1);
+		bottomIndices[i*3+0] = static_cast<Index>(southPoleIndex);
+		bottomIndices[i*3+1] = static_cast<Index>(baseIndex+i);
+		bottomIndices[i*3+2] = static_cast<Index>(baseIndex+i+1);
 	}
-
-    return meshData;
 }
  
-void GeometryGenerator::Subdivide(MeshData& meshData)
+void GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, Vertex* vertices, uint32* indices)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
+	FillSphere(radius, sliceCount, stackCount, vertices, indices);
+}
 
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
+void GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, Vertex* vertices, uint16* indices)
+{
+	FillSphere(radius, sliceCount, stackCount, vertices, indices);
+}
 
+void GeometryGenerator::Subdivide(MeshData& meshData)
+{
 	//       v1
 	//       *
 	//      / \
@@ -230,48 +393,54 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 	// *-----*-----*
 	// v0    m2     v2
 
-	uint32 numTris = (uint32)inputCopy.Indices32.size()/3;
-	for(uint32 i = 0; i < numTris; ++i)
+	// The input vertices keep their indices; each distinct edge appends one midpoint.
+	// The new indices are built at 32 bits and narrowed once the vertex count is known.
+	size_t numTris = meshData.IndexCount()/3;
+	std::vector<uint32> inputIndices(numTris*3);
+	meshData.VisitIndices([&](const auto* indices)
 	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices32[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices32[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices32[i*3+2] ];
-
-		//
-		// Generate the midpoints.
-		//
-
-        Vertex m0 = MidPoint(v0, v1);
-        Vertex m1 = MidPoint(v1, v2);
-        Vertex m2 = MidPoint(v0, v2);
-
-		//
-		// Add new geometry.
-		//
-
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices32.push_back(i*6+0);
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+5);
+		std::copy(indices, indices + numTris*3, inputIndices.begin());
+	});
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+5);
+	EdgeMidpointCache midpoints(numTris);
 
-		meshData.Indices32.push_back(i*6+5);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+2);
+	// A closed mesh has 3/2 edges per triangle.
+	meshData.Vertices.reserve(meshData.Vertices.size() + numTris*3/2 + 3);
+	std::vector<uint32> outputIndices(numTris*12);
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+1);
-		meshData.Indices32.push_back(i*6+4);
+	auto midpoint = [&](uint32 a, uint32 b)
+	{
+		uint32 next = (uint32)meshData.Vertices.size();
+		uint32 index = midpoints.FindOrInsert(a, b, next);
+		if(index == next)
+			meshData.Vertices.push_back(MidPoint(meshData.Vertices[a], meshData.Vertices[b]));
+		return index;
+	};
+
+	uint32* out = outputIndices.data();
+	for(size_t i = 0; i < numTris; ++i)
+	{
+		uint32 v0 = inputIndices[i*3+0];
+		uint32 v1 = inputIndices[i*3+1];
+		uint32 v2 = inputIndices[i*3+2];
+
+		uint32 m0 = midpoint(v0, v1);
+		uint32 m1 = midpoint(v1, v2);
+		uint32 m2 = midpoint(v0, v2);
+
+		out[0] = v0; out[1]  = m0; out[2]  = m2;
+		out[3] = m0; out[4]  = m1; out[5]  = m2;
+		out[6] = m2; out[7]  = m1; out[8]  = v2;
+		out[9] = m0; out[10] = v1; out[11] = m1;
+		out += 12;
 	}
+
+	meshData.AssignIndices(outputIndices.data(), outputIndices.size());
+}
+
+void GeometryGenerator::SetMaxSubdivisions(uint32 maxSubdivisions)
+{
+	mMaxSubdivisions = maxSubdivisions < SubdivisionLimit ? maxSubdivisions : SubdivisionLimit;
 }
 
 GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Vertex& v1)
@@ -309,7 +478,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
     MeshData meshData;
 
 	// Put a cap on the number of subdivisions.
-    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+    numSubdivisions = std::min<uint32>(numSubdivisions, mMaxSubdivisions);
 
 	// Approximate a sphere by tessellating an icosahedron.
 
@@ -335,7 +504,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 	};
 
     meshData.Vertices.resize(12);
-    meshData.Indices32.assign(&k[0], &k[60]);
+    meshData.AssignIndices(k, 60);
 
 	for(uint32 i = 0; i < 12; ++i)
 		meshData.Vertices[i].Position = pos[i];
@@ -383,6 +552,30 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 {
     MeshData meshData;
 
+	MeshSize size = CylinderSize(sliceCount, stackCount);
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.ResizeIndices(size.IndexCount);
+	meshData.VisitIndices([&](auto* indices)
+	{
+		FillCylinder(bottomRadius, topRadius, height, sliceCount, stackCount, meshData.Vertices.data(), indices);
+	});
+
+    return meshData;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::CylinderSize(uint32 sliceCount, uint32 stackCount)
+{
+	// Side rings, then a ring plus a center vertex for each cap.
+	MeshSize size;
+	size.VertexCount = (size_t)(stackCount+1)*(sliceCount+1) + 2*((size_t)sliceCount+2);
+	size.IndexCount  = (size_t)stackCount*sliceCount*6 + (size_t)sliceCount*6;
+	return size;
+}
+
+template<typename Index>
+void GeometryGenerator::FillCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
+									 Vertex* vertices, Index* indices)
+{
 	//
 	// Build Stacks.
 	// 
@@ -394,90 +587,107 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 
 	uint32 ringCount = stackCount+1;
 
-	// Compute vertices for each stack ring starting at the bottom and moving up.
-	for(uint32 i = 0; i < ringCount; ++i)
-	{
-		float y = -0.5f*height + i*stackHeight;
-		float r = bottomRadius + i*radiusStep;
-
-		// vertices of ring
-		float dTheta = 2.0f*XM_PI/sliceCount;
-		for(uint32 j = 0; j <= sliceCount; ++j)
-		{
-			Vertex vertex;
-
-			float c = cosf(j*dTheta);
-			float s = sinf(j*dTheta);
-
-			vertex.Position = XMFLOAT3(r*c, y, r*s);
-
-			vertex.TexC.x = (float)j/sliceCount;
-			vertex.TexC.y = 1.0f - (float)i/stackCount;
-
-			// Cylinder can be parameterized as follows, where we introduce v
-			// parameter that goes in the same direction as the v tex-coord
-			// so that the bitangent goes in the same direction as the v tex-coord.
-			//   Let r0 be the bottom radius and let r1 be the top radius.
-			//   y(v) = h - hv for v in [0,1].
-			//   r(v) = r1 + (r0-r1)v
-			//
-			//   x(t, v) = r(v)*cos(t)
-			//   y(t, v) = h - hv
-			//   z(t, v) = r(v)*sin(t)
-			// 
-			//  dx/dt = -r(v)*sin(t)
-			//  dy/dt = 0
-			//  dz/dt = +r(v)*cos(t)
-			//
-			//  dx/dv = (r0-r1)*cos(t)
-			//  dy/dv = -h
-			//  dz/dv = (r0-r1)*sin(t)
-
-			// This is unit length.
-			vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
-
-			float dr = bottomRadius-topRadius;
-			XMFLOAT3 bitangent(dr*c, -height, dr*s);
-
-			XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
-			XMVECTOR B = XMLoadFloat3(&bitangent);
-			XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
-			XMStoreFloat3(&vertex.Normal, N);
-
-			meshData.Vertices.push_back(vertex);
-		}
-	}
-
 	// Add one because we duplicate the first and last vertex per ring
 	// since the texture coordinates are different.
 	uint32 ringVertexCount = sliceCount+1;
 
-	// Compute indices for each stack.
-	for(uint32 i = 0; i < stackCount; ++i)
+	// Compute vertices for each stack ring starting at the bottom and moving up.  The
+	// task that builds ring i also builds the indices of the stack above it.
+	ParallelRows(ringCount, ringVertexCount, [&](uint32 i0, uint32 i1)
 	{
-		for(uint32 j = 0; j < sliceCount; ++j)
+		for(uint32 i = i0; i < i1; ++i)
 		{
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
-
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
-			meshData.Indices32.push_back(i*ringVertexCount + j+1);
+			float y = -0.5f*height + i*stackHeight;
+			float r = bottomRadius + i*radiusStep;
+
+			// vertices of ring
+			Vertex* ring = vertices + (size_t)i*ringVertexCount;
+			float dTheta = 2.0f*XM_PI/sliceCount;
+			for(uint32 j = 0; j <= sliceCount; ++j)
+			{
+				Vertex vertex;
+
+				float c = cosf(j*dTheta);
+				float s = sinf(j*dTheta);
+
+				vertex.Position = XMFLOAT3(r*c, y, r*s);
+
+				vertex.TexC.x = (float)j/sliceCount;
+				vertex.TexC.y = 1.0f - (float)i/stackCount;
+
+				// Cylinder can be parameterized as follows, where we introduce v
+				// parameter that goes in the same direction as the v tex-coord
+				// so that the bitangent goes in the same direction as the v tex-coord.
+				//   Let r0 be the bottom radius and let r1 be the top radius.
+				//   y(v) = h - hv for v in [0,1].
+				//   r(v) = r1 + (r0-r1)v
+				//
+				//   x(t, v) = r(v)*cos(t)
+				//   y(t, v) = h - hv
+				//   z(t, v) = r(v)*sin(t)
+				// 
+				//  dx/dt = -r(v)*sin(t)
+				//  dy/dt = 0
+				//  dz/dt = +r(v)*cos(t)
+				//
+				//  dx/dv = (r0-r1)*cos(t)
+				//  dy/dv = -h
+				//  dz/dv = (r0-r1)*sin(t)
+
+				// This is unit length.
+				vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
+
+				float dr = bottomRadius-topRadius;
+				XMFLOAT3 bitangent(dr*c, -height, dr*s);
+
+				XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
+				XMVECTOR B = XMLoadFloat3(&bitangent);
+				XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
+				XMStoreFloat3(&vertex.Normal, N);
+
+				ring[j] = vertex;
+			}
+
+			if(i == stackCount)
+				continue;
+
+			Index* out = indices + (size_t)i*sliceCount*6;
+			for(uint32 j = 0; j < sliceCount; ++j)
+			{
+				out[0] = static_cast<Index>(i*ringVertexCount + j);
+				out[1] = static_cast<Index>((i+1)*ringVertexCount + j);
+				out[2] = static_cast<Index>((i+1)*ringVertexCount + j+1);
+
+				out[3] = static_cast<Index>(i*ringVertexCount + j);
+				out[4] = static_cast<Index>((i+1)*ringVertexCount + j+1);
+				out[5] = static_cast<Index>(i*ringVertexCount + j+1);
+				out += 6;
+			}
 		}
-	}
+	});
 
-	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
+	uint32 topBase    = ringCount*ringVertexCount;
+	uint32 bottomBase = topBase + sliceCount+2;
+	Index* capIndices = indices + (size_t)stackCount*sliceCount*6;
 
-    return meshData;
+	BuildCylinderTopCap(topRadius, height, sliceCount, topBase, vertices + topBase, capIndices);
+	BuildCylinderBottomCap(bottomRadius, height, sliceCount, bottomBase, vertices + bottomBase, capIndices + sliceCount*3);
+}
+
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, Vertex* vertices, uint32* indices)
+{
+	FillCylinder(bottomRadius, topRadius, height, sliceCount, stackCount, vertices, indices);
 }
 
-void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
-											uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, Vertex* vertices, uint16* indices)
 {
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
+	FillCylinder(bottomRadius, topRadius, height, sliceCount, stackCount, vertices, indices);
+}
 
+template<typename Index>
+void GeometryGenerator::BuildCylinderTopCap(float topRadius, float height, uint32 sliceCount,
+											uint32 baseIndex, Vertex* vertices, Index* indices)
+{
 	float y = 0.5f*height;
 	float dTheta = 2.0f*XM_PI/sliceCount;
 
@@ -492,31 +702,31 @@ void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius,
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		vertices[i] = Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v);
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
+	vertices[sliceCount+1] = Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f);
 
 	// Index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
+	uint32 centerIndex = baseIndex + sliceCount+1;
 
 	for(uint32 i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i+1);
-		meshData.Indices32.push_back(baseIndex + i);
+		indices[i*3+0] = static_cast<Index>(centerIndex);
+		indices[i*3+1] = static_cast<Index>(baseIndex + i+1);
+		indices[i*3+2] = static_cast<Index>(baseIndex + i);
 	}
 }
 
-void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height,
-											   uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+template<typename Index>
+void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float height, uint32 sliceCount,
+											   uint32 baseIndex, Vertex* vertices, Index* indices)
 {
 	// 
 	// Build bottom cap.
 	//
 
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
 	float y = -0.5f*height;
 
 	// vertices of ring
@@ -531,20 +741,20 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		vertices[i] = Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v);
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
+	vertices[sliceCount+1] = Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f);
 
 	// Cache the index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
+	uint32 centerIndex = baseIndex + sliceCount+1;
 
 	for(uint32 i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i);
-		meshData.Indices32.push_back(baseIndex + i+1);
+		indices[i*3+0] = static_cast<Index>(centerIndex);
+		indices[i*3+1] = static_cast<Index>(baseIndex + i);
+		indices[i*3+2] = static_cast<Index>(baseIndex + i+1);
 	}
 }
 
@@ -552,9 +762,28 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 {
     MeshData meshData;
 
-	uint32 vertexCount = m*n;
-	uint32 faceCount   = (m-1)*(n-1)*2;
+	MeshSize size = GridSize(m, n);
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.ResizeIndices(size.IndexCount);
+	meshData.VisitIndices([&](auto* indices)
+	{
+		FillGrid(width, depth, m, n, meshData.Vertices.data(), indices);
+	});
 
+    return meshData;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GridSize(uint32 m, uint32 n)
+{
+	MeshSize size;
+	size.VertexCount = (size_t)m*n;
+	size.IndexCount  = (size_t)(m-1)*(n-1)*2*3; // 3 indices per face
+	return size;
+}
+
+template<typename Index>
+void GeometryGenerator::FillGrid(float width, float depth, uint32 m, uint32 n, Vertex* vertices, Index* indices)
+{
 	//
 	// Create the vertices.
 	//
@@ -568,49 +797,68 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 	float du = 1.0f / (n-1);
 	float dv = 1.0f / (m-1);
 
-	meshData.Vertices.resize(vertexCount);
-	for(uint32 i = 0; i < m; ++i)
+	// Each task builds whole rows of vertices and the row of quads below each one.
+	ParallelRows(m, n, [&](uint32 i0, uint32 i1)
 	{
-		float z = halfDepth - i*dz;
-		for(uint32 j = 0; j < n; ++j)
+		for(uint32 i = i0; i < i1; ++i)
 		{
-			float x = -halfWidth + j*dx;
-
-			meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-			// Stretch texture over grid.
-			meshData.Vertices[i*n+j].TexC.x = j*du;
-			meshData.Vertices[i*n+j].TexC.y = i*dv;
+			float z = halfDepth - i*dz;
+			Vertex* row = vertices + (size_t)i*n;
+			for(uint32 j = 0; j < n; ++j)
+			{
+				float x = -halfWidth + j*dx;
+
+				row[j].Position = XMFLOAT3(x, 0.0f, z);
+				row[j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
+				row[j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+
+				// Stretch texture over grid.
+				row[j].TexC.x = j*du;
+				row[j].TexC.y = i*dv;
+			}
+
+			if(i == m-1)
+				continue;
+
+			// Iterate over each quad and compute indices.
+			Index* out = indices + (size_t)i*(n-1)*6;
+			for(uint32 j = 0; j < n-1; ++j)
+			{
+				out[0] = static_cast<Index>(i*n+j);
+				out[1] = static_cast<Index>(i*n+j+1);
+				out[2] = static_cast<Index>((i+1)*n+j);
+
+				out[3] = static_cast<Index>((i+1)*n+j);
+				out[4] = static_cast<Index>(i*n+j+1);
+				out[5] = static_cast<Index>((i+1)*n+j+1);
+
+				out += 6; // next quad
+			}
 		}
-	}
- 
-    //
-	// Create the indices.
-	//
-
-	meshData.Indices32.resize(faceCount*3); // 3 indices per face
+	});
+}
 
-	// Iterate over each quad and compute indices.
-	uint32 k = 0;
-	for(uint32 i = 0; i < m-1; ++i)
-	{
-		for(uint32 j = 0; j < n-1; ++j)
-		{
-			meshData.Indices32[k]   = i*n+j;
-			meshData.Indices32[k+1] = i*n+j+1;
-			meshData.Indices32[k+2] = (i+1)*n+j;
+void GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n, Vertex* vertices, uint32* indices)
+{
+	FillGrid(width, depth, m, n, vertices, indices);
+}
 
-			meshData.Indices32[k+3] = (i+1)*n+j;
-			meshData.Indices32[k+4] = i*n+j+1;
-			meshData.Indices32[k+5] = (i+1)*n+j+1;
+void GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n, Vertex* vertices, uint16* indices)
+{
+	FillGrid(width, depth, m, n, vertices, indices);
+}
 
-			k += 6; // next quad
-		}
-	}
+void GeometryGenerator::ParallelRows(uint32 rowCount, uint32 verticesPerRow,
+									 const std::function<void(uint32, uint32)>& body)
+{
+	// Small meshes fit in one chunk, which ParallelFor runs on the calling thread.
+	uint32 rowsPerTask = std::max<uint32>(VerticesPerTask / std::max<uint32>(verticesPerRow, 1), 1);
 
-    return meshData;
+	TaskScheduler& scheduler = mScheduler != nullptr ? *mScheduler : TaskScheduler::Default();
+	scheduler.ParallelFor(0, (int)rowCount, (int)rowsPerTask, [&body](int r0, int r1)
+	{
+		body((uint32)r0, (uint32)r1);
+	});
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth)
@@ -618,7 +866,6 @@ GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, floa
     MeshData meshData;
 
 	meshData.Vertices.resize(4);
-	meshData.Indices32.resize(6);
 
 	// Position coordinates specified in NDC space.
 	meshData.Vertices[0] = Vertex(
@@ -645,13 +892,12 @@ GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, floa
 		1.0f, 0.0f, 0.0f,
 		1.0f, 1.0f);
 
-	meshData.Indices32[0] = 0;
-	meshData.Indices32[1] = 1;
-	meshData.Indices32[2] = 2;
-
-	meshData.Indices32[3] = 0;
-	meshData.Indices32[4] = 2;
-	meshData.Indices32[5] = 3;
+	uint32 i[6] =
+	{
+		0, 1, 2,
+		0, 2, 3
+	};
+	meshData.AssignIndices(i, 6);
 
     return meshData;
 }
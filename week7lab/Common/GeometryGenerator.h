@@ -16,8 +16,11 @@
 
 #include <cstdint>
 #include <DirectXMath.h>
+#include <functional>
 #include <vector>
 
+class TaskScheduler;
+
 class GeometryGenerator
 {
 public:
@@ -53,25 +56,75 @@ public:
         DirectX::XMFLOAT2 TexC;
 	};
 
+	///<summary>
+	/// Read-only view of a mesh's indices at their stored width, ready to be copied
+	/// into an index buffer.
+	///</summary>
+	struct IndexView
+	{
+		const void* Data = nullptr;
+		size_t Count = 0;
+		uint32 Stride = 0;
+
+		size_t ByteSize()const { return Count*Stride; }
+	};
+
 	struct MeshData
 	{
 		std::vector<Vertex> Vertices;
-        std::vector<uint32> Indices32;
-
-        std::vector<uint16>& GetIndices16()
-        {
-			if(mIndices16.empty())
-			{
-				mIndices16.resize(Indices32.size());
-				for(size_t i = 0; i < Indices32.size(); ++i)
-					mIndices16[i] = static_cast<uint16>(Indices32[i]);
-			}
 
-			return mIndices16;
-        }
+		// The indices are stored once, 16 bits wide while every vertex can be addressed
+		// with 16 bits and 32 bits wide otherwise.  ResizeIndices and AssignIndices pick
+		// the width from the current vertex count, so fill Vertices first.
+		void ResizeIndices(size_t count);
+		void AssignIndices(const uint32* indices, size_t count);
+
+		size_t IndexCount()const { return mIndexCount; }
+		bool Has16BitIndices()const { return mIndexStride == sizeof(uint16); }
+		static bool Fits16BitIndices(size_t vertexCount) { return vertexCount <= 0x10000; }
+
+		// Typed access at the stored width; the accessor for the other width returns nullptr.
+		uint16* Indices16() { return Has16BitIndices() ? reinterpret_cast<uint16*>(mIndexData.data()) : nullptr; }
+		uint32* Indices32() { return Has16BitIndices() ? nullptr : reinterpret_cast<uint32*>(mIndexData.data()); }
+		const uint16* Indices16()const { return Has16BitIndices() ? reinterpret_cast<const uint16*>(mIndexData.data()) : nullptr; }
+		const uint32* Indices32()const { return Has16BitIndices() ? nullptr : reinterpret_cast<const uint32*>(mIndexData.data()); }
+
+		uint32 GetIndex(size_t i)const { return Has16BitIndices() ? Indices16()[i] : Indices32()[i]; }
+
+		// Calls fn with a pointer to the indices at their stored width, so code written
+		// once as a template over the index type handles both.
+		template<typename Fn>
+		void VisitIndices(Fn&& fn)
+		{
+			if(Has16BitIndices())
+				fn(Indices16());
+			else
+				fn(Indices32());
+		}
+
+		template<typename Fn>
+		void VisitIndices(Fn&& fn)const
+		{
+			if(Has16BitIndices())
+				fn(Indices16());
+			else
+				fn(Indices32());
+		}
+
+		IndexView GetIndexView()const
+		{
+			IndexView view;
+			view.Data = mIndexData.data();
+			view.Count = mIndexCount;
+			view.Stride = mIndexStride;
+			return view;
+		}
 
 	private:
-		std::vector<uint16> mIndices16;
+		// Raw bytes; the allocator aligns them for either index width.
+		std::vector<unsigned char> mIndexData;
+		size_t mIndexCount = 0;
+		uint32 mIndexStride = sizeof(uint32);
 	};
 
 	///<summary>
@@ -109,11 +162,87 @@ public:
 	/// Creates a quad aligned with the screen.  This is useful for postprocessing and screen effects.
 	///</summary>
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
+
+	///<summary>
+	/// Splits every triangle into four.  Edges shared by two triangles share one
+	/// midpoint vertex, so a welded input mesh stays welded.
+	///</summary>
 	void Subdivide(MeshData& meshData);
+
+	///<summary>
+	/// CreateBox and CreateGeosphere clamp numSubdivisions to this value, which
+	/// defaults to 6.  Offline asset generation can raise it up to
+	/// SubdivisionLimit, beyond which a geosphere no longer fits 32-bit indices.
+	///</summary>
+	void SetMaxSubdivisions(uint32 maxSubdivisions);
+	uint32 GetMaxSubdivisions()const { return mMaxSubdivisions; }
+
+	static const uint32 DefaultMaxSubdivisions = 6;
+	static const uint32 SubdivisionLimit = 14;
+
+	///<summary>
+	/// Vertex and index counts of a generated mesh, known in closed form from the
+	/// generator parameters.
+	///</summary>
+	struct MeshSize
+	{
+		size_t VertexCount = 0;
+		size_t IndexCount = 0;
+	};
+
+	MeshSize BoxSize(uint32 numSubdivisions)const;
+	static MeshSize SphereSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize CylinderSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize GridSize(uint32 m, uint32 n);
+
+	///<summary>
+	/// Same meshes as the MeshData overloads, written into caller-supplied storage
+	/// that holds exactly the counts returned by the matching *Size function.  Rows,
+	/// stacks and box faces are filled in parallel.
+	///</summary>
+	void CreateBox(float width, float height, float depth, uint32 numSubdivisions, Vertex* vertices, uint32* indices);
+	void CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, Vertex* vertices, uint32* indices);
+	void CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, Vertex* vertices, uint32* indices);
+	void CreateGrid(float width, float depth, uint32 m, uint32 n, Vertex* vertices, uint32* indices);
+
+	///<summary>
+	/// 16-bit versions of the above, for meshes that satisfy MeshData::Fits16BitIndices.
+	///</summary>
+	void CreateBox(float width, float height, float depth, uint32 numSubdivisions, Vertex* vertices, uint16* indices);
+	void CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, Vertex* vertices, uint16* indices);
+	void CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, Vertex* vertices, uint16* indices);
+	void CreateGrid(float width, float depth, uint32 m, uint32 n, Vertex* vertices, uint16* indices);
+
+	///<summary>
+	/// Thread pool the generators split their rows over; nullptr selects
+	/// TaskScheduler::Default().
+	///</summary>
+	void SetScheduler(TaskScheduler* scheduler) { mScheduler = scheduler; }
+
 private:
 	
     Vertex MidPoint(const Vertex& v0, const Vertex& v1);
-    void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
-    void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
+
+	// Shared bodies of the CreateBox, CreateSphere, CreateCylinder and CreateGrid
+	// overloads for both index widths.
+	template<typename Index>
+	void FillBox(float width, float height, float depth, uint32 numSubdivisions, Vertex* vertices, Index* indices);
+	template<typename Index>
+	void FillSphere(float radius, uint32 sliceCount, uint32 stackCount, Vertex* vertices, Index* indices);
+	template<typename Index>
+	void FillCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, Vertex* vertices, Index* indices);
+	template<typename Index>
+	void FillGrid(float width, float depth, uint32 m, uint32 n, Vertex* vertices, Index* indices);
+
+	template<typename Index>
+    void BuildCylinderTopCap(float topRadius, float height, uint32 sliceCount, uint32 baseIndex, Vertex* vertices, Index* indices);
+	template<typename Index>
+    void BuildCylinderBottomCap(float bottomRadius, float height, uint32 sliceCount, uint32 baseIndex, Vertex* vertices, Index* indices);
+
+	// Runs body over [0, rowCount) in chunks of roughly equal vertex counts.
+	void ParallelRows(uint32 rowCount, uint32 verticesPerRow, const std::function<void(uint32, uint32)>& body);
+
+	uint32 mMaxSubdivisions = DefaultMaxSubdivisions;
+	TaskScheduler* mScheduler = nullptr;
 };
 
@@ -0,0 +1,121 @@
+//***************************************************************************************
+// MappedFile.cpp
+//***************************************************************************************
+
+#include "MappedFile.h"
+#include <ostream>
+
+#if defined(_WIN32)
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+void MappedFile::PadTo(std::ostream& file, std::uint64_t offset)
+{
+	static const char padding[PageSize] = {};
+	std::uint64_t at = (std::uint64_t)file.tellp();
+	file.write(padding, (std::streamsize)(offset - at));
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const char* path)
+{
+	Close();
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if(view == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	mFile = file;
+	mMapping = mapping;
+	mData = static_cast<const unsigned char*>(view);
+	mSize = (size_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(mData != nullptr)
+		UnmapViewOfFile(mData);
+	if(mMapping != nullptr)
+		CloseHandle(mMapping);
+	if(mFile != nullptr)
+		CloseHandle(mFile);
+
+	mData = nullptr;
+	mSize = 0;
+	mFile = nullptr;
+	mMapping = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const char* path)
+{
+	Close();
+
+	int fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return false;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	// The mapping keeps the file referenced, so the descriptor is not needed after this.
+	void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(view == MAP_FAILED)
+		return false;
+
+	mData = static_cast<const unsigned char*>(view);
+	mSize = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(mData != nullptr)
+		munmap(const_cast<unsigned char*>(mData), mSize);
+
+	mData = nullptr;
+	mSize = 0;
+}
+
+#endif
@@ -0,0 +1,63 @@
+//***************************************************************************************
+// MappedFile.h
+//
+// Read-only memory mapping of a whole file.  The contents are paged in by the OS on
+// first touch, so data laid out in its final in-memory form can be used or copied
+// without reading the file through a stream first.
+//***************************************************************************************
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile& rhs) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+	~MappedFile();
+
+	// Maps path for reading, replacing any previous mapping.  Returns false, and
+	// leaves the object empty, if the file cannot be opened or is empty.
+	bool Open(const char* path);
+	void Close();
+
+	bool IsOpen()const { return mData != nullptr; }
+	const unsigned char* Data()const { return mData; }
+	size_t Size()const { return mSize; }
+
+	// Mappings start on a boundary of at least this many bytes, so file offsets that
+	// are multiples of it are equally aligned in memory.
+	static const size_t PageSize = 4096;
+
+	// True if the bytes-long section at offset is page aligned and lies inside the
+	// mapping.  Written so that no offset or size read from a damaged file can wrap.
+	bool SectionFits(std::uint64_t offset, std::uint64_t bytes)const
+	{
+		return offset % PageSize == 0 && offset <= mSize && bytes <= mSize - offset;
+	}
+
+	static std::uint64_t AlignToPage(std::uint64_t offset)
+	{
+		return (offset + PageSize - 1) & ~(std::uint64_t)(PageSize - 1);
+	}
+
+	// For writers of mappable files: zero-fills file from its current position up to
+	// offset, which must be no more than a page ahead.
+	static void PadTo(std::ostream& file, std::uint64_t offset);
+
+private:
+	const unsigned char* mData = nullptr;
+	size_t mSize = 0;
+
+#if defined(_WIN32)
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+#endif
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,193 @@
+//***************************************************************************************
+// MeshCache.cpp
+//***************************************************************************************
+
+#include "MeshCache.h"
+#include <cstdio>
+#include <fstream>
+
+#if defined(_WIN32)
+	#include <direct.h>
+#else
+	#include <sys/stat.h>
+#endif
+
+namespace
+{
+	// Layout of a cache entry.  The header is followed by zero padding up to each
+	// section's offset, and every offset is a multiple of MappedFile::PageSize.
+	struct CacheHeader
+	{
+		char Magic[4];
+		std::uint32_t Version;
+		std::uint32_t HeaderSize;
+		std::uint32_t VertexStride;
+		std::uint64_t Key;
+		std::uint64_t VertexOffset;
+		std::uint64_t VertexBytes;
+		std::uint32_t IndexStride;
+		std::uint32_t Reserved;
+		std::uint64_t IndexOffset;
+		std::uint64_t IndexBytes;
+		std::uint64_t ExtraOffset;
+		std::uint64_t ExtraBytes;
+	};
+
+	const char CacheMagic[4] = { 'M', 'S', 'H', 'C' };
+	const std::uint32_t CacheVersion = 1;
+
+	const std::uint64_t FnvOffsetBasis = 14695981039346656037ull;
+	const std::uint64_t FnvPrime = 1099511628211ull;
+
+	void MakeDirectory(const std::string& path)
+	{
+		// Failure, including the directory already existing, shows up when the
+		// entry itself cannot be written.
+#if defined(_WIN32)
+		_mkdir(path.c_str());
+#else
+		mkdir(path.c_str(), 0755);
+#endif
+	}
+}
+
+MeshCacheKey::MeshCacheKey(const char* generator, std::uint32_t revision) :
+	mHash(FnvOffsetBasis)
+{
+	Add(generator);
+	Add(revision);
+	Add(CacheVersion);
+}
+
+MeshCacheKey& MeshCacheKey::Add(const void* data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for(size_t i = 0; i < size; ++i)
+	{
+		mHash ^= bytes[i];
+		mHash *= FnvPrime;
+	}
+	return *this;
+}
+
+MeshCacheKey& MeshCacheKey::Add(const char* text)
+{
+	// Include the terminator so ("ab", "c") and ("a", "bc") hash differently.
+	return Add(text, strlen(text) + 1);
+}
+
+MeshCache::MeshCache(std::string directory) :
+	mDirectory(std::move(directory))
+{
+}
+
+std::string MeshCache::PathFor(const MeshCacheKey& key)const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.mesh", (unsigned long long)key.Value());
+	return mDirectory.empty() ? std::string(name) : mDirectory + "/" + name;
+}
+
+bool MeshCache::Load(const MeshCacheKey& key, MappedFile& file, MeshCacheData& data)const
+{
+	if(!file.Open(PathFor(key).c_str()) || file.Size() < sizeof(CacheHeader))
+	{
+		file.Close();
+		return false;
+	}
+
+	CacheHeader header;
+	memcpy(&header, file.Data(), sizeof(header));
+
+	if(memcmp(header.Magic, CacheMagic, sizeof(header.Magic)) != 0 ||
+		header.Version != CacheVersion ||
+		header.HeaderSize != sizeof(CacheHeader) ||
+		header.Key != key.Value() ||
+		header.VertexStride == 0 || header.VertexBytes % header.VertexStride != 0 ||
+		(header.IndexStride != 2 && header.IndexStride != 4) ||
+		header.IndexBytes % header.IndexStride != 0 ||
+		!file.SectionFits(header.VertexOffset, header.VertexBytes) ||
+		!file.SectionFits(header.IndexOffset, header.IndexBytes) ||
+		!file.SectionFits(header.ExtraOffset, header.ExtraBytes))
+	{
+		file.Close();
+		return false;
+	}
+
+	data.Vertices = file.Data() + header.VertexOffset;
+	data.VertexBytes = (size_t)header.VertexBytes;
+	data.VertexStride = header.VertexStride;
+	data.Indices = file.Data() + header.IndexOffset;
+	data.IndexBytes = (size_t)header.IndexBytes;
+	data.IndexStride = header.IndexStride;
+	data.Extra = file.Data() + header.ExtraOffset;
+	data.ExtraBytes = (size_t)header.ExtraBytes;
+	return true;
+}
+
+bool MeshCache::Store(const MeshCacheKey& key, const MeshCacheData& data)const
+{
+	CacheHeader header = {};
+	memcpy(header.Magic, CacheMagic, sizeof(header.Magic));
+	header.Version = CacheVersion;
+	header.HeaderSize = sizeof(CacheHeader);
+	header.Key = key.Value();
+	header.VertexStride = data.VertexStride;
+	header.VertexOffset = MappedFile::AlignToPage(sizeof(CacheHeader));
+	header.VertexBytes = data.VertexBytes;
+	header.IndexStride = data.IndexStride;
+	header.IndexOffset = MappedFile::AlignToPage(header.VertexOffset + header.VertexBytes);
+	header.IndexBytes = data.IndexBytes;
+	header.ExtraOffset = MappedFile::AlignToPage(header.IndexOffset + header.IndexBytes);
+	header.ExtraBytes = data.ExtraBytes;
+
+	if(!mDirectory.empty())
+		MakeDirectory(mDirectory);
+
+	const std::string path = PathFor(key);
+	const std::string partial = path + ".partial";
+	{
+		std::ofstream file(partial, std::ios::binary | std::ios::trunc);
+		if(!file)
+			return false;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		MappedFile::PadTo(file, header.VertexOffset);
+		file.write(static_cast<const char*>(data.Vertices), (std::streamsize)data.VertexBytes);
+		MappedFile::PadTo(file, header.IndexOffset);
+		file.write(static_cast<const char*>(data.Indices), (std::streamsize)data.IndexBytes);
+		MappedFile::PadTo(file, header.ExtraOffset);
+		file.write(static_cast<const char*>(data.Extra), (std::streamsize)data.ExtraBytes);
+
+		if(!file)
+		{
+			file.close();
+			std::remove(partial.c_str());
+			return false;
+		}
+	}
+
+	// rename does not replace an existing file on Windows.
+	std::remove(path.c_str());
+	if(std::rename(partial.c_str(), path.c_str()) != 0)
+	{
+		std::remove(partial.c_str());
+		return false;
+	}
+	return true;
+}
+
+void MeshCacheWriter::WriteString(const std::string& text)
+{
+	Write((std::uint32_t)text.size());
+	mBytes.insert(mBytes.end(), text.begin(), text.end());
+}
+
+bool MeshCacheReader::ReadString(std::string& text)
+{
+	std::uint32_t size = 0;
+	if(!Read(size) || !Take(size))
+		return false;
+	text.assign(reinterpret_cast<const char*>(mData + mOffset - size), size);
+	return true;
+}
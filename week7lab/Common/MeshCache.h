@@ -0,0 +1,179 @@
+//***************************************************************************************
+// MeshCache.h
+//
+// On-disk cache of finished geometry: the interleaved vertices and indices exactly as
+// they are uploaded, plus whatever draw metadata the caller wants to keep with them.
+// Entries are keyed by a hash of the generator calls and parameters that produced them
+// and laid out with every section on its own page, so a later run maps the file and
+// hands the sections straight to buffer creation.
+//
+// The key only covers what the caller hashes into it.  Code changes that alter the
+// output must also change the key, which is what the revision argument is for.
+//***************************************************************************************
+
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+///<summary>
+/// 64-bit FNV-1a hash of a generator call and its parameters.
+///</summary>
+class MeshCacheKey
+{
+public:
+	MeshCacheKey(const char* generator, std::uint32_t revision);
+
+	MeshCacheKey& Add(const void* data, size_t size);
+	MeshCacheKey& Add(const char* text);
+
+	template<typename T>
+	MeshCacheKey& Add(const T& value)
+	{
+		static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+			"Hash structures field by field so padding does not reach the key.");
+		return Add(&value, sizeof(T));
+	}
+
+	std::uint64_t Value()const { return mHash; }
+
+private:
+	std::uint64_t mHash;
+};
+
+///<summary>
+/// The sections of a cache entry.  After a successful Load the pointers refer into the
+/// mapped file and stay valid until it is closed.
+///</summary>
+struct MeshCacheData
+{
+	const void* Vertices = nullptr;
+	size_t VertexBytes = 0;
+	std::uint32_t VertexStride = 0;
+
+	const void* Indices = nullptr;
+	size_t IndexBytes = 0;
+	std::uint32_t IndexStride = 0;
+
+	// Caller-defined metadata, written with MeshCacheWriter.
+	const void* Extra = nullptr;
+	size_t ExtraBytes = 0;
+};
+
+class MeshCache
+{
+public:
+	// Entries are files named after their key inside directory, which is created on
+	// the first Store.
+	explicit MeshCache(std::string directory);
+
+	// Maps the entry for key.  Returns false if there is none or it does not match
+	// key, this format version, or its own section table.  Indices are always 16 or
+	// 32 bits wide.
+	bool Load(const MeshCacheKey& key, MappedFile& file, MeshCacheData& data)const;
+
+	// Writes the entry for key, replacing any previous one.  The file is written
+	// beside its final name and renamed, so a reader never sees half an entry.
+	bool Store(const MeshCacheKey& key, const MeshCacheData& data)const;
+
+	std::string PathFor(const MeshCacheKey& key)const;
+
+private:
+	std::string mDirectory;
+};
+
+///<summary>
+/// Serializes the metadata kept with a cache entry.  Values are stored in the byte
+/// order of the machine, like the rest of the entry.
+///</summary>
+class MeshCacheWriter
+{
+public:
+	template<typename T>
+	void Write(const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be cached.");
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+		mBytes.insert(mBytes.end(), bytes, bytes + sizeof(T));
+	}
+
+	template<typename T>
+	void WriteArray(const std::vector<T>& values)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be cached.");
+		Write((std::uint32_t)values.size());
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values.data());
+		mBytes.insert(mBytes.end(), bytes, bytes + values.size()*sizeof(T));
+	}
+
+	void WriteString(const std::string& text);
+
+	const std::vector<unsigned char>& Bytes()const { return mBytes; }
+
+private:
+	std::vector<unsigned char> mBytes;
+};
+
+///<summary>
+/// Reads metadata written by MeshCacheWriter.  Every read fails once one has run past
+/// the end, so callers can check once after reading everything.
+///</summary>
+class MeshCacheReader
+{
+public:
+	MeshCacheReader(const void* data, size_t size) :
+		mData(static_cast<const unsigned char*>(data)), mSize(size) {}
+
+	template<typename T>
+	bool Read(T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be cached.");
+		if(!Take(sizeof(T)))
+			return false;
+		memcpy(&value, mData + mOffset - sizeof(T), sizeof(T));
+		return true;
+	}
+
+	template<typename T>
+	bool ReadArray(std::vector<T>& values)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be cached.");
+		std::uint32_t count = 0;
+		if(!Read(count) || !Take((size_t)count*sizeof(T)))
+			return false;
+		values.resize(count);
+		if(count > 0)
+			memcpy(values.data(), mData + mOffset - count*sizeof(T), count*sizeof(T));
+		return true;
+	}
+
+	bool ReadString(std::string& text);
+
+	bool Failed()const { return mFailed; }
+	bool AtEnd()const { return !mFailed && mOffset == mSize; }
+
+private:
+	bool Take(size_t size)
+	{
+		if(mFailed || size > mSize - mOffset)
+		{
+			mFailed = true;
+			return false;
+		}
+		mOffset += size;
+		return true;
+	}
+
+private:
+	const unsigned char* mData;
+	size_t mSize;
+	size_t mOffset = 0;
+	bool mFailed = false;
+};
+
+#endif // MESHCACHE_H
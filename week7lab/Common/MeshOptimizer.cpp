@@ -0,0 +1,381 @@
+//***************************************************************************************
+// MeshOptimizer.cpp
+//***************************************************************************************
+
+#include "MeshOptimizer.h"
+#include "VertexTriangles.h"
+#include <algorithm>
+#include <type_traits>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef GeometryGenerator::uint16 uint16;
+	typedef GeometryGenerator::uint32 uint32;
+
+	const uint32 InvalidVertex = ~0u;
+
+	// FIFO post-transform cache modelled with timestamps: a vertex is resident while
+	// fewer than cacheSize misses have happened since it was loaded.  Advancing the
+	// clock by a whole cache flushes it without touching the stamps.
+	class FifoCache
+	{
+	public:
+		FifoCache(size_t vertexCount, uint32 cacheSize) :
+			mStamps(vertexCount, 0), mCacheSize(cacheSize), mTime(cacheSize + 1) {}
+
+		// Returns true on a miss, which loads the vertex.
+		bool Access(uint32 v)
+		{
+			if(mTime - mStamps[v] <= mCacheSize)
+				return false;
+			mStamps[v] = mTime++;
+			return true;
+		}
+
+		void Flush() { mTime += mCacheSize + 1; }
+
+	private:
+		std::vector<uint32> mStamps;
+		uint32 mCacheSize;
+		uint32 mTime;
+	};
+}
+
+template<typename Index>
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const Index* indices, size_t indexCount,
+	size_t vertexCount, uint32 cacheSize)
+{
+	CacheStats stats;
+	if(indexCount < 3)
+		return stats;
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> referenced(vertexCount, false);
+
+	size_t transforms = 0;
+	size_t uniqueVertices = 0;
+	for(size_t i = 0; i < indexCount; ++i)
+	{
+		uint32 v = indices[i];
+		if(!referenced[v])
+		{
+			referenced[v] = true;
+			++uniqueVertices;
+		}
+		if(cache.Access(v))
+			++transforms;
+	}
+
+	stats.Acmr = (float)transforms / (float)(indexCount / 3);
+	stats.Atvr = (float)transforms / (float)uniqueVertices;
+	return stats;
+}
+
+template<typename Index>
+void MeshOptimizer::OptimizeVertexCache(Index* indices, size_t indexCount, size_t vertexCount, uint32 cacheSize)
+{
+	size_t triCount = indexCount / 3;
+	if(triCount == 0)
+		return;
+
+	VertexTriangles adjacency(indices, indexCount, vertexCount);
+
+	// Triangles still to be emitted around each vertex.
+	std::vector<uint32> live(vertexCount);
+	for(size_t v = 0; v < vertexCount; ++v)
+		live[v] = adjacency.Count((uint32)v);
+
+	// Tipsify keeps its own clock rather than a FifoCache because it needs the age
+	// of each entry, not just whether it is resident.
+	std::vector<uint32> cacheTime(vertexCount, 0);
+	uint32 time = cacheSize + 1;
+
+	std::vector<bool> emitted(triCount, false);
+	std::vector<uint32> deadEnd;
+	std::vector<uint32> candidates;
+	std::vector<Index> output(triCount*3);
+	size_t outCount = 0;
+	size_t cursor = 0;
+
+	deadEnd.reserve(indexCount);
+
+	uint32 fan = indices[0];
+	while(fan != InvalidVertex)
+	{
+		// Emit every remaining triangle around the fanning vertex.
+		candidates.clear();
+		for(const uint32* k = adjacency.begin(fan); k != adjacency.end(fan); ++k)
+		{
+			uint32 t = *k;
+			if(emitted[t])
+				continue;
+			emitted[t] = true;
+
+			for(uint32 c = 0; c < 3; ++c)
+			{
+				uint32 v = indices[t*3 + c];
+				output[outCount++] = static_cast<Index>(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				--live[v];
+
+				if(time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+		}
+
+		// Prefer the oldest candidate that will still be cached after all of its
+		// remaining triangles are emitted; the others rank equally at zero.
+		uint32 next = InvalidVertex;
+		int bestPriority = -1;
+		for(uint32 v : candidates)
+		{
+			if(live[v] == 0)
+				continue;
+
+			int priority = 0;
+			if(time - cacheTime[v] + 2*live[v] <= cacheSize)
+				priority = (int)(time - cacheTime[v]);
+
+			if(priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		// Dead end: back up to a recently used vertex that still has triangles, and
+		// failing that scan forward for any unfinished vertex.
+		while(next == InvalidVertex && !deadEnd.empty())
+		{
+			uint32 v = deadEnd.back();
+			deadEnd.pop_back();
+			if(live[v] > 0)
+				next = v;
+		}
+		if(next == InvalidVertex)
+		{
+			while(cursor < vertexCount && live[cursor] == 0)
+				++cursor;
+			if(cursor < vertexCount)
+				next = (uint32)cursor;
+		}
+
+		fan = next;
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+template<typename Index>
+void MeshOptimizer::OptimizeOverdraw(Index* indices, size_t indexCount, const GeometryGenerator::Vertex* vertices,
+	size_t vertexCount, uint32 cacheSize, float threshold)
+{
+	size_t triCount = indexCount / 3;
+	if(triCount < 2)
+		return;
+
+	//
+	// Hard boundaries: triangles whose three vertices all miss.  Nothing useful is
+	// cached there, so a cluster may start at one without costing extra transforms.
+	//
+
+	std::vector<size_t> hard;
+	{
+		FifoCache cache(vertexCount, cacheSize);
+		for(size_t t = 0; t < triCount; ++t)
+		{
+			int misses = 0;
+			for(uint32 c = 0; c < 3; ++c)
+				misses += cache.Access(indices[t*3 + c]) ? 1 : 0;
+			if(t == 0 || misses == 3)
+				hard.push_back(t);
+		}
+		hard.push_back(triCount);
+	}
+
+	//
+	// Soft boundaries: split a hard cluster wherever the part since the last split,
+	// drawn from a cold cache, is within threshold of the whole cluster's ACMR.
+	//
+
+	std::vector<size_t> clusters;
+	{
+		FifoCache cache(vertexCount, cacheSize);
+		for(size_t h = 0; h + 1 < hard.size(); ++h)
+		{
+			size_t begin = hard[h];
+			size_t end = hard[h + 1];
+
+			cache.Flush();
+			size_t clusterMisses = 0;
+			for(size_t i = begin*3; i < end*3; ++i)
+				clusterMisses += cache.Access(indices[i]) ? 1 : 0;
+			float target = threshold*(float)clusterMisses / (float)(end - begin);
+
+			cache.Flush();
+			clusters.push_back(begin);
+			size_t start = begin;
+			size_t misses = 0;
+			for(size_t t = begin; t < end; ++t)
+			{
+				for(uint32 c = 0; c < 3; ++c)
+					misses += cache.Access(indices[t*3 + c]) ? 1 : 0;
+
+				if(t + 1 < end && (float)misses <= target*(float)(t + 1 - start))
+				{
+					clusters.push_back(t + 1);
+					start = t + 1;
+					misses = 0;
+					cache.Flush();
+				}
+			}
+		}
+		clusters.push_back(triCount);
+	}
+
+	size_t clusterCount = clusters.size() - 1;
+	if(clusterCount < 2)
+		return;
+
+	//
+	// Sort key: how far each cluster's area-weighted centroid lies from the mesh
+	// centroid along its average normal.  Clusters on the outside facing outwards
+	// occlude the rest from most view directions, so they are drawn first.
+	//
+
+	std::vector<XMFLOAT3> centroids(clusterCount);
+	std::vector<XMFLOAT3> normals(clusterCount);
+	XMVECTOR meshCentroid = XMVectorZero();
+	float meshArea = 0.0f;
+
+	for(size_t k = 0; k < clusterCount; ++k)
+	{
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+
+		for(size_t t = clusters[k]; t < clusters[k + 1]; ++t)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t*3 + 0]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t*3 + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t*3 + 2]].Position);
+
+			// Twice the triangle's area, along its normal.
+			XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+			float a = XMVectorGetX(XMVector3Length(n));
+
+			centroid += (a/3.0f)*(p0 + p1 + p2);
+			normal += n;
+			area += a;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+
+		XMStoreFloat3(&centroids[k], area > 0.0f ? centroid/area : centroid);
+		XMStoreFloat3(&normals[k], XMVector3Normalize(normal));
+	}
+
+	if(meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	std::vector<float> keys(clusterCount);
+	for(size_t k = 0; k < clusterCount; ++k)
+	{
+		XMVECTOR offset = XMLoadFloat3(&centroids[k]) - meshCentroid;
+		keys[k] = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&normals[k])));
+	}
+
+	std::vector<size_t> order(clusterCount);
+	for(size_t k = 0; k < clusterCount; ++k)
+		order[k] = k;
+	std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+	std::vector<Index> sorted;
+	sorted.reserve(triCount*3);
+	for(size_t k : order)
+		sorted.insert(sorted.end(), indices + clusters[k]*3, indices + clusters[k + 1]*3);
+
+	// The split points are chosen from a cold cache, but in the input order a cluster
+	// also reuses what its predecessor left behind, even across a hard boundary.
+	// Keep the cache order when the sort loses more than threshold allows.
+	float cacheAcmr = AnalyzeVertexCache(indices, indexCount, vertexCount, cacheSize).Acmr;
+	float sortedAcmr = AnalyzeVertexCache(sorted.data(), indexCount, vertexCount, cacheSize).Acmr;
+	if(sortedAcmr > threshold*cacheAcmr)
+		return;
+
+	std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(GeometryGenerator::MeshData& mesh)
+{
+	size_t vertexCount = mesh.Vertices.size();
+
+	std::vector<uint32> remap(vertexCount, InvalidVertex);
+	uint32 next = 0;
+	mesh.VisitIndices([&](const auto* indices)
+	{
+		for(size_t i = 0; i < mesh.IndexCount(); ++i)
+		{
+			if(remap[indices[i]] == InvalidVertex)
+				remap[indices[i]] = next++;
+		}
+	});
+	for(size_t v = 0; v < vertexCount; ++v)
+	{
+		if(remap[v] == InvalidVertex)
+			remap[v] = next++;
+	}
+
+	std::vector<GeometryGenerator::Vertex> reordered(vertexCount);
+	for(size_t v = 0; v < vertexCount; ++v)
+		reordered[remap[v]] = mesh.Vertices[v];
+	mesh.Vertices.swap(reordered);
+
+	// The vertex count is unchanged, so the indices keep their width.
+	mesh.VisitIndices([&](auto* indices)
+	{
+		typedef std::remove_pointer_t<decltype(indices)> Index;
+		for(size_t i = 0; i < mesh.IndexCount(); ++i)
+			indices[i] = static_cast<Index>(remap[indices[i]]);
+	});
+}
+
+MeshOptimizer::Report MeshOptimizer::Optimize(GeometryGenerator::MeshData& mesh, const Options& options)
+{
+	size_t indexCount = mesh.IndexCount();
+	size_t vertexCount = mesh.Vertices.size();
+
+	Report report;
+	mesh.VisitIndices([&](auto* indices)
+	{
+		report.Before = AnalyzeVertexCache(indices, indexCount, vertexCount, options.CacheSize);
+
+		OptimizeVertexCache(indices, indexCount, vertexCount, options.CacheSize);
+		if(options.Overdraw)
+		{
+			OptimizeOverdraw(indices, indexCount, mesh.Vertices.data(), vertexCount,
+				options.CacheSize, options.OverdrawThreshold);
+		}
+	});
+
+	// Renumbering vertices does not change which ones share the cache, so the
+	// statistics after this pass equal those after the passes above.
+	OptimizeVertexFetch(mesh);
+
+	mesh.VisitIndices([&](const auto* indices)
+	{
+		report.After = AnalyzeVertexCache(indices, indexCount, vertexCount, options.CacheSize);
+	});
+	return report;
+}
+
+template MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const uint16*, size_t, size_t, uint32);
+template MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const uint32*, size_t, size_t, uint32);
+template void MeshOptimizer::OptimizeVertexCache(uint16*, size_t, size_t, uint32);
+template void MeshOptimizer::OptimizeVertexCache(uint32*, size_t, size_t, uint32);
+template void MeshOptimizer::OptimizeOverdraw(uint16*, size_t, const GeometryGenerator::Vertex*, size_t, uint32, float);
+template void MeshOptimizer::OptimizeOverdraw(uint32*, size_t, const GeometryGenerator::Vertex*, size_t, uint32, float);
@@ -0,0 +1,77 @@
+//***************************************************************************************
+// MeshOptimizer.h
+//
+// Reorders the triangles and vertices of an indexed triangle list so the GPU transforms
+// fewer vertices and shades fewer hidden pixels, without changing what is drawn:
+//   1. Vertex cache: triangles are reordered with Tipsify (Sander, Nehab and Barczak,
+//      "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007).
+//   2. Overdraw: the result is cut into clusters that each keep most of their cache
+//      locality, and clusters facing away from the mesh center are drawn first.
+//   3. Vertex fetch: vertices are renumbered in the order the index buffer first uses
+//      them, so the fetches stream through memory.
+//***************************************************************************************
+
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include "GeometryGenerator.h"
+
+namespace MeshOptimizer
+{
+	using uint16 = GeometryGenerator::uint16;
+	using uint32 = GeometryGenerator::uint32;
+
+	// Post-transform cache behaviour of an index buffer, simulated as a FIFO cache.
+	struct CacheStats
+	{
+		// Average cache miss ratio: vertices transformed per triangle.  3 is the worst
+		// case; a large regular grid approaches 0.5.
+		float Acmr = 0.0f;
+
+		// Average transform to vertex ratio: vertices transformed per vertex the index
+		// buffer references.  1 is ideal.
+		float Atvr = 0.0f;
+	};
+
+	struct Options
+	{
+		// Entries in the modelled post-transform cache.
+		uint32 CacheSize = 16;
+
+		// Sort clusters for overdraw after the cache pass.  Clusters are only split
+		// where their ACMR stays within OverdrawThreshold of the cache-optimal order,
+		// and the sort is dropped if the whole mesh's ACMR would not.
+		bool Overdraw = true;
+		float OverdrawThreshold = 1.05f;
+	};
+
+	struct Report
+	{
+		CacheStats Before;
+		CacheStats After;
+	};
+
+	// The index-buffer passes are instantiated for 16- and 32-bit indices.
+	template<typename Index>
+	CacheStats AnalyzeVertexCache(const Index* indices, size_t indexCount, size_t vertexCount, uint32 cacheSize);
+
+	// Reorders triangles in place for the post-transform cache.
+	template<typename Index>
+	void OptimizeVertexCache(Index* indices, size_t indexCount, size_t vertexCount, uint32 cacheSize);
+
+	// Reorders the clusters of a cache-optimized index buffer so outward-facing ones
+	// are drawn first.  Triangle order inside each cluster is kept.  The input order
+	// is left alone if the sorted one's ACMR would exceed threshold times its own.
+	template<typename Index>
+	void OptimizeOverdraw(Index* indices, size_t indexCount, const GeometryGenerator::Vertex* vertices,
+		size_t vertexCount, uint32 cacheSize, float threshold);
+
+	// Renumbers vertices in first-use order and rewrites the indices to match.
+	// Vertices no triangle uses are moved to the end.
+	void OptimizeVertexFetch(GeometryGenerator::MeshData& mesh);
+
+	// Runs all passes on mesh and returns its cache statistics before and after.
+	Report Optimize(GeometryGenerator::MeshData& mesh, const Options& options = Options());
+}
+
+#endif // MESHOPTIMIZER_H
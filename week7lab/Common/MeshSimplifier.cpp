@@ -0,0 +1,628 @@
+//***************************************************************************************
+// MeshSimplifier.cpp
+//***************************************************************************************
+
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef GeometryGenerator::uint32 uint32;
+	typedef GeometryGenerator::Vertex Vertex;
+
+	// Area-weighted sum of squared distances to a set of planes, kept as the upper
+	// triangle of a symmetric 4x4 matrix.
+	struct Quadric
+	{
+		double A[10] = {};
+		double Weight = 0.0;
+
+		void AddPlane(double a, double b, double c, double d, double w)
+		{
+			A[0] += w*a*a; A[1] += w*a*b; A[2] += w*a*c; A[3] += w*a*d;
+			A[4] += w*b*b; A[5] += w*b*c; A[6] += w*b*d;
+			A[7] += w*c*c; A[8] += w*c*d;
+			A[9] += w*d*d;
+			Weight += w;
+		}
+
+		Quadric& operator+=(const Quadric& rhs)
+		{
+			for(int i = 0; i < 10; ++i)
+				A[i] += rhs.A[i];
+			Weight += rhs.Weight;
+			return *this;
+		}
+
+		// Mean squared distance from p to the planes.
+		double Evaluate(const XMFLOAT3& p)const
+		{
+			const double x = p.x, y = p.y, z = p.z;
+			double e =
+				A[0]*x*x + 2.0*A[1]*x*y + 2.0*A[2]*x*z + 2.0*A[3]*x +
+				A[4]*y*y + 2.0*A[5]*y*z + 2.0*A[6]*y +
+				A[7]*z*z + 2.0*A[8]*z +
+				A[9];
+			return Weight > 0.0 ? std::max(e, 0.0)/Weight : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		double Cost;
+		uint32 From;
+		uint32 To;
+		uint32 FromVersion;
+		uint32 ToVersion;
+
+		bool operator>(const Collapse& rhs)const { return Cost > rhs.Cost; }
+	};
+
+	// Greedy half-edge collapses in order of quadric error.  Queue entries are not
+	// removed when a collapse changes their vertices; each vertex carries a version
+	// that the collapse bumps, and stale entries are skipped when they surface.
+	class Simplifier
+	{
+	public:
+		Simplifier(const std::vector<Vertex>& vertices, const std::vector<uint32>& indices);
+
+		// Collapses edges until at most targetTriangles remain.  Returns false if the
+		// cheapest remaining collapse costs more than maxErrorSq first, or none is left.
+		bool Run(size_t targetTriangles, double maxErrorSq);
+
+		size_t TriangleCount()const { return mTriangleCount; }
+
+		// Largest distance from a removed vertex to the surviving triangles around the
+		// vertices its original neighbours were collapsed into.  The quadric costs that
+		// steer the collapses average over planes and can underestimate this, so it is
+		// measured directly.
+		float MeasureError();
+
+		// Appends the surviving triangles in their original order.
+		void AppendTriangles(std::vector<uint32>& indices)const;
+
+	private:
+		void Push(uint32 from, uint32 to);
+		bool CanCollapse(uint32 from, uint32 to);
+		void Apply(uint32 from, uint32 to);
+
+		void LockSeamsAndBorders();
+
+		XMVECTOR Normal(const uint32* tri)const;
+		uint32 Survivor(uint32 v)const;
+		double Distance(const XMFLOAT3& p, uint32 t)const;
+
+	private:
+		const std::vector<Vertex>& mVertices;
+
+		std::vector<uint32> mIndices;
+		std::vector<unsigned char> mTriangleAlive;
+		size_t mTriangleCount = 0;
+
+		// Triangles around each vertex; entries for removed triangles are dropped lazily.
+		std::vector<std::vector<uint32>> mVertexTriangles;
+		std::vector<Quadric> mQuadrics;
+		std::vector<unsigned char> mLocked;
+		std::vector<unsigned char> mVertexAlive;
+		std::vector<uint32> mVersions;
+		std::vector<uint32> mCollapsedInto;
+
+		// Original one-ring of each vertex, for measuring the error.
+		std::vector<uint32> mRingOffsets;
+		std::vector<uint32> mRings;
+
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> mQueue;
+
+		std::vector<uint32> mScratchA;
+		std::vector<uint32> mScratchB;
+	};
+
+	Simplifier::Simplifier(const std::vector<Vertex>& vertices, const std::vector<uint32>& indices) :
+		mVertices(vertices),
+		mIndices(indices)
+	{
+		const size_t vertexCount = vertices.size();
+		const size_t triangleCount = indices.size() / 3;
+
+		mTriangleAlive.assign(triangleCount, 1);
+		mTriangleCount = triangleCount;
+		mVertexTriangles.resize(vertexCount);
+		mQuadrics.resize(vertexCount);
+		mLocked.assign(vertexCount, 0);
+		mVertexAlive.assign(vertexCount, 1);
+		mVersions.assign(vertexCount, 0);
+		mCollapsedInto.resize(vertexCount);
+		for(size_t v = 0; v < vertexCount; ++v)
+			mCollapsedInto[v] = (uint32)v;
+
+		for(size_t t = 0; t < triangleCount; ++t)
+		{
+			const uint32* tri = &mIndices[t*3];
+			for(int k = 0; k < 3; ++k)
+				mVertexTriangles[tri[k]].push_back((uint32)t);
+
+			XMVECTOR n = Normal(tri);
+			float twiceArea = XMVectorGetX(XMVector3Length(n));
+			if(twiceArea <= 0.0f)
+				continue;
+
+			XMFLOAT3 plane;
+			XMStoreFloat3(&plane, n/twiceArea);
+			const XMFLOAT3& p0 = mVertices[tri[0]].Position;
+			double d = -((double)plane.x*p0.x + (double)plane.y*p0.y + (double)plane.z*p0.z);
+
+			Quadric q;
+			q.AddPlane(plane.x, plane.y, plane.z, d, 0.5*twiceArea);
+			for(int k = 0; k < 3; ++k)
+				mQuadrics[tri[k]] += q;
+		}
+
+		mRingOffsets.assign(vertexCount + 1, 0);
+		for(size_t v = 0; v < vertexCount; ++v)
+		{
+			mScratchA.clear();
+			for(uint32 t : mVertexTriangles[v])
+				mScratchA.insert(mScratchA.end(), &mIndices[t*3], &mIndices[t*3] + 3);
+			std::sort(mScratchA.begin(), mScratchA.end());
+			mScratchA.erase(std::unique(mScratchA.begin(), mScratchA.end()), mScratchA.end());
+
+			mRings.insert(mRings.end(), mScratchA.begin(), mScratchA.end());
+			mRingOffsets[v + 1] = (uint32)mRings.size();
+		}
+
+		LockSeamsAndBorders();
+
+		for(size_t i = 0; i < mIndices.size(); i += 3)
+		{
+			for(int k = 0; k < 3; ++k)
+			{
+				uint32 a = mIndices[i + k];
+				uint32 b = mIndices[i + (k + 1) % 3];
+				Push(a, b);
+				Push(b, a);
+			}
+		}
+	}
+
+	void Simplifier::LockSeamsAndBorders()
+	{
+		const size_t vertexCount = mVertices.size();
+
+		// Vertices that share a position with another vertex sit on a seam.
+		std::vector<uint32> byPosition(vertexCount);
+		for(size_t v = 0; v < vertexCount; ++v)
+			byPosition[v] = (uint32)v;
+
+		auto positionLess = [this](uint32 a, uint32 b)
+		{
+			const XMFLOAT3& p = mVertices[a].Position;
+			const XMFLOAT3& q = mVertices[b].Position;
+			if(p.x != q.x) return p.x < q.x;
+			if(p.y != q.y) return p.y < q.y;
+			return p.z < q.z;
+		};
+		std::sort(byPosition.begin(), byPosition.end(), positionLess);
+
+		for(size_t i = 1; i < vertexCount; ++i)
+		{
+			uint32 a = byPosition[i - 1];
+			uint32 b = byPosition[i];
+			if(!positionLess(a, b))
+				mLocked[a] = mLocked[b] = 1;
+		}
+
+		// An edge without its opposite half-edge lies on an open border.
+		std::vector<unsigned long long> edges;
+		edges.reserve(mIndices.size());
+		for(size_t i = 0; i < mIndices.size(); i += 3)
+		{
+			for(int k = 0; k < 3; ++k)
+			{
+				unsigned long long a = mIndices[i + k];
+				unsigned long long b = mIndices[i + (k + 1) % 3];
+				edges.push_back((a << 32) | b);
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+
+		for(unsigned long long edge : edges)
+		{
+			uint32 a = (uint32)(edge >> 32);
+			uint32 b = (uint32)edge;
+			unsigned long long opposite = ((unsigned long long)b << 32) | a;
+			if(!std::binary_search(edges.begin(), edges.end(), opposite))
+				mLocked[a] = mLocked[b] = 1;
+		}
+	}
+
+	XMVECTOR Simplifier::Normal(const uint32* tri)const
+	{
+		XMVECTOR p0 = XMLoadFloat3(&mVertices[tri[0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&mVertices[tri[1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&mVertices[tri[2]].Position);
+		return XMVector3Cross(p1 - p0, p2 - p0);
+	}
+
+	void Simplifier::Push(uint32 from, uint32 to)
+	{
+		if(mLocked[from])
+			return;
+
+		Quadric q = mQuadrics[from];
+		q += mQuadrics[to];
+
+		Collapse collapse;
+		collapse.Cost = q.Evaluate(mVertices[to].Position);
+		collapse.From = from;
+		collapse.To = to;
+		collapse.FromVersion = mVersions[from];
+		collapse.ToVersion = mVersions[to];
+		mQueue.push(collapse);
+	}
+
+	bool Simplifier::CanCollapse(uint32 from, uint32 to)
+	{
+		// The two vertices must still share an edge, and only the two triangles on that
+		// edge may see both of them, or the collapse would pinch the surface.
+		mScratchA.clear();
+		mScratchB.clear();
+
+		bool adjacent = false;
+		for(uint32 t : mVertexTriangles[from])
+		{
+			if(!mTriangleAlive[t])
+				continue;
+			const uint32* tri = &mIndices[t*3];
+			for(int k = 0; k < 3; ++k)
+			{
+				adjacent |= tri[k] == to;
+				if(tri[k] != from)
+					mScratchA.push_back(tri[k]);
+			}
+		}
+		if(!adjacent)
+			return false;
+
+		for(uint32 t : mVertexTriangles[to])
+		{
+			if(!mTriangleAlive[t])
+				continue;
+			const uint32* tri = &mIndices[t*3];
+			for(int k = 0; k < 3; ++k)
+			{
+				if(tri[k] != to)
+					mScratchB.push_back(tri[k]);
+			}
+		}
+
+		std::sort(mScratchA.begin(), mScratchA.end());
+		mScratchA.erase(std::unique(mScratchA.begin(), mScratchA.end()), mScratchA.end());
+		std::sort(mScratchB.begin(), mScratchB.end());
+		mScratchB.erase(std::unique(mScratchB.begin(), mScratchB.end()), mScratchB.end());
+
+		size_t shared = 0;
+		for(uint32 v : mScratchA)
+			shared += std::binary_search(mScratchB.begin(), mScratchB.end(), v) ? 1 : 0;
+		if(shared > 2)
+			return false;
+
+		// No remaining triangle may flip over or collapse to a sliver.
+		for(uint32 t : mVertexTriangles[from])
+		{
+			if(!mTriangleAlive[t])
+				continue;
+
+			const uint32* tri = &mIndices[t*3];
+			if(tri[0] == to || tri[1] == to || tri[2] == to)
+				continue;
+
+			XMVECTOR before = Normal(tri);
+			float beforeLength = XMVectorGetX(XMVector3Length(before));
+			if(beforeLength <= 0.0f)
+				continue;
+
+			uint32 moved[3] = { tri[0], tri[1], tri[2] };
+			for(int k = 0; k < 3; ++k)
+			{
+				if(moved[k] == from)
+					moved[k] = to;
+			}
+
+			XMVECTOR after = Normal(moved);
+			float afterLength = XMVectorGetX(XMVector3Length(after));
+			if(XMVectorGetX(XMVector3Dot(before, after)) <= 0.25f*beforeLength*afterLength)
+				return false;
+		}
+
+		return true;
+	}
+
+	void Simplifier::Apply(uint32 from, uint32 to)
+	{
+		for(uint32 t : mVertexTriangles[from])
+		{
+			if(!mTriangleAlive[t])
+				continue;
+
+			uint32* tri = &mIndices[t*3];
+			if(tri[0] == to || tri[1] == to || tri[2] == to)
+			{
+				mTriangleAlive[t] = 0;
+				--mTriangleCount;
+				continue;
+			}
+
+			for(int k = 0; k < 3; ++k)
+			{
+				if(tri[k] == from)
+					tri[k] = to;
+			}
+			mVertexTriangles[to].push_back(t);
+		}
+
+		mVertexTriangles[from].clear();
+		mVertexAlive[from] = 0;
+		mCollapsedInto[from] = to;
+		mQuadrics[to] += mQuadrics[from];
+		++mVersions[to];
+
+		auto& triangles = mVertexTriangles[to];
+		triangles.erase(std::remove_if(triangles.begin(), triangles.end(),
+			[this](uint32 t) { return !mTriangleAlive[t]; }), triangles.end());
+
+		for(uint32 t : triangles)
+		{
+			const uint32* tri = &mIndices[t*3];
+			for(int k = 0; k < 3; ++k)
+			{
+				if(tri[k] == to)
+					continue;
+				Push(tri[k], to);
+				Push(to, tri[k]);
+			}
+		}
+	}
+
+	bool Simplifier::Run(size_t targetTriangles, double maxErrorSq)
+	{
+		while(mTriangleCount > targetTriangles)
+		{
+			if(mQueue.empty())
+				return false;
+
+			Collapse collapse = mQueue.top();
+			mQueue.pop();
+
+			if(!mVertexAlive[collapse.From] || !mVertexAlive[collapse.To] ||
+				mVersions[collapse.From] != collapse.FromVersion ||
+				mVersions[collapse.To] != collapse.ToVersion)
+				continue;
+
+			if(collapse.Cost > maxErrorSq)
+			{
+				mQueue.push(collapse);
+				return false;
+			}
+
+			if(!CanCollapse(collapse.From, collapse.To))
+				continue;
+
+			Apply(collapse.From, collapse.To);
+		}
+
+		return true;
+	}
+
+	// Distance from p to triangle abc, through the closest point on it (Ericson,
+	// "Real-Time Collision Detection", 5.1.5).  Computed in double precision: the long
+	// slivers a flat region collapses to lose too much to cancellation in float.
+	struct Double3
+	{
+		double x, y, z;
+
+		Double3(double x, double y, double z) : x(x), y(y), z(z) {}
+		explicit Double3(const XMFLOAT3& p) : x(p.x), y(p.y), z(p.z) {}
+
+		Double3 operator+(const Double3& v)const { return Double3(x + v.x, y + v.y, z + v.z); }
+		Double3 operator-(const Double3& v)const { return Double3(x - v.x, y - v.y, z - v.z); }
+		Double3 operator*(double s)const { return Double3(x*s, y*s, z*s); }
+		double Dot(const Double3& v)const { return x*v.x + y*v.y + z*v.z; }
+	};
+
+	double DistanceToTriangle(const Double3& p, const Double3& a, const Double3& b, const Double3& c)
+	{
+		auto distanceTo = [&p](const Double3& q) { Double3 d = p - q; return std::sqrt(d.Dot(d)); };
+
+		Double3 ab = b - a;
+		Double3 ac = c - a;
+
+		Double3 ap = p - a;
+		double d1 = ab.Dot(ap);
+		double d2 = ac.Dot(ap);
+		if(d1 <= 0.0 && d2 <= 0.0)
+			return distanceTo(a);
+
+		Double3 bp = p - b;
+		double d3 = ab.Dot(bp);
+		double d4 = ac.Dot(bp);
+		if(d3 >= 0.0 && d4 <= d3)
+			return distanceTo(b);
+
+		double vc = d1*d4 - d3*d2;
+		if(vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+			return distanceTo(a + ab*(d1/(d1 - d3)));
+
+		Double3 cp = p - c;
+		double d5 = ab.Dot(cp);
+		double d6 = ac.Dot(cp);
+		if(d6 >= 0.0 && d5 <= d6)
+			return distanceTo(c);
+
+		double vb = d5*d2 - d1*d6;
+		if(vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+			return distanceTo(a + ac*(d2/(d2 - d6)));
+
+		double va = d3*d6 - d5*d4;
+		if(va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+			return distanceTo(b + (c - b)*((d4 - d3)/((d4 - d3) + (d5 - d6))));
+
+		double denom = va + vb + vc;
+		if(denom <= 0.0)
+			return distanceTo(a);
+		return distanceTo(a + ab*(vb/denom) + ac*(vc/denom));
+	}
+
+	double Simplifier::Distance(const XMFLOAT3& p, uint32 t)const
+	{
+		const uint32* tri = &mIndices[t*3];
+		return DistanceToTriangle(Double3(p),
+			Double3(mVertices[tri[0]].Position),
+			Double3(mVertices[tri[1]].Position),
+			Double3(mVertices[tri[2]].Position));
+	}
+
+	uint32 Simplifier::Survivor(uint32 v)const
+	{
+		while(!mVertexAlive[v])
+			v = mCollapsedInto[v];
+		return v;
+	}
+
+	float Simplifier::MeasureError()
+	{
+		double error = 0.0;
+		for(size_t v = 0; v < mVertices.size(); ++v)
+		{
+			if(mVertexAlive[v])
+				continue;
+
+			// The surviving triangles that replaced v's neighbourhood are the ones
+			// around the survivors of its original neighbours.
+			mScratchA.clear();
+			for(uint32 r = mRingOffsets[v]; r < mRingOffsets[v + 1]; ++r)
+			{
+				uint32 survivor = Survivor(mRings[r]);
+				for(uint32 t : mVertexTriangles[survivor])
+				{
+					if(mTriangleAlive[t])
+						mScratchA.push_back(t);
+				}
+			}
+			std::sort(mScratchA.begin(), mScratchA.end());
+			mScratchA.erase(std::unique(mScratchA.begin(), mScratchA.end()), mScratchA.end());
+
+			const XMFLOAT3& p = mVertices[v].Position;
+			double distance = DBL_MAX;
+			for(uint32 t : mScratchA)
+				distance = std::min(distance, Distance(p, t));
+
+			// Where the surface slid along itself the closest triangle can lie further
+			// away; confirm against all of them before raising the maximum.
+			if(distance > error)
+			{
+				for(size_t t = 0; t < mTriangleAlive.size() && distance > error; ++t)
+				{
+					if(mTriangleAlive[t])
+						distance = std::min(distance, Distance(p, (uint32)t));
+				}
+			}
+
+			if(distance != DBL_MAX)
+				error = std::max(error, distance);
+		}
+		return (float)error;
+	}
+
+	void Simplifier::AppendTriangles(std::vector<uint32>& indices)const
+	{
+		for(size_t t = 0; t < mTriangleAlive.size(); ++t)
+		{
+			if(mTriangleAlive[t])
+				indices.insert(indices.end(), &mIndices[t*3], &mIndices[t*3] + 3);
+		}
+	}
+}
+
+std::vector<MeshSimplifier::Lod> MeshSimplifier::BuildLodChain(GeometryGenerator::MeshData& mesh,
+	const LodOptions& options)
+{
+	const size_t indexCount = mesh.IndexCount();
+	const size_t triangleCount = indexCount / 3;
+
+	std::vector<Lod> lods(1);
+	lods[0].IndexCount = (uint32)indexCount;
+	if(triangleCount == 0 || options.Ratios.empty())
+		return lods;
+
+	std::vector<uint32> indices(indexCount);
+	for(size_t i = 0; i < indexCount; ++i)
+		indices[i] = mesh.GetIndex(i);
+
+	XMVECTOR vMin = XMLoadFloat3(&mesh.Vertices[0].Position);
+	XMVECTOR vMax = vMin;
+	for(const auto& v : mesh.Vertices)
+	{
+		vMin = XMVectorMin(vMin, XMLoadFloat3(&v.Position));
+		vMax = XMVectorMax(vMax, XMLoadFloat3(&v.Position));
+	}
+
+	XMVECTOR center = 0.5f*(vMin + vMax);
+	float radius = 0.0f;
+	for(const auto& v : mesh.Vertices)
+		radius = std::max(radius, XMVectorGetX(XMVector3Length(XMLoadFloat3(&v.Position) - center)));
+
+	const double maxError = (double)options.MaxError*radius;
+
+	Simplifier simplifier(mesh.Vertices, indices);
+
+	size_t previousTriangles = triangleCount;
+	for(float ratio : options.Ratios)
+	{
+		bool reached = simplifier.Run((size_t)(ratio*triangleCount), maxError*maxError);
+		if(simplifier.TriangleCount() >= previousTriangles)
+			break;
+
+		Lod lod;
+		lod.IndexStart = (uint32)indices.size();
+		simplifier.AppendTriangles(indices);
+		lod.IndexCount = (uint32)indices.size() - lod.IndexStart;
+		lod.Error = simplifier.MeasureError();
+
+		MeshOptimizer::OptimizeVertexCache(indices.data() + lod.IndexStart, lod.IndexCount,
+			mesh.Vertices.size(), MeshOptimizer::Options().CacheSize);
+
+		lods.push_back(lod);
+		previousTriangles = simplifier.TriangleCount();
+
+		if(!reached)
+			break;
+	}
+
+	mesh.AssignIndices(indices.data(), indices.size());
+	return lods;
+}
+
+float MeshSimplifier::ProjectedError(const Lod& lod, float scale, float distance, float pixelsPerUnit)
+{
+	return lod.Error*scale*pixelsPerUnit/std::max(distance, 1e-4f);
+}
+
+size_t MeshSimplifier::SelectLod(const std::vector<Lod>& lods, float scale, float distance,
+	float pixelsPerUnit, float maxPixels)
+{
+	size_t selected = 0;
+	for(size_t i = 1; i < lods.size(); ++i)
+	{
+		if(ProjectedError(lods[i], scale, distance, pixelsPerUnit) > maxPixels)
+			break;
+		selected = i;
+	}
+	return selected;
+}
@@ -0,0 +1,59 @@
+//***************************************************************************************
+// MeshSimplifier.h
+//
+// Builds levels of detail for an indexed triangle list by quadric error simplification
+// (Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997).
+//
+// Edges are collapsed onto one of their existing vertices, so every level indexes the
+// original vertex buffer and the levels are appended to the mesh's own index buffer.
+// Vertices on an open border or on a seam, where several vertices share a position
+// with different normals or texture coordinates, are never moved.  That keeps the
+// silhouette of caps and the texture seams of the generated shapes crack free.
+//***************************************************************************************
+
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include "GeometryGenerator.h"
+
+namespace MeshSimplifier
+{
+	using uint32 = GeometryGenerator::uint32;
+
+	// One level of detail: a range of the mesh's index buffer and the largest distance,
+	// in object-space units, from a removed vertex to the level's surface.
+	struct Lod
+	{
+		uint32 IndexStart = 0;
+		uint32 IndexCount = 0;
+		float Error = 0.0f;
+	};
+
+	struct LodOptions
+	{
+		// Triangle counts to aim for, as fractions of the original, in decreasing order.
+		std::vector<float> Ratios = { 0.5f, 0.25f, 0.125f };
+
+		// No collapse may have a quadric error (the area-weighted RMS distance to the
+		// planes it merges) above this fraction of the mesh's bounding radius.  The
+		// chain ends early once the next level would need one.
+		float MaxError = 0.05f;
+	};
+
+	// Simplifies mesh and appends each level's indices to its index buffer after the
+	// original triangles, which stay level 0.  Returns level 0 followed by every
+	// level that reached its ratio, plus the furthest level reached within MaxError
+	// when that stops the chain early.
+	std::vector<Lod> BuildLodChain(GeometryGenerator::MeshData& mesh, const LodOptions& options = LodOptions());
+
+	// Pixels the error of lod covers when its mesh is drawn scale times larger than in
+	// object space, at the given distance, with pixelsPerUnit pixels per world unit at
+	// distance 1 (half the viewport height times the projection's y scale).
+	float ProjectedError(const Lod& lod, float scale, float distance, float pixelsPerUnit);
+
+	// Coarsest level whose projected error stays within maxPixels.
+	size_t SelectLod(const std::vector<Lod>& lods, float scale, float distance,
+		float pixelsPerUnit, float maxPixels);
+}
+
+#endif // MESHSIMPLIFIER_H
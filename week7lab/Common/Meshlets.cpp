@@ -0,0 +1,369 @@
+//***************************************************************************************
+// Meshlets.cpp
+//***************************************************************************************
+
+#include "Meshlets.h"
+#include "VertexTriangles.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef GeometryGenerator::uint32 uint32;
+	typedef GeometryGenerator::Vertex Vertex;
+
+	const uint32 InvalidTriangle = ~0u;
+
+	// Sphere around the meshlet's bounding box, and the cone holding its face normals.
+	// The normal of triangle (p0, p1, p2) is (p1 - p0) x (p2 - p0), which points out of
+	// the clockwise front face the generator emits.
+	template<typename Index>
+	void ComputeBounds(Meshlets::Meshlet& meshlet, const Index* indices, const std::vector<Vertex>& vertices)
+	{
+		const Index* first = indices + meshlet.IndexStart;
+		const Index* last = first + meshlet.IndexCount;
+
+		XMVECTOR vMin = XMLoadFloat3(&vertices[*first].Position);
+		XMVECTOR vMax = vMin;
+		for(const Index* i = first; i != last; ++i)
+		{
+			XMVECTOR p = XMLoadFloat3(&vertices[*i].Position);
+			vMin = XMVectorMin(vMin, p);
+			vMax = XMVectorMax(vMax, p);
+		}
+
+		XMVECTOR center = 0.5f*(vMin + vMax);
+		float radius = 0.0f;
+		for(const Index* i = first; i != last; ++i)
+		{
+			XMVECTOR p = XMLoadFloat3(&vertices[*i].Position);
+			radius = std::max(radius, XMVectorGetX(XMVector3Length(p - center)));
+		}
+
+		XMStoreFloat3(&meshlet.Center, center);
+		meshlet.Radius = radius;
+
+		std::vector<XMFLOAT3> normals;
+		normals.reserve(meshlet.IndexCount / 3);
+		XMVECTOR normalSum = XMVectorZero();
+		for(const Index* i = first; i != last; i += 3)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&vertices[i[0]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[i[1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[i[2]].Position);
+
+			XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+			float length = XMVectorGetX(XMVector3Length(n));
+			if(length <= 0.0f)
+				continue;
+
+			n = n/length;
+			normals.push_back(XMFLOAT3());
+			XMStoreFloat3(&normals.back(), n);
+			normalSum += n;
+		}
+
+		meshlet.ConeAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		meshlet.ConeCutoff = 1.0f;
+
+		float sumLength = XMVectorGetX(XMVector3Length(normalSum));
+		if(sumLength <= 1e-6f)
+			return;
+
+		XMVECTOR axis = normalSum/sumLength;
+		float minDot = 1.0f;
+		for(const auto& n : normals)
+			minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(XMLoadFloat3(&n), axis)));
+
+		XMStoreFloat3(&meshlet.ConeAxis, axis);
+
+		// A cone of 90 degrees or more has no viewpoint that sees only back faces.
+		if(minDot > 0.0f)
+			meshlet.ConeCutoff = std::sqrt(1.0f - minDot*minDot);
+	}
+
+	// Grows each meshlet greedily across shared vertices, preferring the triangle that
+	// adds the fewest new vertices and then the one closest to the meshlet's centroid.
+	// A new meshlet starts next to the previous one, at the triangle with the fewest
+	// unclaimed neighbours, so the leftovers do not break up into scattered islands.
+	template<typename Index>
+	std::vector<Meshlets::Meshlet> BuildMeshlets(Index* indices, size_t indexCount,
+		const std::vector<Vertex>& vertices, uint32 maxVertices, uint32 maxTriangles)
+	{
+		const size_t triangleCount = indexCount / 3;
+		const size_t vertexCount = vertices.size();
+
+		VertexTriangles adjacency(indices, indexCount, vertexCount);
+
+		std::vector<uint32> liveTriangles(vertexCount);
+		for(size_t v = 0; v < vertexCount; ++v)
+			liveTriangles[v] = adjacency.Count((uint32)v);
+
+		std::vector<XMFLOAT3> centroids(triangleCount);
+		for(size_t t = 0; t < triangleCount; ++t)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t*3 + 0]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t*3 + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t*3 + 2]].Position);
+			XMStoreFloat3(&centroids[t], (p0 + p1 + p2)/3.0f);
+		}
+
+		std::vector<unsigned char> emitted(triangleCount, 0);
+
+		// Meshlet that last took each vertex, so membership needs no clearing.
+		std::vector<uint32> vertexMeshlet(vertexCount, ~0u);
+
+		std::vector<Index> reordered;
+		reordered.reserve(triangleCount*3);
+
+		std::vector<uint32> candidates;
+		std::vector<Meshlets::Meshlet> meshlets;
+
+		size_t cursor = 0;
+		size_t remaining = triangleCount;
+		while(remaining > 0)
+		{
+			const uint32 id = (uint32)meshlets.size();
+
+			uint32 next = InvalidTriangle;
+			uint32 bestLive = ~0u;
+			for(uint32 t : candidates)
+			{
+				if(emitted[t])
+					continue;
+
+				const Index* tri = indices + t*3;
+				uint32 live = liveTriangles[tri[0]] + liveTriangles[tri[1]] + liveTriangles[tri[2]];
+				if(live < bestLive)
+				{
+					next = t;
+					bestLive = live;
+				}
+			}
+			if(next == InvalidTriangle)
+			{
+				while(emitted[cursor])
+					++cursor;
+				next = (uint32)cursor;
+			}
+			candidates.clear();
+
+			Meshlets::Meshlet meshlet;
+			meshlet.IndexStart = (uint32)reordered.size();
+
+			XMVECTOR centroidSum = XMVectorZero();
+			uint32 meshletTriangles = 0;
+			uint32 meshletVertices = 0;
+
+			while(next != InvalidTriangle)
+			{
+				emitted[next] = 1;
+				--remaining;
+
+				const Index* tri = indices + next*3;
+				for(int k = 0; k < 3; ++k)
+				{
+					const uint32 v = tri[k];
+					reordered.push_back(tri[k]);
+					--liveTriangles[v];
+
+					if(vertexMeshlet[v] == id)
+						continue;
+
+					vertexMeshlet[v] = id;
+					++meshletVertices;
+					for(const uint32* t = adjacency.begin(v); t != adjacency.end(v); ++t)
+					{
+						if(!emitted[*t])
+							candidates.push_back(*t);
+					}
+				}
+
+				centroidSum += XMLoadFloat3(&centroids[next]);
+				if(++meshletTriangles == maxTriangles)
+					break;
+
+				XMVECTOR centroid = centroidSum/(float)meshletTriangles;
+
+				next = InvalidTriangle;
+				uint32 bestNew = 4;
+				float bestDistance = FLT_MAX;
+				for(size_t c = 0; c < candidates.size(); )
+				{
+					const uint32 t = candidates[c];
+					if(emitted[t])
+					{
+						candidates[c] = candidates.back();
+						candidates.pop_back();
+						continue;
+					}
+					++c;
+
+					const Index* candidate = indices + t*3;
+					uint32 newVertices = 0;
+					for(int k = 0; k < 3; ++k)
+						newVertices += vertexMeshlet[candidate[k]] != id ? 1 : 0;
+
+					if(meshletVertices + newVertices > maxVertices || newVertices > bestNew)
+						continue;
+
+					float distance = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&centroids[t]) - centroid));
+					if(newVertices < bestNew || distance < bestDistance)
+					{
+						next = t;
+						bestNew = newVertices;
+						bestDistance = distance;
+					}
+				}
+			}
+
+			meshlet.IndexCount = (uint32)reordered.size() - meshlet.IndexStart;
+			meshlet.VertexCount = meshletVertices;
+			meshlets.push_back(meshlet);
+		}
+
+		std::copy(reordered.begin(), reordered.end(), indices);
+
+		for(auto& meshlet : meshlets)
+			ComputeBounds(meshlet, indices, vertices);
+
+		return meshlets;
+	}
+}
+
+std::vector<Meshlets::Meshlet> Meshlets::Build(GeometryGenerator::MeshData& mesh,
+	uint32 maxVertices, uint32 maxTriangles)
+{
+	assert(maxVertices >= 3 && maxTriangles >= 1);
+
+	std::vector<Meshlet> meshlets;
+	mesh.VisitIndices([&](auto* indices)
+	{
+		meshlets = BuildMeshlets(indices, mesh.IndexCount(), mesh.Vertices, maxVertices, maxTriangles);
+	});
+	return meshlets;
+}
+
+Meshlets::CullParams Meshlets::MakeCullParams(FXMMATRIX world, CXMMATRIX viewProj,
+	FXMVECTOR eyePosW, bool cullBackfaces)
+{
+	CullParams params;
+
+	// Planes of the clip volume pulled back through world*viewProj (Gribb and Hartmann),
+	// which puts them straight into object space.
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, XMMatrixMultiply(world, viewProj));
+
+	auto column = [&m](int j) { return XMFLOAT4(m.m[0][j], m.m[1][j], m.m[2][j], m.m[3][j]); };
+	const XMFLOAT4 x = column(0);
+	const XMFLOAT4 y = column(1);
+	const XMFLOAT4 z = column(2);
+	const XMFLOAT4 w = column(3);
+
+	params.Planes[0] = XMFLOAT4(w.x + x.x, w.y + x.y, w.z + x.z, w.w + x.w);
+	params.Planes[1] = XMFLOAT4(w.x - x.x, w.y - x.y, w.z - x.z, w.w - x.w);
+	params.Planes[2] = XMFLOAT4(w.x + y.x, w.y + y.y, w.z + y.z, w.w + y.w);
+	params.Planes[3] = XMFLOAT4(w.x - y.x, w.y - y.y, w.z - y.z, w.w - y.w);
+	params.Planes[4] = z;
+	params.Planes[5] = XMFLOAT4(w.x - z.x, w.y - z.y, w.z - z.z, w.w - z.w);
+
+	XMVECTOR det = XMMatrixDeterminant(world);
+	XMMATRIX invWorld = XMMatrixInverse(&det, world);
+	XMStoreFloat3(&params.Eye, XMVector3TransformCoord(eyePosW, invWorld));
+
+	params.CullBackfaces = cullBackfaces;
+	return params;
+}
+
+bool Meshlets::IsSphereVisible(const XMFLOAT3& center, float radius, const CullParams& params)
+{
+	const XMFLOAT3& c = center;
+
+	for(const auto& plane : params.Planes)
+	{
+		float distance = plane.x*c.x + plane.y*c.y + plane.z*c.z + plane.w;
+		float scale = std::sqrt(plane.x*plane.x + plane.y*plane.y + plane.z*plane.z);
+		if(distance < -radius*scale)
+			return false;
+	}
+
+	return true;
+}
+
+void Meshlets::BoundingSphere(const std::vector<Meshlet>& meshlets, XMFLOAT3& center, float& radius)
+{
+	center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	radius = 0.0f;
+	if(meshlets.empty())
+		return;
+
+	XMFLOAT3 lo(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for(const Meshlet& meshlet : meshlets)
+	{
+		const XMFLOAT3& c = meshlet.Center;
+		lo = XMFLOAT3(std::min(lo.x, c.x - meshlet.Radius), std::min(lo.y, c.y - meshlet.Radius), std::min(lo.z, c.z - meshlet.Radius));
+		hi = XMFLOAT3(std::max(hi.x, c.x + meshlet.Radius), std::max(hi.y, c.y + meshlet.Radius), std::max(hi.z, c.z + meshlet.Radius));
+	}
+
+	center = XMFLOAT3(0.5f*(lo.x + hi.x), 0.5f*(lo.y + hi.y), 0.5f*(lo.z + hi.z));
+	for(const Meshlet& meshlet : meshlets)
+	{
+		const XMFLOAT3& c = meshlet.Center;
+		XMFLOAT3 d(c.x - center.x, c.y - center.y, c.z - center.z);
+		radius = std::max(radius, std::sqrt(d.x*d.x + d.y*d.y + d.z*d.z) + meshlet.Radius);
+	}
+}
+
+bool Meshlets::IsVisible(const Meshlet& meshlet, const CullParams& params)
+{
+	const XMFLOAT3& c = meshlet.Center;
+
+	if(!IsSphereVisible(c, meshlet.Radius, params))
+		return false;
+
+	// Every face is a back face when the view direction to the whole sphere stays
+	// within 90 degrees minus the cone's half angle of the cone axis.
+	if(params.CullBackfaces && meshlet.ConeCutoff < 1.0f)
+	{
+		XMFLOAT3 d(c.x - params.Eye.x, c.y - params.Eye.y, c.z - params.Eye.z);
+		float length = std::sqrt(d.x*d.x + d.y*d.y + d.z*d.z);
+		float along = d.x*meshlet.ConeAxis.x + d.y*meshlet.ConeAxis.y + d.z*meshlet.ConeAxis.z;
+		if(along >= meshlet.ConeCutoff*length + meshlet.Radius)
+			return false;
+	}
+
+	return true;
+}
+
+size_t Meshlets::Cull(const std::vector<Meshlet>& meshlets, const CullParams& params,
+	std::vector<IndexRange>& ranges)
+{
+	ranges.clear();
+
+	size_t visible = 0;
+	for(const auto& meshlet : meshlets)
+	{
+		if(!IsVisible(meshlet, params))
+			continue;
+
+		++visible;
+		if(!ranges.empty() && ranges.back().Start + ranges.back().Count == meshlet.IndexStart)
+		{
+			ranges.back().Count += meshlet.IndexCount;
+		}
+		else
+		{
+			IndexRange range;
+			range.Start = meshlet.IndexStart;
+			range.Count = meshlet.IndexCount;
+			ranges.push_back(range);
+		}
+	}
+
+	return visible;
+}
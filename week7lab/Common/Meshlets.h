@@ -0,0 +1,88 @@
+//***************************************************************************************
+// Meshlets.h
+//
+// Splits an indexed triangle list into small clusters ("meshlets") that can be culled
+// one at a time on the CPU.  Building reorders the mesh's indices so every meshlet is a
+// contiguous range of the index buffer; culling returns the ranges that survive.
+//
+// Each meshlet carries a bounding sphere for frustum culling and a normal cone for
+// backface culling, both in the mesh's object space.  Culling is done in object space
+// too, so render items with non-uniform scale need no bound inflation.
+//***************************************************************************************
+
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include "GeometryGenerator.h"
+
+namespace Meshlets
+{
+	using uint32 = GeometryGenerator::uint32;
+
+	// Limits suited to a mesh shader's output; the index-range draw path does not
+	// need them but keeps the meshlets small enough to cull finely.
+	const uint32 MaxVertices = 64;
+	const uint32 MaxTriangles = 124;
+
+	struct Meshlet
+	{
+		// Range of the mesh's reordered index buffer drawn by this meshlet.
+		uint32 IndexStart = 0;
+		uint32 IndexCount = 0;
+
+		// Distinct vertices the meshlet's triangles reference.
+		uint32 VertexCount = 0;
+
+		DirectX::XMFLOAT3 Center = { 0.0f, 0.0f, 0.0f };
+		float Radius = 0.0f;
+
+		// Every triangle normal lies within the cone around ConeAxis.  ConeCutoff is the
+		// sine of the cone's half angle; 1 means the cone is too wide to ever cull.
+		DirectX::XMFLOAT3 ConeAxis = { 0.0f, 0.0f, 0.0f };
+		float ConeCutoff = 1.0f;
+	};
+
+	struct IndexRange
+	{
+		uint32 Start = 0;
+		uint32 Count = 0;
+	};
+
+	// Camera state for one render item, expressed in the item's object space.
+	struct CullParams
+	{
+		// Left, right, bottom, top, near, far; a point p is inside when
+		// dot(plane.xyz, p) + plane.w >= 0.  The normals are not unit length.
+		DirectX::XMFLOAT4 Planes[6];
+
+		DirectX::XMFLOAT3 Eye = { 0.0f, 0.0f, 0.0f };
+
+		// Pipelines that draw both faces must turn this off.
+		bool CullBackfaces = true;
+	};
+
+	// Reorders mesh's indices into meshlets of at most maxVertices vertices and
+	// maxTriangles triangles and returns them in index-buffer order.
+	std::vector<Meshlet> Build(GeometryGenerator::MeshData& mesh,
+		uint32 maxVertices = MaxVertices, uint32 maxTriangles = MaxTriangles);
+
+	// Object-space culling parameters for an item drawn with the given world matrix.
+	CullParams MakeCullParams(DirectX::FXMMATRIX world, DirectX::CXMMATRIX viewProj,
+		DirectX::FXMVECTOR eyePosW, bool cullBackfaces);
+
+	bool IsVisible(const Meshlet& meshlet, const CullParams& params);
+
+	// Frustum test alone, for a sphere in the same object space as params.
+	bool IsSphereVisible(const DirectX::XMFLOAT3& center, float radius, const CullParams& params);
+
+	// A sphere enclosing every meshlet's bounding sphere, for culling the mesh as a
+	// whole.  Not the smallest one: it is centred on the box around the spheres.
+	void BoundingSphere(const std::vector<Meshlet>& meshlets, DirectX::XMFLOAT3& center, float& radius);
+
+	// Replaces ranges with the index ranges of the visible meshlets, joining neighbours
+	// into one range.  Returns the number of visible meshlets.
+	size_t Cull(const std::vector<Meshlet>& meshlets, const CullParams& params,
+		std::vector<IndexRange>& ranges);
+}
+
+#endif // MESHLETS_H
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+// A default-heap buffer that is filled through the mapped memory of its upload buffer.
+// The producer writes the final bytes straight into the upload heap, so the data is
+// written once on the CPU instead of being built in system memory and copied across.
+//
+// The mapped memory is write-combined: write it sequentially, preferably in whole
+// elements, and never read it back.
+class StagingBuffer
+{
+public:
+    StagingBuffer(ID3D12Device* device, UINT64 byteSize) :
+        mByteSize(byteSize)
+    {
+        ThrowIfFailed(device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+            D3D12_RESOURCE_STATE_COMMON,
+            nullptr,
+            IID_PPV_ARGS(&mDefaultBuffer)));
+
+        ThrowIfFailed(device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(&mUploadBuffer)));
+
+        // The CPU never reads through this mapping.
+        CD3DX12_RANGE readRange(0, 0);
+        ThrowIfFailed(mUploadBuffer->Map(0, &readRange, &mMappedData));
+    }
+
+    StagingBuffer(const StagingBuffer& rhs) = delete;
+    StagingBuffer& operator=(const StagingBuffer& rhs) = delete;
+    ~StagingBuffer()
+    {
+        if(mMappedData != nullptr)
+            mUploadBuffer->Unmap(0, nullptr);
+    }
+
+    UINT64 ByteSize()const
+    {
+        return mByteSize;
+    }
+
+    // Where the producer writes the buffer's contents, until Finish.
+    void* Data()const
+    {
+        assert(mMappedData != nullptr);
+        return mMappedData;
+    }
+
+    template<typename T>
+    T* Elements()const
+    {
+        return static_cast<T*>(Data());
+    }
+
+    // Unmaps the upload buffer and records its copy into the default buffer, which is
+    // returned.  As with d3dUtil::CreateDefaultBuffer, uploadBuffer has to be kept alive
+    // until the command list has executed.
+    Microsoft::WRL::ComPtr<ID3D12Resource> Finish(ID3D12GraphicsCommandList* cmdList,
+        Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer)
+    {
+        assert(mMappedData != nullptr);
+        mUploadBuffer->Unmap(0, nullptr);
+        mMappedData = nullptr;
+
+        cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDefaultBuffer.Get(),
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST));
+        cmdList->CopyBufferRegion(mDefaultBuffer.Get(), 0, mUploadBuffer.Get(), 0, mByteSize);
+        cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDefaultBuffer.Get(),
+            D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+
+        uploadBuffer = mUploadBuffer;
+        return mDefaultBuffer;
+    }
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Resource> mDefaultBuffer;
+    Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
+    void* mMappedData = nullptr;
+
+    UINT64 mByteSize = 0;
+};
@@ -0,0 +1,243 @@
+//***************************************************************************************
+// TaskScheduler.cpp
+//***************************************************************************************
+
+#include "TaskScheduler.h"
+
+#if defined(_WIN32)
+	#include <windows.h>
+#elif defined(__linux__)
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+namespace
+{
+	// Identifies the pool (if any) the current thread works for, so nested ParallelFor
+	// calls push onto the worker's own deque instead of the shared one.
+	thread_local const TaskScheduler* tOwner = nullptr;
+	thread_local unsigned tWorkerIndex = 0;
+}
+
+TaskScheduler::TaskScheduler(unsigned workerCount, bool pinWorkers)
+	: mQueuedTasks(0)
+{
+	if(workerCount == AutoWorkerCount)
+	{
+		unsigned hw = std::thread::hardware_concurrency();
+		workerCount = hw > 1 ? hw - 1 : 0;
+	}
+
+	for(unsigned i = 0; i < workerCount + 1; ++i)
+		mQueues.push_back(std::make_unique<WorkQueue>());
+
+	mWorkers.reserve(workerCount);
+	for(unsigned i = 0; i < workerCount; ++i)
+		mWorkers.emplace_back(&TaskScheduler::WorkerMain, this, i, pinWorkers);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(mWakeLock);
+		mStop = true;
+	}
+	mWake.notify_all();
+
+	for(auto& w : mWorkers)
+		w.join();
+}
+
+unsigned TaskScheduler::ThreadCount()const
+{
+	return (unsigned)mWorkers.size() + 1;
+}
+
+void TaskScheduler::ParallelFor(int begin, int end, int chunkSize, const RangeFn& body)
+{
+	if(end <= begin)
+		return;
+
+	int count = end - begin;
+	if(chunkSize <= 0)
+	{
+		chunkSize = count / (int)(4*ThreadCount());
+		if(chunkSize < 1)
+			chunkSize = 1;
+	}
+
+	int numChunks = (count + chunkSize - 1) / chunkSize;
+	if(numChunks == 1 || mWorkers.empty())
+	{
+		body(begin, end);
+		return;
+	}
+
+	Loop loop;
+	loop.Remaining.store(numChunks);
+	loop.Failed.store(false);
+
+	// Threads outside the pool share the last queue.
+	unsigned home = (tOwner == this) ? tWorkerIndex : (unsigned)mWorkers.size();
+	unsigned queueCount = (unsigned)mQueues.size();
+
+	// Deal the chunks round-robin so every worker starts with local work and only
+	// steals once its own deque runs dry.
+	mQueuedTasks.fetch_add(numChunks);
+	for(unsigned q = 0; q < queueCount && (int)q < numChunks; ++q)
+	{
+		WorkQueue& queue = *mQueues[(home + q) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.Lock);
+		for(int c = (int)q; c < numChunks; c += (int)queueCount)
+		{
+			Task task;
+			task.Body = &body;
+			task.Begin = begin + c*chunkSize;
+			task.End = (task.Begin + chunkSize < end) ? task.Begin + chunkSize : end;
+			task.Owner = &loop;
+			queue.Tasks.push_back(task);
+		}
+	}
+
+	{
+		// Taking the lock orders the wake-up after any worker's predicate check.
+		std::lock_guard<std::mutex> lock(mWakeLock);
+	}
+	mWake.notify_all();
+
+	// Help out until our own loop is done; this may also run tasks of other loops.
+	// With nothing left to take, sleep until the last chunk finishes or more work
+	// is queued.
+	Task task;
+	while(loop.Remaining.load(std::memory_order_acquire) > 0)
+	{
+		if(PopOrSteal(home, task))
+		{
+			Run(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mWakeLock);
+		mWake.wait(lock, [this, &loop]()
+		{
+			return loop.Remaining.load(std::memory_order_acquire) == 0 || mQueuedTasks.load() > 0;
+		});
+	}
+
+	if(loop.Error)
+		std::rethrow_exception(loop.Error);
+}
+
+TaskScheduler& TaskScheduler::Default()
+{
+	static TaskScheduler scheduler;
+	return scheduler;
+}
+
+void TaskScheduler::WorkerMain(unsigned index, bool pin)
+{
+	tOwner = this;
+	tWorkerIndex = index;
+
+	if(pin)
+		PinCurrentThread(index + 1);
+
+	for(;;)
+	{
+		Task task;
+		if(PopOrSteal(index, task))
+		{
+			Run(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mWakeLock);
+		mWake.wait(lock, [this]() { return mStop || mQueuedTasks.load() > 0; });
+		if(mStop && mQueuedTasks.load() == 0)
+			return;
+	}
+}
+
+bool TaskScheduler::PopOrSteal(unsigned home, Task& task)
+{
+	unsigned queueCount = (unsigned)mQueues.size();
+
+	// Own work first, newest end (still warm in cache)...
+	{
+		WorkQueue& queue = *mQueues[home];
+		std::lock_guard<std::mutex> lock(queue.Lock);
+		if(!queue.Tasks.empty())
+		{
+			task = queue.Tasks.back();
+			queue.Tasks.pop_back();
+			mQueuedTasks.fetch_sub(1);
+			return true;
+		}
+	}
+
+	// ...then steal the oldest task of the next busy queue.
+	for(unsigned k = 1; k < queueCount; ++k)
+	{
+		WorkQueue& queue = *mQueues[(home + k) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.Lock);
+		if(!queue.Tasks.empty())
+		{
+			task = queue.Tasks.front();
+			queue.Tasks.pop_front();
+			mQueuedTasks.fetch_sub(1);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void TaskScheduler::Run(const Task& task)
+{
+	Loop& loop = *task.Owner;
+
+	// Once a chunk has failed the rest of its loop is skipped.
+	if(!loop.Failed.load(std::memory_order_relaxed))
+	{
+		try
+		{
+			(*task.Body)(task.Begin, task.End);
+		}
+		catch(...)
+		{
+			std::lock_guard<std::mutex> lock(loop.ErrorLock);
+			if(!loop.Error)
+				loop.Error = std::current_exception();
+			loop.Failed.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	if(loop.Remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		// The caller may be asleep.  Taking the lock orders the wake-up after its
+		// predicate check.
+		{
+			std::lock_guard<std::mutex> lock(mWakeLock);
+		}
+		mWake.notify_all();
+	}
+}
+
+void TaskScheduler::PinCurrentThread(unsigned processor)
+{
+	unsigned hw = std::thread::hardware_concurrency();
+	if(hw != 0)
+		processor %= hw;
+
+#if defined(_WIN32)
+	if(processor < sizeof(DWORD_PTR)*8)
+		SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << processor);
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(processor, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+	(void)processor;
+#endif
+}
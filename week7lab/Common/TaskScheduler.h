@@ -0,0 +1,94 @@
+//***************************************************************************************
+// TaskScheduler.h
+//
+// Small portable work-stealing thread pool.  Each worker owns a deque of tasks: the
+// owner pops from the back and idle workers steal from the front of the others.  The
+// thread that calls ParallelFor takes part in the work until its loop is finished, so
+// nested calls from inside a task are allowed.
+//***************************************************************************************
+
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskScheduler
+{
+public:
+	// Range body; invoked with a half-open sub-range [begin, end) of the loop.
+	typedef std::function<void(int, int)> RangeFn;
+
+	// AutoWorkerCount uses one worker per hardware thread minus the caller; 0 makes a
+	// pool in which the calling thread runs every task itself.  When pinWorkers is
+	// set, worker k is bound to logical processor k+1 so that the calling thread keeps
+	// processor 0 to itself.
+	static const unsigned AutoWorkerCount = ~0u;
+	explicit TaskScheduler(unsigned workerCount = AutoWorkerCount, bool pinWorkers = false);
+	TaskScheduler(const TaskScheduler& rhs) = delete;
+	TaskScheduler& operator=(const TaskScheduler& rhs) = delete;
+	~TaskScheduler();
+
+	// Number of threads that execute tasks, including the caller.
+	unsigned ThreadCount()const;
+
+	// Splits [begin, end) into chunks of chunkSize iterations and runs body on them in
+	// parallel.  chunkSize <= 0 picks a size that gives every thread a few chunks.
+	// Returns once every chunk has finished.  If a chunk throws, the chunks not yet
+	// started are skipped and the first exception is rethrown here.
+	void ParallelFor(int begin, int end, int chunkSize, const RangeFn& body);
+
+	// Process-wide scheduler shared by systems that do not need their own.
+	static TaskScheduler& Default();
+
+private:
+	// Shared by the chunks of one ParallelFor call.
+	struct Loop
+	{
+		std::atomic<int> Remaining;
+		std::atomic<bool> Failed;
+		std::mutex ErrorLock;
+		std::exception_ptr Error;
+	};
+
+	struct Task
+	{
+		const RangeFn* Body = nullptr;
+		int Begin = 0;
+		int End = 0;
+		Loop* Owner = nullptr;
+	};
+
+	struct WorkQueue
+	{
+		std::mutex Lock;
+		std::deque<Task> Tasks;
+	};
+
+	void WorkerMain(unsigned index, bool pin);
+	bool PopOrSteal(unsigned home, Task& task);
+	void Run(const Task& task);
+
+	static void PinCurrentThread(unsigned processor);
+
+private:
+	std::vector<std::thread> mWorkers;
+
+	// One queue per worker plus a final shared queue for threads outside the pool.
+	std::vector<std::unique_ptr<WorkQueue>> mQueues;
+
+	// Wakes workers when tasks are queued and callers when their loop finishes.
+	std::mutex mWakeLock;
+	std::condition_variable mWake;
+	std::atomic<int> mQueuedTasks;
+	bool mStop = false;
+};
+
+#endif // TASKSCHEDULER_H
@@ -10,6 +10,7 @@ public:
         mIsConstantBuffer(isConstantBuffer)
     {
         mElementByteSize = sizeof(T);
+        mElementCount = elementCount;
 
         // Constant buffer elements need to be multiples of 256 bytes.
         // This is because the hardware can only view constant data 
@@ -55,10 +56,24 @@ public:
         memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
     }
 
+    // Exposes elements [firstElement, firstElement+elementCount) of the mapped memory so
+    // a producer can write them in bulk.  Only for vertex/index style buffers, whose
+    // elements are tightly packed.  The memory is write-combined: write it sequentially
+    // and never read it back.
+    T* MapRange(UINT firstElement, UINT elementCount)
+    {
+        assert(!mIsConstantBuffer);
+        assert(firstElement + elementCount <= mElementCount);
+        (void)elementCount;
+
+        return reinterpret_cast<T*>(&mMappedData[firstElement*mElementByteSize]);
+    }
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
     BYTE* mMappedData = nullptr;
 
     UINT mElementByteSize = 0;
+    UINT mElementCount = 0;
     bool mIsConstantBuffer = false;
 };
\ No newline at end of file
@@ -0,0 +1,186 @@
+//***************************************************************************************
+// VertexPacker.h
+//
+// Converts GeometryGenerator vertices into an app's own vertex format.  A format is
+// declared once as a list of fields, each naming a GeometryGenerator attribute and the
+// byte offset it goes to in the app's vertex:
+//
+//   using PackedVertex = VertexPacker::Layout<Vertex,
+//       VertexPacker::Field<VertexPacker::Attribute::Position, offsetof(Vertex, Pos)>,
+//       VertexPacker::Field<VertexPacker::Attribute::TexC, offsetof(Vertex, TexC)>>;
+//
+// At compile time the list becomes a fixed set of copies, with fields that are adjacent
+// in both formats merged into one.  Every copy has a constant size, so a vertex packs
+// in a handful of unaligned vector moves with no per-field branching, and large meshes
+// are split across the task scheduler.
+//***************************************************************************************
+
+#ifndef VERTEXPACKER_H
+#define VERTEXPACKER_H
+
+#include "GeometryGenerator.h"
+#include "TaskScheduler.h"
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+namespace VertexPacker
+{
+	enum class Attribute { Position, Normal, TangentU, TexC };
+
+	// Where each attribute lives in a GeometryGenerator::Vertex.
+	template<Attribute A> struct Source;
+
+	template<> struct Source<Attribute::Position>
+	{
+		static const size_t Offset = offsetof(GeometryGenerator::Vertex, Position);
+		static const size_t Size = sizeof(DirectX::XMFLOAT3);
+	};
+
+	template<> struct Source<Attribute::Normal>
+	{
+		static const size_t Offset = offsetof(GeometryGenerator::Vertex, Normal);
+		static const size_t Size = sizeof(DirectX::XMFLOAT3);
+	};
+
+	template<> struct Source<Attribute::TangentU>
+	{
+		static const size_t Offset = offsetof(GeometryGenerator::Vertex, TangentU);
+		static const size_t Size = sizeof(DirectX::XMFLOAT3);
+	};
+
+	template<> struct Source<Attribute::TexC>
+	{
+		static const size_t Offset = offsetof(GeometryGenerator::Vertex, TexC);
+		static const size_t Size = sizeof(DirectX::XMFLOAT2);
+	};
+
+	// Attribute A, copied unchanged to byte TargetOffset of the packed vertex.
+	template<Attribute A, size_t TargetOffset>
+	struct Field
+	{
+		static const size_t SourceOffset = Source<A>::Offset;
+		static const size_t Offset = TargetOffset;
+		static const size_t Size = Source<A>::Size;
+	};
+
+	namespace Detail
+	{
+		// Size bytes copied from SourceOffset of a source vertex to TargetOffset of a
+		// packed one.
+		template<size_t SourceOffset, size_t TargetOffset, size_t Size>
+		struct Run
+		{
+			static void Copy(const unsigned char* source, unsigned char* target)
+			{
+				memcpy(target + TargetOffset, source + SourceOffset, Size);
+			}
+		};
+
+		template<typename... Runs>
+		struct RunList
+		{
+			static void Copy(const unsigned char* source, unsigned char* target)
+			{
+				int expand[] = { 0, (Runs::Copy(source, target), 0)... };
+				(void)expand;
+			}
+		};
+
+		// Folds a field list into runs, extending the current run while the next field
+		// follows it directly in both formats.
+		template<typename Done, typename Current, typename... Fields>
+		struct Merge;
+
+		template<bool Adjacent, typename Done, typename Current, typename Next, typename... Rest>
+		struct MergeStep;
+
+		template<typename... Done, typename Current>
+		struct Merge<RunList<Done...>, Current>
+		{
+			using Type = RunList<Done..., Current>;
+		};
+
+		template<typename Done, size_t S, size_t T, size_t N, typename Next, typename... Rest>
+		struct Merge<Done, Run<S, T, N>, Next, Rest...>
+		{
+			using Type = typename MergeStep<Next::SourceOffset == S + N && Next::Offset == T + N,
+				Done, Run<S, T, N>, Next, Rest...>::Type;
+		};
+
+		template<typename Done, size_t S, size_t T, size_t N, typename Next, typename... Rest>
+		struct MergeStep<true, Done, Run<S, T, N>, Next, Rest...>
+		{
+			using Type = typename Merge<Done, Run<S, T, N + Next::Size>, Rest...>::Type;
+		};
+
+		template<typename... Done, typename Current, typename Next, typename... Rest>
+		struct MergeStep<false, RunList<Done...>, Current, Next, Rest...>
+		{
+			using Type = typename Merge<RunList<Done..., Current>,
+				Run<Next::SourceOffset, Next::Offset, Next::Size>, Rest...>::Type;
+		};
+
+		template<size_t TargetSize, typename... Fields>
+		struct FitsIn : std::true_type {};
+
+		template<size_t TargetSize, typename First, typename... Rest>
+		struct FitsIn<TargetSize, First, Rest...> : std::integral_constant<bool,
+			First::Offset + First::Size <= TargetSize && FitsIn<TargetSize, Rest...>::value> {};
+
+		// Vertices packed per task; small meshes stay on the calling thread.
+		const size_t VerticesPerTask = 16384;
+	}
+
+	template<typename TargetVertex, typename First, typename... Rest>
+	class Layout
+	{
+	public:
+		using Target = TargetVertex;
+
+		static_assert(std::is_trivially_copyable<Target>::value, "Packed vertices must be plain data.");
+		static_assert(Detail::FitsIn<sizeof(Target), First, Rest...>::value,
+			"A field runs past the end of the packed vertex.");
+
+		// Packs count vertices into target, then calls transform(source, packed) on each
+		// one, e.g. to displace it.  Fields the layout does not list are left as they
+		// were.  transform may run on several threads at once.
+		template<typename Transform>
+		static void Pack(const GeometryGenerator::Vertex* source, size_t count, Target* target, const Transform& transform)
+		{
+			auto packRange = [source, target, &transform](size_t begin, size_t end)
+			{
+				for(size_t i = begin; i < end; ++i)
+				{
+					Runs::Copy(reinterpret_cast<const unsigned char*>(&source[i]),
+						reinterpret_cast<unsigned char*>(&target[i]));
+					transform(source[i], target[i]);
+				}
+			};
+
+			if(count <= Detail::VerticesPerTask)
+			{
+				packRange(0, count);
+				return;
+			}
+
+			int taskCount = (int)((count + Detail::VerticesPerTask - 1) / Detail::VerticesPerTask);
+			TaskScheduler::Default().ParallelFor(0, taskCount, 1, [&packRange, count](int t0, int t1)
+			{
+				size_t end = (size_t)t1*Detail::VerticesPerTask;
+				packRange((size_t)t0*Detail::VerticesPerTask, end < count ? end : count);
+			});
+		}
+
+		static void Pack(const GeometryGenerator::Vertex* source, size_t count, Target* target)
+		{
+			Pack(source, count, target, [](const GeometryGenerator::Vertex&, Target&) {});
+		}
+
+	private:
+		using Runs = typename Detail::Merge<Detail::RunList<>,
+			Detail::Run<First::SourceOffset, First::Offset, First::Size>, Rest...>::Type;
+	};
+}
+
+#endif // VERTEXPACKER_H
@@ -0,0 +1,41 @@
+//***************************************************************************************
+// VertexTriangles.h
+//
+// Vertex-to-triangle adjacency of an indexed triangle list, shared by the mesh passes
+// in MeshOptimizer.cpp and Meshlets.cpp.  Not meant for use outside them.
+//***************************************************************************************
+
+#ifndef VERTEXTRIANGLES_H
+#define VERTEXTRIANGLES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Triangles that use each vertex, as one flat list with per-vertex offsets.
+struct VertexTriangles
+{
+	std::vector<std::uint32_t> Offsets;
+	std::vector<std::uint32_t> Triangles;
+
+	template<typename Index>
+	VertexTriangles(const Index* indices, size_t indexCount, size_t vertexCount)
+	{
+		Offsets.assign(vertexCount + 1, 0);
+		for(size_t i = 0; i < indexCount; ++i)
+			++Offsets[indices[i] + 1];
+		for(size_t v = 0; v < vertexCount; ++v)
+			Offsets[v + 1] += Offsets[v];
+
+		std::vector<std::uint32_t> fill(Offsets.begin(), Offsets.end() - 1);
+		Triangles.resize(indexCount);
+		for(size_t i = 0; i < indexCount; ++i)
+			Triangles[fill[indices[i]]++] = (std::uint32_t)(i / 3);
+	}
+
+	std::uint32_t Count(std::uint32_t v)const { return Offsets[v + 1] - Offsets[v]; }
+	const std::uint32_t* begin(std::uint32_t v)const { return Triangles.data() + Offsets[v]; }
+	const std::uint32_t* end(std::uint32_t v)const { return Triangles.data() + Offsets[v + 1]; }
+};
+
+#endif // VERTEXTRIANGLES_H
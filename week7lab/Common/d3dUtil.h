@@ -160,7 +160,8 @@ struct MeshGeometry
 	std::string Name;
 
 	// System memory copies.  Use Blobs because the vertex/index format can be generic.
-	// It is up to the client to cast appropriately. 
+	// It is up to the client to cast appropriately.  These are optional; leave them
+	// null when nothing reads the geometry back on the CPU.
 
 	Microsoft::WRL::ComPtr<ID3DBlob> VertexBufferCPU = nullptr;
 	Microsoft::WRL::ComPtr<ID3DBlob> IndexBufferCPU = nullptr;
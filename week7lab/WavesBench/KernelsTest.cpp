@@ -0,0 +1,190 @@
+//***************************************************************************************
+// KernelsTest.cpp
+//
+// Checks that the vectorized stencil kernels match StencilRowScalar bit for bit.  Every
+// kernel the CPU supports advances the same reference grid for a number of steps, at
+// every row length and start offset that exercises its unaligned heads and tails, and
+// the heights are compared with memcmp.
+//
+// SampleBilinear is checked on a grid holding a bilinear function, which bilinear
+// sampling reproduces exactly.  A batch whose size is not a multiple of four, with
+// points inside, exactly on the last row and column, and off every edge, must match
+// the function at the clamped point, and must equal sampling each point on its own,
+// which goes through the scalar tail.  Heights and normals are both compared.  Prints
+// each mismatch and returns nonzero if there was any.
+//***************************************************************************************
+
+#include "WavesKernels.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+	const int Rows = 67;
+	const int Cols = 131;
+	const int Steps = 8;
+
+	// Constants from Waves' construction with dx 1, dt 0.03, speed 4, damping 0.2.
+	const float K1 = -0.9946f;
+	const float K2 = 1.9768f;
+	const float K3 = 0.0143f;
+
+	// Runs Steps steps of kernel over cells [first, first + count) of every inner row of
+	// the reference grid, swapping the buffers after each step like Waves does.
+	std::vector<float> Run(WaveKernels::StencilRowFn kernel, int first, int count)
+	{
+		std::mt19937 random(2001);
+		std::uniform_real_distribution<float> height(-1.0f, 1.0f);
+
+		std::vector<float> prev(Rows*Cols);
+		std::vector<float> curr(Rows*Cols);
+		for(float& h : prev)
+			h = height(random);
+		for(float& h : curr)
+			h = height(random);
+
+		for(int s = 0; s < Steps; ++s)
+		{
+			for(int i = 1; i < Rows - 1; ++i)
+			{
+				int k = i*Cols + first;
+				kernel(&prev[k], &curr[k], &curr[k - Cols], &curr[k + Cols], count, K1, K2, K3);
+			}
+			prev.swap(curr);
+		}
+		return curr;
+	}
+
+	// Grid of SampleRows x SampleCols vertices holding h = a*c + b*r + e*c*r at column
+	// c and row r.
+	const int SampleRows = 9;
+	const int SampleCols = 13;
+	const float SampleDx = 0.5f;
+	const float SampleX0 = -3.0f;
+	const float SampleZ0 = 2.0f;
+	const float A = 0.25f, B = -0.5f, E = 0.02f;
+
+	int CheckSampling()
+	{
+		std::vector<float> h(SampleRows*SampleCols);
+		for(int r = 0; r < SampleRows; ++r)
+			for(int c = 0; c < SampleCols; ++c)
+				h[r*SampleCols + c] = A*c + B*r + E*c*r;
+
+		const float xMax = SampleX0 + (SampleCols - 1)*SampleDx;
+		const float zMin = SampleZ0 - (SampleRows - 1)*SampleDx;
+		std::vector<float> xz =
+		{
+			-1.3f, 0.7f,   0.1f, -1.9f,   2.2f, 1.1f,   -2.6f, -0.4f,
+			xMax, 0.3f,    -0.8f, zMin,   xMax, zMin,   SampleX0, SampleZ0,
+			-40.0f, 0.5f,  40.0f, -1.0f,  0.0f, 40.0f,  1.5f, -40.0f,
+			-40.0f, 40.0f, 40.0f, -40.0f, xMax + 0.2f, zMin - 0.2f,
+		};
+		std::mt19937 random(16);
+		std::uniform_real_distribution<float> x(SampleX0 - 1.0f, xMax + 1.0f);
+		std::uniform_real_distribution<float> z(zMin - 1.0f, SampleZ0 + 1.0f);
+		for(int k = 0; k < 8; ++k)
+		{
+			xz.push_back(x(random));
+			xz.push_back(z(random));
+		}
+
+		// 23 points: five batches of four and a scalar tail of three.
+		const int count = (int)xz.size() / 2;
+		int failures = 0;
+
+		std::vector<float> heights(count), normals(3*count);
+		WaveKernels::SampleBilinear(h.data(), SampleRows, SampleCols, SampleX0, SampleZ0, SampleDx,
+			xz.data(), count, heights.data(), normals.data());
+
+		for(int k = 0; k < count; ++k)
+		{
+			float single, singleNormal[3];
+			WaveKernels::SampleBilinear(h.data(), SampleRows, SampleCols, SampleX0, SampleZ0, SampleDx,
+				&xz[2*k], 1, &single, singleNormal);
+
+			// The expected values at the point clamped onto the grid, in grid units.
+			double fc = std::fmin(std::fmax((xz[2*k] - SampleX0) / SampleDx, 0.0), SampleCols - 1.0);
+			double fr = std::fmin(std::fmax((SampleZ0 - xz[2*k + 1]) / SampleDx, 0.0), SampleRows - 1.0);
+			double expected = A*fc + B*fr + E*fc*fr;
+			double du = A + E*fr;
+			double dv = B + E*fc;
+			double len = std::sqrt(du*du + (double)SampleDx*SampleDx + dv*dv);
+			const double expectedNormal[3] = { -du / len, SampleDx / len, dv / len };
+
+			bool ok = heights[k] == single && std::fabs(heights[k] - expected) < 1.0e-5;
+			for(int a = 0; a < 3; ++a)
+				ok = ok && normals[3*k + a] == singleNormal[a] && std::fabs(normals[3*k + a] - expectedNormal[a]) < 1.0e-5;
+
+			if(!ok)
+			{
+				fprintf(stderr, "SampleBilinear: point %d (%g, %g): batch %g (%g %g %g), single %g (%g %g %g), expected %g (%g %g %g)\n",
+					k, xz[2*k], xz[2*k + 1], heights[k], normals[3*k], normals[3*k + 1], normals[3*k + 2],
+					single, singleNormal[0], singleNormal[1], singleNormal[2],
+					expected, expectedNormal[0], expectedNormal[1], expectedNormal[2]);
+				++failures;
+			}
+		}
+
+		printf("SampleBilinear: %d points checked\n", count);
+		return failures;
+	}
+}
+
+int main()
+{
+	const WaveKernels::Isa supported = WaveKernels::DetectIsa();
+
+	const struct
+	{
+		WaveKernels::Isa Isa;
+		WaveKernels::StencilRowFn Kernel;
+	} kernels[] =
+	{
+		{ WaveKernels::Isa::SSE2, WaveKernels::StencilRowSSE2 },
+		{ WaveKernels::Isa::AVX, WaveKernels::StencilRowAVX },
+	};
+
+	int failures = 0;
+	for(const auto& kernel : kernels)
+	{
+		if(kernel.Isa > supported)
+		{
+			printf("%s: not supported by this CPU, skipped\n", WaveKernels::IsaName(kernel.Isa));
+			continue;
+		}
+
+		int runs = 0;
+		for(int first = 1; first <= 8; ++first)
+		{
+			for(int count = 0; first + count <= Cols - 1; ++count)
+			{
+				std::vector<float> expected = Run(WaveKernels::StencilRowScalar, first, count);
+				std::vector<float> actual = Run(kernel.Kernel, first, count);
+				++runs;
+
+				if(memcmp(expected.data(), actual.data(), expected.size()*sizeof(float)) != 0)
+				{
+					fprintf(stderr, "%s: mismatch for cells [%d, %d) of each row\n",
+						WaveKernels::IsaName(kernel.Isa), first, first + count);
+					++failures;
+				}
+			}
+		}
+		printf("%s: %d row layouts match scalar\n", WaveKernels::IsaName(kernel.Isa), runs);
+	}
+
+	failures += CheckSampling();
+
+	if(failures != 0)
+	{
+		fprintf(stderr, "%d mismatches\n", failures);
+		return 1;
+	}
+	printf("all stencil kernels match scalar; sampling matches\n");
+	return 0;
+}
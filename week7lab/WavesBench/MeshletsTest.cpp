@@ -0,0 +1,191 @@
+//***************************************************************************************
+// MeshletsTest.cpp
+//
+// Headless check of Meshlets::Build and Meshlets::IsVisible on generated spheres,
+// cylinders and grids.  For every mesh it verifies that
+//   - no meshlet exceeds the vertex and triangle limits,
+//   - the meshlets are contiguous, cover the whole index buffer, and keep every
+//     triangle of the input,
+//   - each bounding sphere contains its meshlet's triangles, and the mesh's sphere
+//     contains every meshlet's,
+//   - a meshlet rejected by its normal cone has only back faces from that eye.
+// Prints each failure and returns nonzero if there was any.
+//***************************************************************************************
+
+#include "../Common/GeometryGenerator.h"
+#include "../Common/Meshlets.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	int gFailures = 0;
+
+	void Fail(const std::string& mesh, const char* what, size_t meshlet)
+	{
+		fprintf(stderr, "%s: meshlet %zu: %s\n", mesh.c_str(), meshlet, what);
+		++gFailures;
+	}
+
+	// Triangles as sorted index triples, so the same set compares equal in any order.
+	std::vector<std::array<std::uint32_t, 3>> TriangleSet(const GeometryGenerator::MeshData& mesh)
+	{
+		std::vector<std::array<std::uint32_t, 3>> triangles(mesh.IndexCount() / 3);
+		for(size_t t = 0; t < triangles.size(); ++t)
+		{
+			// Rotate the smallest index to the front; that keeps the winding.
+			std::array<std::uint32_t, 3> tri = { mesh.GetIndex(t*3), mesh.GetIndex(t*3 + 1), mesh.GetIndex(t*3 + 2) };
+			std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+			triangles[t] = tri;
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x*b.x + a.y*b.y + a.z*b.z;
+	}
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+	}
+
+	void Check(const std::string& name, GeometryGenerator::MeshData mesh)
+	{
+		const auto trianglesBefore = TriangleSet(mesh);
+		const std::vector<Meshlets::Meshlet> meshlets = Meshlets::Build(mesh);
+
+		if(TriangleSet(mesh) != trianglesBefore)
+			Fail(name, "triangles changed", 0);
+
+		// Scale for distance tolerances.
+		float extent = 0.0f;
+		for(const auto& v : mesh.Vertices)
+			extent = std::max(extent, std::sqrt(Dot(v.Position, v.Position)));
+		const float epsilon = 1e-5f*std::max(extent, 1.0f);
+
+		// Eyes scattered around the mesh, for the normal cone check.
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> coordinate(-3.0f*extent, 3.0f*extent);
+		std::vector<XMFLOAT3> eyes(64);
+		for(auto& eye : eyes)
+			eye = XMFLOAT3(coordinate(random), coordinate(random), coordinate(random));
+
+		Meshlets::CullParams params;
+		for(auto& plane : params.Planes)
+			plane = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+		params.CullBackfaces = true;
+
+		size_t rejected = 0;
+		size_t next = 0;
+		for(size_t m = 0; m < meshlets.size(); ++m)
+		{
+			const Meshlets::Meshlet& meshlet = meshlets[m];
+
+			if(meshlet.IndexStart != next || meshlet.IndexCount == 0 || meshlet.IndexCount % 3 != 0)
+				Fail(name, "not contiguous", m);
+			next = meshlet.IndexStart + meshlet.IndexCount;
+			if(next > mesh.IndexCount())
+			{
+				Fail(name, "runs past the index buffer", m);
+				break;
+			}
+
+			std::vector<std::uint32_t> vertices;
+			for(size_t i = meshlet.IndexStart; i < next; ++i)
+				vertices.push_back(mesh.GetIndex(i));
+			std::sort(vertices.begin(), vertices.end());
+			vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+
+			if(vertices.size() > Meshlets::MaxVertices || vertices.size() != meshlet.VertexCount)
+				Fail(name, "vertex count wrong or over the limit", m);
+			if(meshlet.IndexCount / 3 > Meshlets::MaxTriangles)
+				Fail(name, "over the triangle limit", m);
+
+			for(std::uint32_t v : vertices)
+			{
+				XMFLOAT3 d = Sub(mesh.Vertices[v].Position, meshlet.Center);
+				if(std::sqrt(Dot(d, d)) > meshlet.Radius + epsilon)
+				{
+					Fail(name, "vertex outside the bounding sphere", m);
+					break;
+				}
+			}
+
+			for(const XMFLOAT3& eye : eyes)
+			{
+				params.Eye = eye;
+				if(Meshlets::IsVisible(meshlet, params))
+					continue;
+
+				++rejected;
+				for(size_t i = meshlet.IndexStart; i < next; i += 3)
+				{
+					const XMFLOAT3& p0 = mesh.Vertices[mesh.GetIndex(i)].Position;
+					const XMFLOAT3& p1 = mesh.Vertices[mesh.GetIndex(i + 1)].Position;
+					const XMFLOAT3& p2 = mesh.Vertices[mesh.GetIndex(i + 2)].Position;
+
+					// Generated triangles wind so this normal points out of the front face.
+					XMFLOAT3 n = Cross(Sub(p1, p0), Sub(p2, p0));
+					if(Dot(n, Sub(eye, p0)) > epsilon*std::sqrt(Dot(n, n)))
+					{
+						Fail(name, "cone rejected a front face", m);
+						break;
+					}
+				}
+			}
+		}
+
+		if(next != mesh.IndexCount())
+			Fail(name, "meshlets do not cover the index buffer", meshlets.size());
+
+		XMFLOAT3 center;
+		float radius;
+		Meshlets::BoundingSphere(meshlets, center, radius);
+		for(size_t m = 0; m < meshlets.size(); ++m)
+		{
+			XMFLOAT3 d = Sub(meshlets[m].Center, center);
+			if(std::sqrt(Dot(d, d)) + meshlets[m].Radius > radius + epsilon)
+				Fail(name, "meshlet outside the mesh's bounding sphere", m);
+		}
+
+		printf("%-28s %6zu triangles %4zu meshlets %6zu cone rejections\n", name.c_str(),
+			mesh.IndexCount() / 3, meshlets.size(), rejected);
+	}
+}
+
+int main()
+{
+	GeometryGenerator geoGen;
+
+	Check("sphere 0.5 20x20", geoGen.CreateSphere(0.5f, 20, 20));
+	Check("sphere 2 64x48", geoGen.CreateSphere(2.0f, 64, 48));
+	Check("cylinder 1/1/3 8x8", geoGen.CreateCylinder(1.0f, 1.0f, 3.0f, 8, 8));
+	Check("cone 2/0/1 4x5", geoGen.CreateCylinder(2.0f, 0.0f, 1.0f, 4, 5));
+	Check("cylinder 1/0.5/4 40x20", geoGen.CreateCylinder(1.0f, 0.5f, 4.0f, 40, 20));
+	Check("grid 20x30 60x40", geoGen.CreateGrid(20.0f, 30.0f, 60, 40));
+	Check("grid 160x160 300x300", geoGen.CreateGrid(160.0f, 160.0f, 300, 300));
+
+	if(gFailures != 0)
+	{
+		fprintf(stderr, "%d failures\n", gFailures);
+		return 1;
+	}
+	printf("all meshlet checks passed\n");
+	return 0;
+}
@@ -0,0 +1,176 @@
+//***************************************************************************************
+// OceanTest.cpp
+//
+// Checks OceanFFT's radix-2 inverse transforms against a direct O(n^4) DFT of the
+// spectrum it reports.  On a 16 x 16 patch, at the start and at a later time, the
+// height, the choppy displacement and the normal of every vertex must match the
+// direct sums to within a small fraction of their largest magnitude.  The periodic
+// last row and column must repeat the first.  Sizes that are not a power of two must
+// be rejected.  Prints each failure and returns nonzero if there was any.
+//***************************************************************************************
+
+#include "OceanFFT.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const int N = 16;
+	const float PatchSize = 32.0f;
+	const float Choppiness = 0.8f;
+
+	// Relative to the largest value of each field; the FFT rounds in float.
+	const double Tolerance = 1.0e-4;
+
+	int gFailures = 0;
+
+	// Direct inverse DFT of each field at every sample, in double precision.
+	struct Reference
+	{
+		std::vector<double> Height, DisplaceX, DisplaceZ, SlopeX, SlopeZ;
+	};
+
+	Reference DirectDft(const OceanFFT& ocean)
+	{
+		typedef std::complex<double> Complex;
+		const double twoPi = 6.283185307179586;
+		const Complex i(0.0, 1.0);
+
+		Reference ref;
+		for(auto* field : { &ref.Height, &ref.DisplaceX, &ref.DisplaceZ, &ref.SlopeX, &ref.SlopeZ })
+			field->assign(N*N, 0.0);
+
+		for(int r = 0; r < N; ++r)
+		{
+			for(int c = 0; c < N; ++c)
+			{
+				Complex h(0.0), dx(0.0), dv(0.0), sx(0.0), sv(0.0);
+				for(int a = 0; a < N; ++a)
+				{
+					for(int b = 0; b < N; ++b)
+					{
+						XMFLOAT2 amp = ocean.Spectrum(a, b);
+						XMFLOAT2 kv = ocean.WaveVector(a, b);
+						double k = std::sqrt((double)kv.x*kv.x + (double)kv.y*kv.y);
+						double ux = k > 0.0 ? kv.x / k : 0.0;
+						double uv = k > 0.0 ? kv.y / k : 0.0;
+
+						Complex term = Complex(amp.x, amp.y)*std::exp(i*(twoPi*(a*r + b*c) / N));
+						h += term;
+						dx += -i*ux*term;
+						dv += -i*uv*term;
+						sx += i*(double)kv.x*term;
+						sv += i*(double)kv.y*term;
+					}
+				}
+
+				// v runs down the rows, which is world -z.
+				int s = r*N + c;
+				ref.Height[s] = h.real();
+				ref.DisplaceX[s] = Choppiness*dx.real();
+				ref.DisplaceZ[s] = -Choppiness*dv.real();
+				ref.SlopeX[s] = sx.real();
+				ref.SlopeZ[s] = -sv.real();
+			}
+		}
+		return ref;
+	}
+
+	double Largest(const std::vector<double>& v)
+	{
+		double m = 0.0;
+		for(double x : v)
+			m = std::max(m, std::fabs(x));
+		return m;
+	}
+
+	void Compare(const char* when, const char* what, double actual, double expected, double scale, int vertex)
+	{
+		if(std::fabs(actual - expected) > Tolerance*scale)
+		{
+			fprintf(stderr, "%s: vertex %d: %s is %g, direct DFT gives %g\n", when, vertex, what, actual, expected);
+			++gFailures;
+		}
+	}
+
+	void Check(const OceanFFT& ocean, const char* when)
+	{
+		const Reference ref = DirectDft(ocean);
+		const double heightScale = Largest(ref.Height);
+		const double displaceScale = std::max(Largest(ref.DisplaceX), Largest(ref.DisplaceZ));
+		const double dx = ocean.SpatialStep();
+		const double halfSize = 0.5*PatchSize;
+
+		if(heightScale == 0.0)
+		{
+			fprintf(stderr, "%s: the field is flat\n", when);
+			++gFailures;
+		}
+
+		for(int r = 0; r <= N; ++r)
+		{
+			for(int c = 0; c <= N; ++c)
+			{
+				int v = r*(N + 1) + c;
+				int s = (r % N)*N + (c % N);
+				XMFLOAT3 p = ocean.Position(v);
+				XMFLOAT3 n = ocean.Normal(v);
+
+				Compare(when, "height", p.y, ref.Height[s], heightScale, v);
+				Compare(when, "x displacement", p.x - (-halfSize + c*dx), ref.DisplaceX[s], displaceScale, v);
+				Compare(when, "z displacement", p.z - (halfSize - r*dx), ref.DisplaceZ[s], displaceScale, v);
+
+				// n = (-dh/dx, 1, -dh/dz), normalized.
+				double sx = ref.SlopeX[s];
+				double sz = ref.SlopeZ[s];
+				double len = std::sqrt(sx*sx + 1.0 + sz*sz);
+				Compare(when, "normal x", n.x, -sx / len, 1.0, v);
+				Compare(when, "normal y", n.y, 1.0 / len, 1.0, v);
+				Compare(when, "normal z", n.z, -sz / len, 1.0, v);
+			}
+		}
+	}
+}
+
+int main()
+{
+	OceanFFT ocean(N, PatchSize, 8.0f, XMFLOAT2(1.0f, 0.5f), 3.0e-6f, Choppiness, 3);
+	Check(ocean, "t = 0");
+
+	ocean.Update(1.7f);
+	Check(ocean, "t = 1.7");
+
+	for(int n : { 0, 1, 12, 24 })
+	{
+		bool rejected = false;
+		try
+		{
+			OceanFFT bad(n, PatchSize, 8.0f, XMFLOAT2(1.0f, 0.5f), 3.0e-6f, Choppiness);
+		}
+		catch(const std::invalid_argument&)
+		{
+			rejected = true;
+		}
+
+		if(!rejected)
+		{
+			fprintf(stderr, "size %d was accepted\n", n);
+			++gFailures;
+		}
+	}
+
+	if(gFailures != 0)
+	{
+		fprintf(stderr, "%d failures\n", gFailures);
+		return 1;
+	}
+	printf("OceanFFT matches a direct DFT; non-power-of-two sizes are rejected\n");
+	return 0;
+}
@@ -0,0 +1,102 @@
+//***************************************************************************************
+// SchedulerTest.cpp
+//
+// Headless check of TaskScheduler::ParallelFor.  Verifies that
+//   - every index of a loop runs exactly once, with and without nested loops,
+//   - an exception thrown by a chunk reaches the caller instead of ending the worker,
+//   - the pool keeps working after a loop has thrown.
+// Prints each failure and returns nonzero if there was any.
+//***************************************************************************************
+
+#include "../Common/TaskScheduler.h"
+
+#include <atomic>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int gFailures = 0;
+
+	void Check(bool ok, const char* what)
+	{
+		if(!ok)
+		{
+			fprintf(stderr, "%s\n", what);
+			++gFailures;
+		}
+	}
+
+	bool CoversOnce(TaskScheduler& scheduler, int count, bool nested)
+	{
+		std::vector<std::atomic<int>> hits(count);
+		for(auto& h : hits)
+			h.store(0);
+
+		scheduler.ParallelFor(0, count / 10, 1, [&](int i0, int i1)
+		{
+			for(int i = i0; i < i1; ++i)
+			{
+				auto body = [&](int j0, int j1)
+				{
+					for(int j = j0; j < j1; ++j)
+						hits[j].fetch_add(1);
+				};
+
+				if(nested)
+					scheduler.ParallelFor(10*i, 10*i + 10, 3, body);
+				else
+					body(10*i, 10*i + 10);
+			}
+		});
+
+		for(auto& h : hits)
+		{
+			if(h.load() != 1)
+				return false;
+		}
+		return true;
+	}
+}
+
+int main()
+{
+	TaskScheduler scheduler(3);
+
+	Check(CoversOnce(scheduler, 10000, false), "flat loop did not run every index once");
+	Check(CoversOnce(scheduler, 10000, true), "nested loop did not run every index once");
+
+	for(int round = 0; round < 20; ++round)
+	{
+		std::string caught;
+		try
+		{
+			scheduler.ParallelFor(0, 64, 1, [](int i0, int i1)
+			{
+				for(int i = i0; i < i1; ++i)
+				{
+					if(i == 37)
+						throw std::runtime_error("chunk 37");
+				}
+			});
+		}
+		catch(const std::runtime_error& e)
+		{
+			caught = e.what();
+		}
+		Check(caught == "chunk 37", "exception from a chunk did not reach the caller");
+	}
+
+	Check(CoversOnce(scheduler, 10000, true), "pool stopped working after a loop threw");
+
+	if(gFailures != 0)
+	{
+		fprintf(stderr, "%d failures\n", gFailures);
+		return 1;
+	}
+
+	printf("loops cover every index once; exceptions reach the caller\n");
+	return 0;
+}
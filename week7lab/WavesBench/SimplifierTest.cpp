@@ -0,0 +1,221 @@
+//***************************************************************************************
+// SimplifierTest.cpp
+//
+// Headless check of MeshSimplifier::BuildLodChain and MeshSimplifier::SelectLod on a
+// generated sphere and geosphere, and on a flat grid for its open border.  For every
+// mesh it verifies that
+//   - level 0 is the original index buffer and the triangle count drops at every
+//     further level,
+//   - no level has an index past the vertex buffer or a degenerate triangle,
+//   - every seam and border vertex of the original is still used by every level,
+//   - the reported error never decreases from one level to the next,
+//   - on the curved meshes, SelectLod keeps level 0 up close, picks the coarsest
+//     level far away, and in between picks the coarsest level whose error stays
+//     within the pixel budget.
+// Prints each failure and returns nonzero if there was any.
+//***************************************************************************************
+
+#include "../Common/GeometryGenerator.h"
+#include "../Common/MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	int gFailures = 0;
+
+	void Fail(const std::string& mesh, const char* what, size_t level)
+	{
+		fprintf(stderr, "%s: level %zu: %s\n", mesh.c_str(), level, what);
+		++gFailures;
+	}
+
+	bool SamePosition(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	// Vertices the simplifier must not move: those sharing their position with another
+	// vertex, and those on an edge without an opposite half-edge.
+	std::vector<bool> FixedVertices(const GeometryGenerator::MeshData& mesh)
+	{
+		const size_t vertexCount = mesh.Vertices.size();
+		std::vector<bool> fixed(vertexCount, false);
+
+		for(size_t a = 0; a < vertexCount; ++a)
+		{
+			for(size_t b = a + 1; b < vertexCount; ++b)
+			{
+				if(SamePosition(mesh.Vertices[a].Position, mesh.Vertices[b].Position))
+					fixed[a] = fixed[b] = true;
+			}
+		}
+
+		std::vector<std::pair<std::uint32_t, std::uint32_t>> edges;
+		for(size_t i = 0; i < mesh.IndexCount(); i += 3)
+		{
+			for(int k = 0; k < 3; ++k)
+				edges.emplace_back(mesh.GetIndex(i + k), mesh.GetIndex(i + (k + 1) % 3));
+		}
+		std::sort(edges.begin(), edges.end());
+
+		for(const auto& edge : edges)
+		{
+			if(!std::binary_search(edges.begin(), edges.end(), std::make_pair(edge.second, edge.first)))
+				fixed[edge.first] = fixed[edge.second] = true;
+		}
+		return fixed;
+	}
+
+	void CheckLevels(const std::string& name, const GeometryGenerator::MeshData& mesh,
+		const std::vector<std::uint32_t>& original, const std::vector<MeshSimplifier::Lod>& lods)
+	{
+		if(lods.size() < 2)
+		{
+			Fail(name, "chain has no simplified level", lods.size());
+			return;
+		}
+
+		const MeshSimplifier::Lod& base = lods[0];
+		bool baseSame = base.IndexStart == 0 && base.IndexCount == original.size() && base.Error == 0.0f;
+		for(size_t i = 0; i < original.size() && baseSame; ++i)
+			baseSame = mesh.GetIndex(i) == original[i];
+		if(!baseSame)
+			Fail(name, "is not the original index buffer", 0);
+
+		GeometryGenerator::MeshData originalMesh;
+		originalMesh.Vertices = mesh.Vertices;
+		originalMesh.AssignIndices(original.data(), original.size());
+		const std::vector<bool> fixed = FixedVertices(originalMesh);
+
+		const size_t vertexCount = mesh.Vertices.size();
+		for(size_t level = 0; level < lods.size(); ++level)
+		{
+			const MeshSimplifier::Lod& lod = lods[level];
+			if(lod.IndexCount == 0 || lod.IndexCount % 3 != 0 ||
+			   (size_t)lod.IndexStart + lod.IndexCount > mesh.IndexCount())
+			{
+				Fail(name, "index range is not whole triangles inside the buffer", level);
+				continue;
+			}
+
+			if(level > 0)
+			{
+				if(lod.IndexCount >= lods[level - 1].IndexCount)
+					Fail(name, "triangle count did not drop", level);
+				if(lod.Error < lods[level - 1].Error)
+					Fail(name, "error is smaller than the previous level's", level);
+			}
+
+			std::vector<bool> used(vertexCount, false);
+			bool inRange = true;
+			bool degenerate = false;
+			for(uint32_t i = lod.IndexStart; i < lod.IndexStart + lod.IndexCount; i += 3)
+			{
+				uint32_t tri[3] = { mesh.GetIndex(i), mesh.GetIndex(i + 1), mesh.GetIndex(i + 2) };
+				if(tri[0] >= vertexCount || tri[1] >= vertexCount || tri[2] >= vertexCount)
+				{
+					inRange = false;
+					continue;
+				}
+				for(uint32_t v : tri)
+					used[v] = true;
+
+				XMVECTOR p0 = XMLoadFloat3(&mesh.Vertices[tri[0]].Position);
+				XMVECTOR p1 = XMLoadFloat3(&mesh.Vertices[tri[1]].Position);
+				XMVECTOR p2 = XMLoadFloat3(&mesh.Vertices[tri[2]].Position);
+				float area = XMVectorGetX(XMVector3Length(XMVector3Cross(p1 - p0, p2 - p0)));
+				if(tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2] || !(area > 1.0e-12f))
+					degenerate = true;
+			}
+			if(!inRange)
+				Fail(name, "index past the end of the vertex buffer", level);
+			if(degenerate)
+				Fail(name, "degenerate triangle", level);
+
+			for(size_t v = 0; v < vertexCount; ++v)
+			{
+				if(fixed[v] && !used[v])
+				{
+					Fail(name, "a seam or border vertex was collapsed", level);
+					break;
+				}
+			}
+		}
+	}
+
+	void CheckSelection(const std::string& name, const std::vector<MeshSimplifier::Lod>& lods)
+	{
+		// With a scale of 1, one pixel per unit and a budget of one pixel, a level fits
+		// exactly when its error is at most the distance.
+		const float scale = 1.0f;
+		const float pixelsPerUnit = 1.0f;
+		const float maxPixels = 1.0f;
+
+		if(lods.size() < 2 || lods[1].Error <= 0.0f)
+		{
+			Fail(name, "first simplified level reports no error", 1);
+			return;
+		}
+
+		if(MeshSimplifier::SelectLod(lods, scale, 0.5f*lods[1].Error, pixelsPerUnit, maxPixels) != 0)
+			Fail(name, "SelectLod left level 0 while every level is too coarse", 0);
+
+		const size_t last = lods.size() - 1;
+		if(MeshSimplifier::SelectLod(lods, scale, 2.0f*lods[last].Error, pixelsPerUnit, maxPixels) != last)
+			Fail(name, "SelectLod did not pick the coarsest level far away", last);
+
+		for(size_t level = 1; level < lods.size(); ++level)
+		{
+			// Just past this level's error: it fits, and the next one does only if its
+			// error is no larger.
+			const float distance = lods[level].Error*1.001f;
+			size_t expected = level;
+			while(expected + 1 < lods.size() && lods[expected + 1].Error <= distance)
+				++expected;
+
+			if(MeshSimplifier::SelectLod(lods, scale, distance, pixelsPerUnit, maxPixels) != expected)
+				Fail(name, "SelectLod did not pick the coarsest level within the budget", level);
+
+			// The same distance with the mesh drawn twice as large halves the budget.
+			const float projected = MeshSimplifier::ProjectedError(lods[level], 2.0f, distance, pixelsPerUnit);
+			if(std::fabs(projected - 2.0f*lods[level].Error/distance) > 1.0e-5f)
+				Fail(name, "ProjectedError does not scale with the mesh", level);
+		}
+	}
+
+	// The grid is flat, so its levels cost no error and only their borders are checked.
+	void Check(const std::string& name, GeometryGenerator::MeshData mesh, bool curved)
+	{
+		std::vector<std::uint32_t> original(mesh.IndexCount());
+		for(size_t i = 0; i < original.size(); ++i)
+			original[i] = mesh.GetIndex(i);
+
+		const std::vector<MeshSimplifier::Lod> lods = MeshSimplifier::BuildLodChain(mesh);
+		CheckLevels(name, mesh, original, lods);
+		if(curved)
+			CheckSelection(name, lods);
+	}
+}
+
+int main()
+{
+	GeometryGenerator geoGen;
+	Check("sphere", geoGen.CreateSphere(1.0f, 40, 20), true);
+	Check("geosphere", geoGen.CreateGeosphere(1.0f, 4), true);
+	Check("grid", geoGen.CreateGrid(10.0f, 10.0f, 30, 30), false);
+
+	if(gFailures != 0)
+	{
+		fprintf(stderr, "%d failures\n", gFailures);
+		return 1;
+	}
+	printf("all LOD checks passed\n");
+	return 0;
+}
@@ -0,0 +1,429 @@
+//***************************************************************************************
+// WavesBench.cpp
+//
+// Headless benchmark for WaveSimulator::Update.  Sweeps grid sizes, thread counts, water
+// engines, and for the finite-difference engines stencil kernels and update modes, and
+// prints one JSON document with the results so runs can be compared over time.  Needs
+// no GPU and no window.
+//
+// Usage: WavesBench [--sizes 128,256,...] [--threads 1,2,...]
+//                   [--engines scalar,simd,tracked,spectral] [--kernels sse2,avx]
+//                   [--modes twopass,fused] [--catch-up steps] [--block-steps steps]
+//                   [--min-time seconds] [--out file]
+//
+// --kernels applies to the simd and tracked engines; the scalar engine always runs the
+// scalar kernel.  --catch-up makes every Update owe that many steps, as after a slow
+// frame, and --block-steps sets how many of them Waves advances per tile (1 turns
+// temporal blocking off).  --help prints the usage.
+//***************************************************************************************
+
+#include "Waves.h"
+#include "WaveSimulator.h"
+#include "../Common/TaskScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// Bytes one finite-difference step moves per cell: the stencil reads prev and curr
+	// and writes prev (neighbours come from cache), then the normal pass writes a normal
+	// and a tangent.  The spectral engine has no comparable model.
+	const double BytesPerCell = 3*sizeof(float) + 2*sizeof(DirectX::XMFLOAT3);
+
+	struct Options
+	{
+		std::vector<int> Sizes = { 128, 256, 512, 1024, 2048, 4096 };
+		std::vector<int> Threads;
+		std::vector<WaveEngine> Engines;
+		std::vector<WaveKernels::Isa> Kernels;
+		std::vector<Waves::UpdateMode> Modes = { Waves::UpdateMode::TwoPass, Waves::UpdateMode::Fused };
+		int CatchUp = 1;
+		int BlockSteps = 4;
+		double MinTime = 0.25;
+		const char* OutPath = nullptr;
+		bool Help = false;
+	};
+
+	const char* const Usage =
+		"Usage: WavesBench [--sizes 128,256,...] [--threads 1,2,...]\n"
+		"                  [--engines scalar,simd,tracked,spectral] [--kernels sse2,avx]\n"
+		"                  [--modes twopass,fused] [--catch-up steps] [--block-steps steps]\n"
+		"                  [--min-time seconds] [--out file]\n";
+
+	// Sizes below this leave no interior cell that Disturb accepts.
+	const int MinSize = 5;
+
+	struct Result
+	{
+		int Size;
+		int Vertices;
+		int Threads;
+		WaveEngine Engine;
+		WaveKernels::Isa Kernel;
+		Waves::UpdateMode Mode;
+		long long Steps;
+		double Seconds;
+	};
+
+	std::vector<std::string> SplitList(const char* list)
+	{
+		std::vector<std::string> items;
+		std::string item;
+		for(const char* c = list; ; ++c)
+		{
+			if(*c == ',' || *c == '\0')
+			{
+				if(!item.empty())
+					items.push_back(item);
+				item.clear();
+				if(*c == '\0')
+					break;
+			}
+			else
+			{
+				item += *c;
+			}
+		}
+		return items;
+	}
+
+	bool ParseKernel(const std::string& name, WaveKernels::Isa& isa)
+	{
+		for(int k = 0; k < (int)WaveKernels::Isa::Count; ++k)
+		{
+			if(name == WaveKernels::IsaName((WaveKernels::Isa)k))
+			{
+				isa = (WaveKernels::Isa)k;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Parses a whole decimal integer of at least minimum.  Prints what was wrong otherwise.
+	bool ParseCount(const std::string& text, int minimum, const char* what, int& count)
+	{
+		char* end = nullptr;
+		long value = strtol(text.c_str(), &end, 10);
+		if(text.empty() || *end != '\0' || value < minimum || value > INT_MAX)
+		{
+			fprintf(stderr, "invalid %s '%s' (must be an integer of at least %d)\n", what, text.c_str(), minimum);
+			return false;
+		}
+		count = (int)value;
+		return true;
+	}
+
+	const char* ModeName(Waves::UpdateMode mode)
+	{
+		return mode == Waves::UpdateMode::Fused ? "fused" : "twopass";
+	}
+
+	bool ParseOptions(int argc, char** argv, Options& opt)
+	{
+		for(int a = 1; a < argc; ++a)
+		{
+			const char* arg = argv[a];
+			if(strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
+			{
+				fputs(Usage, stdout);
+				opt.Help = true;
+				return true;
+			}
+
+			const char* value = (a + 1 < argc) ? argv[a + 1] : nullptr;
+
+			if(value == nullptr)
+			{
+				fprintf(stderr, "missing value for %s\n%s", arg, Usage);
+				return false;
+			}
+			++a;
+
+			if(strcmp(arg, "--sizes") == 0)
+			{
+				opt.Sizes.clear();
+				for(const auto& s : SplitList(value))
+				{
+					int size;
+					if(!ParseCount(s, MinSize, "size", size))
+						return false;
+					opt.Sizes.push_back(size);
+				}
+			}
+			else if(strcmp(arg, "--threads") == 0)
+			{
+				opt.Threads.clear();
+				for(const auto& s : SplitList(value))
+				{
+					int threads;
+					if(!ParseCount(s, 1, "thread count", threads))
+						return false;
+					opt.Threads.push_back(threads);
+				}
+			}
+			else if(strcmp(arg, "--engines") == 0)
+			{
+				opt.Engines.clear();
+				for(const auto& s : SplitList(value))
+				{
+					WaveEngine engine;
+					if(!ParseWaveEngine(s.c_str(), engine))
+					{
+						fprintf(stderr, "unknown engine '%s'\n", s.c_str());
+						return false;
+					}
+					opt.Engines.push_back(engine);
+				}
+			}
+			else if(strcmp(arg, "--kernels") == 0)
+			{
+				opt.Kernels.clear();
+				for(const auto& s : SplitList(value))
+				{
+					WaveKernels::Isa isa;
+					if(!ParseKernel(s, isa))
+					{
+						fprintf(stderr, "unknown kernel '%s'\n", s.c_str());
+						return false;
+					}
+					opt.Kernels.push_back(isa);
+				}
+			}
+			else if(strcmp(arg, "--modes") == 0)
+			{
+				opt.Modes.clear();
+				for(const auto& s : SplitList(value))
+				{
+					if(s == "twopass")
+						opt.Modes.push_back(Waves::UpdateMode::TwoPass);
+					else if(s == "fused")
+						opt.Modes.push_back(Waves::UpdateMode::Fused);
+					else
+					{
+						fprintf(stderr, "unknown mode '%s'\n", s.c_str());
+						return false;
+					}
+				}
+			}
+			else if(strcmp(arg, "--catch-up") == 0)
+			{
+				if(!ParseCount(value, 1, "catch-up step count", opt.CatchUp))
+					return false;
+			}
+			else if(strcmp(arg, "--block-steps") == 0)
+			{
+				if(!ParseCount(value, 1, "block step count", opt.BlockSteps))
+					return false;
+			}
+			else if(strcmp(arg, "--min-time") == 0)
+			{
+				opt.MinTime = atof(value);
+			}
+			else if(strcmp(arg, "--out") == 0)
+			{
+				opt.OutPath = value;
+			}
+			else
+			{
+				fprintf(stderr, "unknown option %s\n%s", arg, Usage);
+				return false;
+			}
+		}
+
+		// Default to powers of two up to the hardware thread count, plus the count itself.
+		if(opt.Threads.empty())
+		{
+			int hw = (int)std::thread::hardware_concurrency();
+			if(hw < 1)
+				hw = 1;
+			for(int t = 1; t < hw; t *= 2)
+				opt.Threads.push_back(t);
+			opt.Threads.push_back(hw);
+		}
+
+		if(opt.Engines.empty())
+		{
+			for(int e = 0; e < (int)WaveEngine::Count; ++e)
+				opt.Engines.push_back((WaveEngine)e);
+		}
+
+		// Default to every vector kernel this CPU can run, or the scalar one if it has none.
+		if(opt.Kernels.empty())
+		{
+			for(int k = 1; k <= (int)WaveKernels::DetectIsa(); ++k)
+				opt.Kernels.push_back((WaveKernels::Isa)k);
+			if(opt.Kernels.empty())
+				opt.Kernels.push_back(WaveKernels::Isa::Scalar);
+		}
+
+		return true;
+	}
+
+	bool IsSpectral(WaveEngine engine)
+	{
+		return engine == WaveEngine::Spectral;
+	}
+
+	Result Run(const Options& opt, WaveEngine engine, int size, TaskScheduler& scheduler,
+		WaveKernels::Isa kernel, Waves::UpdateMode mode)
+	{
+		WaveSimulatorDesc desc;
+		desc.Rows = size;
+		desc.Columns = size;
+		// Half a step extra keeps float round-off from leaving the last owed step for
+		// the next call; the surplus is dropped once the substep limit is hit.
+		const float dt = desc.TimeStep*(opt.CatchUp + 0.5f);
+
+		auto sim = CreateWaveSimulator(engine, desc);
+		sim->SetScheduler(&scheduler);
+
+		Result r;
+		r.Size = size;
+		r.Vertices = sim->VertexCount();
+		r.Threads = (int)scheduler.ThreadCount();
+		r.Engine = engine;
+		r.Kernel = kernel;
+		r.Mode = mode;
+		r.Steps = 0;
+
+		// The engine fixes whether tiles are tracked; kernel and mode are ours to sweep.
+		if(Waves* waves = dynamic_cast<Waves*>(sim.get()))
+		{
+			if(engine != WaveEngine::Scalar)
+				waves->SetKernel(kernel);
+			waves->SetUpdateMode(mode);
+			waves->SetMaxSubsteps(opt.CatchUp);
+			waves->SetTemporalBlockSteps(opt.BlockSteps);
+			r.Kernel = waves->Kernel();
+		}
+
+		// Scatter a few disturbances so the grid is not all zeros.
+		for(int d = 0; d < 16; ++d)
+		{
+			int i = 2 + (d*7919) % (size - 4);
+			int j = 2 + (d*104729) % (size - 4);
+			sim->Disturb(i, j, 0.5f);
+		}
+
+		// Warm up caches, page in the arrays and spin up the workers.
+		for(int s = 0; s < 4; ++s)
+			sim->Update(dt);
+
+		// Run batches of steps until at least MinTime has elapsed.
+		typedef std::chrono::steady_clock Clock;
+		auto start = Clock::now();
+		double elapsed = 0.0;
+		long long batch = 1;
+		do
+		{
+			for(long long s = 0; s < batch; ++s)
+				r.Steps += sim->Update(dt);
+
+			elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+			batch *= 2;
+		} while(elapsed < opt.MinTime);
+
+		r.Seconds = elapsed;
+		return r;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options opt;
+	if(!ParseOptions(argc, argv, opt))
+		return 1;
+	if(opt.Help)
+		return 0;
+
+	std::vector<Result> results;
+	for(int threads : opt.Threads)
+	{
+		// The calling thread works too, so the pool gets one worker fewer.
+		TaskScheduler scheduler(threads > 1 ? (unsigned)(threads - 1) : 0);
+
+		for(int size : opt.Sizes)
+		{
+			for(WaveEngine engine : opt.Engines)
+			{
+				// The spectral engine has neither kernels nor update modes: one run.
+				std::vector<WaveKernels::Isa> kernels = opt.Kernels;
+				std::vector<Waves::UpdateMode> modes = opt.Modes;
+				if(engine != WaveEngine::Simd && engine != WaveEngine::Tracked)
+					kernels.assign(1, WaveKernels::Isa::Scalar);
+				if(IsSpectral(engine))
+					modes.assign(1, Waves::UpdateMode::TwoPass);
+
+				for(WaveKernels::Isa kernel : kernels)
+				{
+					for(Waves::UpdateMode mode : modes)
+					{
+						Result r = Run(opt, engine, size, scheduler, kernel, mode);
+						results.push_back(r);
+						fprintf(stderr, "%5d^2  threads %2d  %-8s  %-6s  %-7s  %8.3f ns/cell\n", r.Size, threads,
+							WaveEngineName(r.Engine), IsSpectral(r.Engine) ? "-" : WaveKernels::IsaName(r.Kernel),
+							IsSpectral(r.Engine) ? "-" : ModeName(r.Mode),
+							r.Seconds*1.0e9 / ((double)r.Steps*r.Vertices));
+					}
+				}
+			}
+		}
+	}
+
+	FILE* out = stdout;
+	if(opt.OutPath != nullptr)
+	{
+		out = fopen(opt.OutPath, "w");
+		if(out == nullptr)
+		{
+			fprintf(stderr, "cannot open %s\n", opt.OutPath);
+			return 1;
+		}
+	}
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"benchmark\": \"WaveSimulator::Update\",\n");
+	fprintf(out, "  \"detected_isa\": \"%s\",\n", WaveKernels::IsaName(WaveKernels::DetectIsa()));
+	fprintf(out, "  \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+	fprintf(out, "  \"bytes_per_cell\": %.0f,\n", BytesPerCell);
+	fprintf(out, "  \"catch_up\": %d,\n", opt.CatchUp);
+	fprintf(out, "  \"block_steps\": %d,\n", opt.BlockSteps);
+	fprintf(out, "  \"results\": [\n");
+	for(size_t k = 0; k < results.size(); ++k)
+	{
+		const Result& r = results[k];
+		double cells = (double)r.Steps*r.Vertices;
+		bool spectral = IsSpectral(r.Engine);
+
+		// The bytes model only describes the finite-difference engines.
+		char gbPerS[32];
+		if(spectral)
+			snprintf(gbPerS, sizeof(gbPerS), "null");
+		else
+			snprintf(gbPerS, sizeof(gbPerS), "%.3f", cells*BytesPerCell / r.Seconds*1.0e-9);
+
+		fprintf(out, "    { \"engine\": \"%s\", \"size\": %d, \"vertices\": %d, \"threads\": %d, "
+			"\"kernel\": \"%s\", \"mode\": \"%s\", \"steps\": %lld, \"seconds\": %.6f, "
+			"\"ns_per_cell\": %.4f, \"gb_per_s\": %s, \"steps_per_s\": %.2f }%s\n",
+			WaveEngineName(r.Engine), r.Size, r.Vertices, r.Threads,
+			spectral ? "none" : WaveKernels::IsaName(r.Kernel), spectral ? "none" : ModeName(r.Mode),
+			r.Steps, r.Seconds, r.Seconds*1.0e9 / cells, gbPerS,
+			r.Steps / r.Seconds, (k + 1 < results.size()) ? "," : "");
+	}
+	fprintf(out, "  ]\n");
+	fprintf(out, "}\n");
+
+	if(out != stdout)
+		fclose(out);
+
+	return 0;
+}
@@ -0,0 +1,258 @@
+//***************************************************************************************
+// WavesTest.cpp
+//
+// Checks that Waves gives the same heights however its steps are scheduled.  Three
+// engines with active tile tracking off advance the same grid while impulses are
+// dropped on it:
+//   - one steps a single step at a time,
+//   - one advances several steps at once with temporal blocking,
+//   - one calls Disturb right after the first step instead of queueing DisturbBatch.
+// Both height buffers are compared with memcmp after every round.  A snapshot of the
+// result must then load back unchanged, and one whose height offset would wrap past
+// the end of the file must be rejected.
+//
+// Blocking is also checked on its own: for several block sizes and step counts,
+// Simulate(n) with temporal blocking must give the same heights and normals, bit for
+// bit, as n single steps from the same disturbed grid.
+//
+// Active tile tracking is checked separately: after one disturbance in a corner, a
+// tracked grid must stay within a small tolerance of an untracked one at every step,
+// a far tile must fall asleep after the first step, and it must wake once the wave
+// reaches it.  Prints each failure and returns nonzero if there was any.
+//***************************************************************************************
+
+#include "Waves.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+	const int Rows = 100;
+	const int Cols = 100;
+	const int Rounds = 6;
+
+	std::unique_ptr<Waves> MakeWaves(int blockSteps)
+	{
+		std::unique_ptr<Waves> waves(new Waves(Rows, Cols, 1.0f, 0.03f, 4.0f, 0.2f));
+		waves->SetActiveTileTracking(false);
+		waves->SetTemporalBlockSteps(blockSteps);
+		return waves;
+	}
+
+	std::vector<float> Heights(const Waves& waves)
+	{
+		std::vector<float> heights(2*waves.VertexCount());
+		for(int i = 0; i < waves.VertexCount(); ++i)
+		{
+			heights[2*i] = waves.PreviousHeight(i);
+			heights[2*i + 1] = waves.Height(i);
+		}
+		return heights;
+	}
+
+	int CheckBlocking()
+	{
+		int failures = 0;
+		for(int blockSteps : { 2, 3, 4, 7 })
+		{
+			for(int steps : { 1, 5, 13, 40 })
+			{
+				std::unique_ptr<Waves> single = MakeWaves(1);
+				std::unique_ptr<Waves> blocked = MakeWaves(blockSteps);
+				for(Waves* waves : { single.get(), blocked.get() })
+				{
+					waves->Disturb(30, 40, 2.0f);
+					waves->Disturb(Rows - 4, Cols - 4, -1.5f);
+					waves->Simulate(3);
+				}
+
+				for(int s = 0; s < steps; ++s)
+					single->Simulate(1);
+				blocked->Simulate(steps);
+
+				bool same = Heights(*single) == Heights(*blocked);
+				for(int k = 0; k < single->VertexCount() && same; ++k)
+					same = memcmp(&single->Normal(k), &blocked->Normal(k), sizeof(DirectX::XMFLOAT3)) == 0;
+
+				if(!same)
+				{
+					fprintf(stderr, "blocking: %d steps in blocks of %d differ from single steps\n", steps, blockSteps);
+					++failures;
+				}
+			}
+		}
+		return failures;
+	}
+
+	// Flattening tiles whose heights fall below the sleep threshold only drops ripples
+	// a few orders of magnitude below it.
+	const float TrackingTolerance = 1.0e-5f;
+
+	int CheckTracking()
+	{
+		const int size = 160;
+		const int farTile = size / 32 - 1;
+		const int maxSteps = 1500;
+
+		Waves tracked(size, size, 1.0f, 0.03f, 4.0f, 0.2f);
+		Waves untracked(size, size, 1.0f, 0.03f, 4.0f, 0.2f);
+		tracked.SetActiveTileTracking(true);
+		untracked.SetActiveTileTracking(false);
+
+		int failures = 0;
+		if(!tracked.IsTileActive(farTile, farTile))
+		{
+			fprintf(stderr, "tracking: enabling it did not wake every tile\n");
+			++failures;
+		}
+
+		tracked.Disturb(20, 20, 2.0f);
+		untracked.Disturb(20, 20, 2.0f);
+
+		int wokeAt = -1;
+		float worst = 0.0f;
+		for(int step = 1; step <= maxSteps && wokeAt < 0; ++step)
+		{
+			tracked.Simulate(1);
+			untracked.Simulate(1);
+
+			for(int k = 0; k < tracked.VertexCount(); ++k)
+				worst = std::max(worst, std::fabs(tracked.Height(k) - untracked.Height(k)));
+
+			bool farActive = tracked.IsTileActive(farTile, farTile);
+			if(step == 1 && farActive)
+			{
+				fprintf(stderr, "tracking: far tile still active after the first step\n");
+				++failures;
+			}
+			if(step > 1 && farActive)
+				wokeAt = step;
+		}
+
+		if(worst > TrackingTolerance)
+		{
+			fprintf(stderr, "tracking: heights differ from untracked by %g\n", worst);
+			++failures;
+		}
+		if(wokeAt < 0)
+		{
+			fprintf(stderr, "tracking: far tile never woke within %d steps\n", maxSteps);
+			++failures;
+		}
+
+		return failures;
+	}
+}
+
+int main()
+{
+	std::unique_ptr<Waves> single = MakeWaves(1);
+	std::unique_ptr<Waves> blocked = MakeWaves(4);
+	std::unique_ptr<Waves> immediate = MakeWaves(1);
+
+	std::mt19937 random(7);
+	std::uniform_int_distribution<int> row(5, Rows - 6);
+	std::uniform_int_distribution<int> col(5, Cols - 6);
+	std::uniform_real_distribution<float> magnitude(0.5f, 3.0f);
+	std::uniform_int_distribution<int> stepCount(1, 9);
+
+	int failures = 0;
+	for(int round = 0; round < Rounds; ++round)
+	{
+		// Rounds alternate between quiet stretches and stretches that start with a
+		// handful of impulses, including two on the same cell.
+		std::vector<Waves::Impulse> impulses;
+		if(round % 2 == 0)
+		{
+			for(int k = 0; k < 4; ++k)
+			{
+				Waves::Impulse p;
+				p.Row = row(random);
+				p.Column = col(random);
+				p.Magnitude = magnitude(random);
+				impulses.push_back(p);
+			}
+			impulses.push_back(impulses.front());
+		}
+
+		const int steps = stepCount(random) + 1;
+
+		for(Waves* waves : { single.get(), blocked.get() })
+		{
+			waves->DisturbBatch(impulses.data(), impulses.size());
+			waves->Simulate(steps);
+		}
+
+		immediate->Simulate(1);
+		for(const Waves::Impulse& p : impulses)
+			immediate->Disturb(p.Row, p.Column, p.Magnitude);
+		immediate->Simulate(steps - 1);
+
+		const std::vector<float> expected = Heights(*single);
+		const struct
+		{
+			const char* Name;
+			const Waves* Engine;
+		} engines[] =
+		{
+			{ "blocked", blocked.get() },
+			{ "Disturb after the step", immediate.get() },
+		};
+
+		for(const auto& engine : engines)
+		{
+			std::vector<float> actual = Heights(*engine.Engine);
+			if(memcmp(expected.data(), actual.data(), expected.size()*sizeof(float)) != 0)
+			{
+				fprintf(stderr, "round %d (%d steps, %zu impulses): %s differs from single steps\n",
+					round, steps, impulses.size(), engine.Name);
+				++failures;
+			}
+		}
+	}
+
+	const char* path = "WavesTestSnapshot.bin";
+	const std::vector<float> saved = Heights(*single);
+	std::unique_ptr<Waves> loaded = MakeWaves(1);
+	if(!single->SaveSnapshot(path) || !loaded->LoadSnapshot(path) || Heights(*loaded) != saved)
+	{
+		fprintf(stderr, "snapshot did not load back unchanged\n");
+		++failures;
+	}
+
+	// CurrOffset sits at byte 56, after 48 bytes of identification and constants and
+	// the 8-byte PrevOffset.
+	// A page-aligned offset one page short of 2^64 wraps when the heights are added.
+	{
+		std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+		const std::uint64_t wild = 0 - (std::uint64_t)4096;
+		file.seekp(56);
+		file.write(reinterpret_cast<const char*>(&wild), sizeof(wild));
+	}
+	std::unique_ptr<Waves> damaged = MakeWaves(1);
+	if(damaged->LoadSnapshot(path))
+	{
+		fprintf(stderr, "snapshot with a wrapping offset was accepted\n");
+		++failures;
+	}
+	std::remove(path);
+
+	failures += CheckBlocking();
+	failures += CheckTracking();
+
+	if(failures != 0)
+	{
+		fprintf(stderr, "%d failures\n", failures);
+		return 1;
+	}
+	printf("blocked and queued steps match single steps over %d rounds; snapshots, blocking and tracking checked\n", Rounds);
+	return 0;
+}
@@ -54,7 +54,7 @@ struct FrameResource
 {
 public:
     
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount);
+    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount, bool wavesHeightOnly);
 	FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
@@ -72,9 +72,18 @@ public:
     std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
 
     // We cannot update a dynamic vertex buffer until the GPU is done processing
-    // the commands that reference it.  So each frame needs their own.
+    // the commands that reference it.  So each frame needs their own.  Only the
+    // stream of the water path in use is created; the other stays null.
     std::unique_ptr<UploadBuffer<Vertex>> WavesVB = nullptr;
 
+    // Height-only copy of the waves, one float per vertex, read by the water vertex
+    // shader through a root SRV when the app renders the height-only water path.
+    std::unique_ptr<UploadBuffer<float>> WavesHeightVB = nullptr;
+
+    // Wave tiles that changed since this frame's water stream, WavesHeightVB or
+    // WavesVB, was last written.
+    std::vector<unsigned char> WavesPendingTiles;
+
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
     UINT64 Fence = 0;
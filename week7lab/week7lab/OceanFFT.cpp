@@ -0,0 +1,436 @@
+//***************************************************************************************
+// OceanFFT.cpp
+//***************************************************************************************
+
+#include "OceanFFT.h"
+#include "../Common/TaskScheduler.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define OCEAN_SSE 1
+	#include <emmintrin.h>
+#else
+	#define OCEAN_SSE 0
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	const float Gravity = 9.81f;
+	const float Pi = 3.14159265358979f;
+
+	// Radix-2 butterflies on split real/imaginary arrays:
+	//   t = w*b;  b = a - t;  a = a + t
+	// ButterflyVarying takes one twiddle per element (the stages of a row transform);
+	// ButterflyUniform applies one twiddle to a whole span (a column transform run over
+	// many columns at once, so the span is contiguous).
+	void ButterflyVarying(float* ar, float* ai, float* br, float* bi,
+		const float* wr, const float* wi, int count)
+	{
+		int k = 0;
+#if OCEAN_SSE
+		for(; k + 4 <= count; k += 4)
+		{
+			__m128 xr = _mm_loadu_ps(br + k);
+			__m128 xi = _mm_loadu_ps(bi + k);
+			__m128 cr = _mm_loadu_ps(wr + k);
+			__m128 ci = _mm_loadu_ps(wi + k);
+			__m128 tr = _mm_sub_ps(_mm_mul_ps(cr, xr), _mm_mul_ps(ci, xi));
+			__m128 ti = _mm_add_ps(_mm_mul_ps(cr, xi), _mm_mul_ps(ci, xr));
+			__m128 yr = _mm_loadu_ps(ar + k);
+			__m128 yi = _mm_loadu_ps(ai + k);
+			_mm_storeu_ps(br + k, _mm_sub_ps(yr, tr));
+			_mm_storeu_ps(bi + k, _mm_sub_ps(yi, ti));
+			_mm_storeu_ps(ar + k, _mm_add_ps(yr, tr));
+			_mm_storeu_ps(ai + k, _mm_add_ps(yi, ti));
+		}
+#endif
+		for(; k < count; ++k)
+		{
+			float tr = wr[k]*br[k] - wi[k]*bi[k];
+			float ti = wr[k]*bi[k] + wi[k]*br[k];
+			br[k] = ar[k] - tr;
+			bi[k] = ai[k] - ti;
+			ar[k] += tr;
+			ai[k] += ti;
+		}
+	}
+
+	void ButterflyUniform(float* ar, float* ai, float* br, float* bi, float wr, float wi, int count)
+	{
+		int k = 0;
+#if OCEAN_SSE
+		const __m128 cr = _mm_set1_ps(wr);
+		const __m128 ci = _mm_set1_ps(wi);
+		for(; k + 4 <= count; k += 4)
+		{
+			__m128 xr = _mm_loadu_ps(br + k);
+			__m128 xi = _mm_loadu_ps(bi + k);
+			__m128 tr = _mm_sub_ps(_mm_mul_ps(cr, xr), _mm_mul_ps(ci, xi));
+			__m128 ti = _mm_add_ps(_mm_mul_ps(cr, xi), _mm_mul_ps(ci, xr));
+			__m128 yr = _mm_loadu_ps(ar + k);
+			__m128 yi = _mm_loadu_ps(ai + k);
+			_mm_storeu_ps(br + k, _mm_sub_ps(yr, tr));
+			_mm_storeu_ps(bi + k, _mm_sub_ps(yi, ti));
+			_mm_storeu_ps(ar + k, _mm_add_ps(yr, tr));
+			_mm_storeu_ps(ai + k, _mm_add_ps(yi, ti));
+		}
+#endif
+		for(; k < count; ++k)
+		{
+			float tr = wr*br[k] - wi*bi[k];
+			float ti = wr*bi[k] + wi*br[k];
+			br[k] = ar[k] - tr;
+			bi[k] = ai[k] - ti;
+			ar[k] += tr;
+			ai[k] += ti;
+		}
+	}
+}
+
+OceanFFT::OceanFFT(int n, float patchSize, float windSpeed, const XMFLOAT2& windDir,
+	float amplitude, float choppiness, unsigned seed)
+{
+	if(n < 2 || (n & (n - 1)) != 0)
+		throw std::invalid_argument("OceanFFT size must be a power of two");
+
+	mN = n;
+	mPatchSize = patchSize;
+	mChoppiness = choppiness;
+	while((1 << mLogN) < n)
+		++mLogN;
+
+	int count = n*n;
+
+	// Bit reversal and per-stage twiddles e^(+i*pi*k/h) for the inverse transform.
+	mBitReverse.resize(n);
+	for(int i = 0; i < n; ++i)
+	{
+		int r = 0;
+		for(int b = 0; b < mLogN; ++b)
+			r |= ((i >> b) & 1) << (mLogN - 1 - b);
+		mBitReverse[i] = r;
+	}
+
+	for(int h = 1; h < n; h *= 2)
+	{
+		for(int k = 0; k < h; ++k)
+		{
+			mTwiddleRe.push_back(cosf(Pi*k / h));
+			mTwiddleIm.push_back(sinf(Pi*k / h));
+		}
+	}
+
+	// Wind direction in (u, v) patch coordinates; v points down the rows, i.e. -z.
+	float windLen = sqrtf(windDir.x*windDir.x + windDir.y*windDir.y);
+	float wu = windLen > 0.0f ? windDir.x / windLen : 1.0f;
+	float wv = windLen > 0.0f ? -windDir.y / windLen : 0.0f;
+
+	// Largest wave the wind can raise, and a cutoff for waves much smaller than it.
+	float L = windSpeed*windSpeed / Gravity;
+	float l = 0.001f*L;
+
+	mKx.resize(count);
+	mKv.resize(count);
+	mOmega.resize(count);
+	mH0Re.resize(count);
+	mH0Im.resize(count);
+	mH0ConjRe.resize(count);
+	mH0ConjIm.resize(count);
+
+	std::mt19937 rng(seed);
+	std::normal_distribution<float> gauss(0.0f, 1.0f);
+
+	std::vector<float> h0Re(count), h0Im(count);
+	for(int i = 0; i < n; ++i)
+	{
+		for(int j = 0; j < n; ++j)
+		{
+			// FFT order: indices past n/2 are the negative frequencies.
+			float kx = 2.0f*Pi*(j < n/2 ? j : j - n) / patchSize;
+			float kv = 2.0f*Pi*(i < n/2 ? i : i - n) / patchSize;
+			float k2 = kx*kx + kv*kv;
+			float k = sqrtf(k2);
+
+			int s = i*n + j;
+			mKx[s] = kx;
+			mKv[s] = kv;
+			mOmega[s] = sqrtf(Gravity*k);
+
+			// Phillips spectrum; waves travelling against the wind are damped.  The
+			// Nyquist row and column are left empty: i*k*h is not Hermitian there, so
+			// the slopes and displacement would not transform to real fields and the
+			// packing in EvaluateSpectrum would mix them into their partners.
+			float phillips = 0.0f;
+			if(k2 > 0.0f && i != n/2 && j != n/2)
+			{
+				float kw = (kx*wu + kv*wv) / k;
+				phillips = amplitude*expf(-1.0f / (k2*L*L)) / (k2*k2) * kw*kw * expf(-k2*l*l);
+				if(kw < 0.0f)
+					phillips *= 0.07f;
+			}
+
+			float scale = sqrtf(0.5f*phillips);
+			h0Re[s] = gauss(rng)*scale;
+			h0Im[s] = gauss(rng)*scale;
+		}
+	}
+
+	// Every sample contributes at most |h0(k)| + |h0(-k)| to the height, and at most
+	// choppiness times that to each displacement, whatever the phases.
+	float amplitudeSum = 0.0f;
+	for(int i = 0; i < n; ++i)
+	{
+		for(int j = 0; j < n; ++j)
+		{
+			int s = i*n + j;
+			int m = ((n - i) & (n - 1))*n + ((n - j) & (n - 1));
+			mH0Re[s] = h0Re[s];
+			mH0Im[s] = h0Im[s];
+			mH0ConjRe[s] = h0Re[m];
+			mH0ConjIm[s] = -h0Im[m];
+
+			amplitudeSum += sqrtf(h0Re[s]*h0Re[s] + h0Im[s]*h0Im[s]) + sqrtf(h0Re[m]*h0Re[m] + h0Im[m]*h0Im[m]);
+		}
+	}
+	mMaxAmplitude = amplitudeSum*std::max(1.0f, choppiness);
+
+	for(int f = 0; f < 3; ++f)
+	{
+		mFieldRe[f].resize(count);
+		mFieldIm[f].resize(count);
+	}
+
+	mHeight.assign(count, 0.0f);
+	mDisplaceX.assign(count, 0.0f);
+	mDisplaceZ.assign(count, 0.0f);
+	mNormals.assign(count, XMFLOAT3(0.0f, 1.0f, 0.0f));
+	mTangentX.assign(count, XMFLOAT3(1.0f, 0.0f, 0.0f));
+
+	mScheduler = &TaskScheduler::Default();
+
+	Update(0.0f);
+}
+
+OceanFFT::~OceanFFT()
+{
+}
+
+XMFLOAT3 OceanFFT::Position(int i)const
+{
+	int row = i / (mN + 1);
+	int col = i - row*(mN + 1);
+	int s = Sample(i);
+
+	float dx = SpatialStep();
+	float halfSize = 0.5f*mPatchSize;
+	return XMFLOAT3(-halfSize + col*dx + mDisplaceX[s], mHeight[s], halfSize - row*dx + mDisplaceZ[s]);
+}
+
+void OceanFFT::WriteVertices(void* dst, size_t byteSize, float alpha, const unsigned char* tileMask)const
+{
+	assert(byteSize >= (size_t)VertexCount()*sizeof(VertexRecord));
+	(void)byteSize;
+	(void)alpha;
+	(void)tileMask;
+
+	VertexRecord* out = static_cast<VertexRecord*>(dst);
+	const int cols = mN + 1;
+	const float dx = SpatialStep();
+	const float halfSize = 0.5f*mPatchSize;
+	const float invN = 1.0f / mN;
+
+	mScheduler->ParallelFor(0, mN + 1, 0, [this, out, cols, dx, halfSize, invN](int r0, int r1)
+	{
+		for(int r = r0; r < r1; ++r)
+		{
+			const int rowBase = (r & (mN - 1))*mN;
+			const float z = halfSize - r*dx;
+			VertexRecord* v = out + r*cols;
+
+			for(int c = 0; c < cols; ++c, ++v)
+			{
+				int s = rowBase + (c & (mN - 1));
+				v->Pos = XMFLOAT3(-halfSize + c*dx + mDisplaceX[s], mHeight[s], z + mDisplaceZ[s]);
+				v->Normal = mNormals[s];
+				v->TexC = XMFLOAT2(c*invN, r*invN);
+			}
+		}
+	});
+}
+
+void OceanFFT::WriteHeights(float* dst, size_t count, float alpha, const unsigned char* tileMask)const
+{
+	assert(count >= (size_t)VertexCount());
+	(void)count;
+	(void)alpha;
+	(void)tileMask;
+
+	const int cols = mN + 1;
+	mScheduler->ParallelFor(0, mN + 1, 0, [this, dst, cols](int r0, int r1)
+	{
+		for(int r = r0; r < r1; ++r)
+		{
+			const float* h = &mHeight[(r & (mN - 1))*mN];
+			float* out = dst + r*cols;
+			std::copy(h, h + mN, out);
+			out[mN] = h[0];
+		}
+	});
+}
+
+void OceanFFT::SetScheduler(TaskScheduler* scheduler)
+{
+	mScheduler = scheduler != nullptr ? scheduler : &TaskScheduler::Default();
+}
+
+int OceanFFT::Update(float dt)
+{
+	mTime += dt;
+
+	mScheduler->ParallelFor(0, mN, 0, [this](int r0, int r1)
+	{
+		EvaluateSpectrum(r0, r1);
+		for(int f = 0; f < 3; ++f)
+			InverseFftRows(mFieldRe[f].data(), mFieldIm[f].data(), r0, r1);
+	});
+
+	// Columns are transformed a block at a time so each butterfly sweeps a contiguous
+	// run of the block's columns.
+	int columnBlock = std::max(16, (mN / (int)(4*mScheduler->ThreadCount())) & ~3);
+	mScheduler->ParallelFor(0, mN, columnBlock, [this](int c0, int c1)
+	{
+		for(int f = 0; f < 3; ++f)
+			InverseFftColumns(mFieldRe[f].data(), mFieldIm[f].data(), c0, c1);
+	});
+
+	mScheduler->ParallelFor(0, mN, 0, [this](int r0, int r1)
+	{
+		BuildSurface(r0, r1);
+	});
+
+	return 1;
+}
+
+XMFLOAT2 OceanFFT::Spectrum(int row, int col)const
+{
+	float hr, hi;
+	Evolve(row*mN + col, hr, hi);
+	return XMFLOAT2(hr, hi);
+}
+
+void OceanFFT::EvaluateSpectrum(int row0, int row1)
+{
+	// h(k,t) = h0(k) e^(iwt) + conj(h0(-k)) e^(-iwt).  The real results we need are
+	// packed two to a transform, A + iB, since the inverse transform of each is real:
+	//   field 0: h          + i dh/du
+	//   field 1: dh/dv      + i Du
+	//   field 2: Dv
+	// with slopes i*k*h and choppy displacement D = -i*(k/|k|)*h.
+	for(int s = row0*mN; s < row1*mN; ++s)
+	{
+		float hr, hi;
+		Evolve(s, hr, hi);
+
+		float kx = mKx[s];
+		float kv = mKv[s];
+		float k = sqrtf(kx*kx + kv*kv);
+		float ux = k > 0.0f ? kx / k : 0.0f;
+		float uv = k > 0.0f ? kv / k : 0.0f;
+
+		// Slopes: i*k*h = (-k*hi, k*h r).  Displacement: -i*u*h = (u*hi, -u*hr).
+		float sxRe = -kx*hi, sxIm = kx*hr;
+		float svRe = -kv*hi, svIm = kv*hr;
+		float dxRe = ux*hi, dxIm = -ux*hr;
+		float dvRe = uv*hi, dvIm = -uv*hr;
+
+		// A + iB = (Ar - Bi) + i(Ai + Br).
+		mFieldRe[0][s] = hr - sxIm;
+		mFieldIm[0][s] = hi + sxRe;
+		mFieldRe[1][s] = svRe - dxIm;
+		mFieldIm[1][s] = svIm + dxRe;
+		mFieldRe[2][s] = dvRe;
+		mFieldIm[2][s] = dvIm;
+	}
+}
+
+void OceanFFT::InverseFftRows(float* re, float* im, int row0, int row1)const
+{
+	for(int r = row0; r < row1; ++r)
+	{
+		float* xr = re + r*mN;
+		float* xi = im + r*mN;
+
+		for(int i = 0; i < mN; ++i)
+		{
+			int j = mBitReverse[i];
+			if(i < j)
+			{
+				std::swap(xr[i], xr[j]);
+				std::swap(xi[i], xi[j]);
+			}
+		}
+
+		for(int h = 1; h < mN; h *= 2)
+		{
+			const float* wr = &mTwiddleRe[h - 1];
+			const float* wi = &mTwiddleIm[h - 1];
+			for(int start = 0; start < mN; start += 2*h)
+				ButterflyVarying(xr + start, xi + start, xr + start + h, xi + start + h, wr, wi, h);
+		}
+	}
+}
+
+void OceanFFT::InverseFftColumns(float* re, float* im, int col0, int col1)const
+{
+	const int span = col1 - col0;
+
+	for(int i = 0; i < mN; ++i)
+	{
+		int j = mBitReverse[i];
+		if(i < j)
+		{
+			std::swap_ranges(re + i*mN + col0, re + i*mN + col1, re + j*mN + col0);
+			std::swap_ranges(im + i*mN + col0, im + i*mN + col1, im + j*mN + col0);
+		}
+	}
+
+	for(int h = 1; h < mN; h *= 2)
+	{
+		for(int start = 0; start < mN; start += 2*h)
+		{
+			for(int k = 0; k < h; ++k)
+			{
+				int a = (start + k)*mN + col0;
+				int b = a + h*mN;
+				ButterflyUniform(re + a, im + a, re + b, im + b, mTwiddleRe[h - 1 + k], mTwiddleIm[h - 1 + k], span);
+			}
+		}
+	}
+}
+
+void OceanFFT::BuildSurface(int row0, int row1)
+{
+	for(int s = row0*mN; s < row1*mN; ++s)
+	{
+		float h = mFieldRe[0][s];
+		float dhdx = mFieldIm[0][s];
+		float dhdz = -mFieldRe[1][s];
+
+		mHeight[s] = h;
+		mDisplaceX[s] = mChoppiness*mFieldIm[1][s];
+		mDisplaceZ[s] = -mChoppiness*mFieldRe[2][s];
+
+		// n = (-dh/dx, 1, -dh/dz) and T = (1, dh/dx, 0), normalized.
+		float invN = 1.0f / sqrtf(dhdx*dhdx + 1.0f + dhdz*dhdz);
+		mNormals[s] = XMFLOAT3(-dhdx*invN, invN, -dhdz*invN);
+
+		float invT = 1.0f / sqrtf(1.0f + dhdx*dhdx);
+		mTangentX[s] = XMFLOAT3(invT, dhdx*invT, 0.0f);
+	}
+}
@@ -0,0 +1,161 @@
+//***************************************************************************************
+// OceanFFT.h
+//
+// Spectral ocean after Tessendorf, "Simulating Ocean Water".  A Phillips spectrum is
+// sampled once at construction; every update evolves it to the current time and runs
+// inverse FFTs for the height, its slopes and the horizontal (choppy) displacement.
+// The cost of an update does not depend on the time step, and the field is periodic,
+// so one patch can be repeated to cover any area without seams.
+//
+// Implements WaveSimulator, so the renderer can drive it in place of Waves.
+//***************************************************************************************
+
+#ifndef OCEANFFT_H
+#define OCEANFFT_H
+
+#include <cmath>
+#include <vector>
+#include <DirectXMath.h>
+#include "WaveSimulator.h"
+
+class OceanFFT : public WaveSimulator
+{
+public:
+	// n is the FFT size per side and must be a power of two of at least 2; other sizes
+	// throw std::invalid_argument, since only a radix-2 transform is implemented.  The patch covers
+	// patchSize x patchSize metres with (n+1) x (n+1) vertices; the last row and column
+	// repeat the first so neighbouring patches line up.  windDir is in the xz-plane.
+	// choppiness scales the horizontal displacement (0 gives a pure height field).
+	OceanFFT(int n, float patchSize, float windSpeed, const DirectX::XMFLOAT2& windDir,
+		float amplitude, float choppiness, unsigned seed = 1);
+	OceanFFT(const OceanFFT& rhs) = delete;
+	OceanFFT& operator=(const OceanFFT& rhs) = delete;
+	~OceanFFT();
+
+	int RowCount()const override { return mN + 1; }
+	int ColumnCount()const override { return mN + 1; }
+	int VertexCount()const override { return (mN + 1)*(mN + 1); }
+	int TriangleCount()const override { return 2*mN*mN; }
+	float Width()const override { return mPatchSize; }
+	float Depth()const override { return mPatchSize; }
+	float SpatialStep()const override { return mPatchSize / mN; }
+
+	// Sum of the spectrum's amplitudes, which no height or horizontal displacement can
+	// exceed at any time.
+	float MaxAmplitude()const override { return mMaxAmplitude; }
+
+	// The choppy displacement moves x and z, the analytic normals are not central
+	// differences, and the periodic edges have no fixed boundary.
+	bool IsHeightField()const override { return false; }
+
+	// Displaced position of the ith vertex.
+	DirectX::XMFLOAT3 Position(int i)const override;
+
+	// Height of the ith vertex.  The spectrum is evaluated at exactly the current time,
+	// so there is no separate previous solution to blend from.
+	float Height(int i)const override { return mHeight[Sample(i)]; }
+	float PreviousHeight(int i)const { return Height(i); }
+
+	const DirectX::XMFLOAT3& Normal(int i)const override { return mNormals[Sample(i)]; }
+	const DirectX::XMFLOAT3& TangentX(int i)const { return mTangentX[Sample(i)]; }
+
+	// Writes every vertex into dst, which must hold VertexCount() records.  Texture
+	// coordinates run 0..1 across a patch.  alpha and tileMask are ignored: the whole
+	// field moves every update.
+	void WriteVertices(void* dst, size_t byteSize, float alpha, const unsigned char* tileMask = nullptr)const override;
+
+	// Writes one height per vertex.  The horizontal displacement and the normals are not
+	// included, so renderers draw this engine from WriteVertices (see IsHeightField).
+	void WriteHeights(float* dst, size_t count, float alpha, const unsigned char* tileMask = nullptr)const override;
+
+	void SetScheduler(TaskScheduler* scheduler)override;
+
+	// Sets the field to time dt later.  Always a single evaluation; returns 1.
+	int Update(float dt)override;
+
+	// A spectral field has no local state to push on, so impulses are ignored.
+	void Disturb(int i, int j, float magnitude)override { (void)i; (void)j; (void)magnitude; }
+
+	float InterpolationAlpha()const override { return 0.0f; }
+
+	// There are no tiles; every update rewrites the whole surface.
+	const std::vector<unsigned char>& DirtyTiles()const override { return mNoTiles; }
+	void ClearDirtyTiles()override {}
+	float Time()const { return mTime; }
+
+	// The sample with FFT indices (row, col), where indices past n/2 are the negative
+	// frequencies: its wave vector (kx, kv), with v running down the rows (world -z),
+	// and its complex amplitude h(k, t) at the current time.  Height(i) is the real part
+	// of the inverse DFT of the amplitudes, sum h(k, t) e^(+2 pi i (row*r + col*c)/n).
+	DirectX::XMFLOAT2 WaveVector(int row, int col)const
+	{
+		return DirectX::XMFLOAT2(mKx[row*mN + col], mKv[row*mN + col]);
+	}
+	DirectX::XMFLOAT2 Spectrum(int row, int col)const;
+
+private:
+	// Index of the field sample behind the ith vertex.
+	int Sample(int i)const
+	{
+		int row = i / (mN + 1);
+		int col = i - row*(mN + 1);
+		return (row & (mN - 1))*mN + (col & (mN - 1));
+	}
+
+	// h(k,t) = h0(k) e^(iwt) + conj(h0(-k)) e^(-iwt) of sample s.
+	void Evolve(int s, float& hr, float& hi)const
+	{
+		float c = cosf(mOmega[s]*mTime);
+		float sn = sinf(mOmega[s]*mTime);
+		hr = (mH0Re[s] + mH0ConjRe[s])*c - (mH0Im[s] - mH0ConjIm[s])*sn;
+		hi = (mH0Im[s] + mH0ConjIm[s])*c + (mH0Re[s] - mH0ConjRe[s])*sn;
+	}
+
+	void EvaluateSpectrum(int row0, int row1);
+	void InverseFftRows(float* re, float* im, int row0, int row1)const;
+	void InverseFftColumns(float* re, float* im, int col0, int col1)const;
+	void BuildSurface(int row0, int row1);
+
+private:
+	int mN = 0;
+	int mLogN = 0;
+	float mPatchSize = 0.0f;
+	float mChoppiness = 0.0f;
+	float mMaxAmplitude = 0.0f;
+	float mTime = 0.0f;
+
+	// Wave vector components and dispersion per sample, in FFT order.  v runs down the
+	// rows, which is world -z.
+	std::vector<float> mKx;
+	std::vector<float> mKv;
+	std::vector<float> mOmega;
+
+	// h0(k) and conj(h0(-k)).
+	std::vector<float> mH0Re;
+	std::vector<float> mH0Im;
+	std::vector<float> mH0ConjRe;
+	std::vector<float> mH0ConjIm;
+
+	// Three complex fields, each packing two real results (see EvaluateSpectrum).
+	std::vector<float> mFieldRe[3];
+	std::vector<float> mFieldIm[3];
+
+	// Inverse FFT tables: bit reversal, and the twiddles of each stage laid out
+	// contiguously (the stage with half-size h starts at h-1).
+	std::vector<int> mBitReverse;
+	std::vector<float> mTwiddleRe;
+	std::vector<float> mTwiddleIm;
+
+	// Results per sample.
+	std::vector<float> mHeight;
+	std::vector<float> mDisplaceX;
+	std::vector<float> mDisplaceZ;
+	std::vector<DirectX::XMFLOAT3> mNormals;
+	std::vector<DirectX::XMFLOAT3> mTangentX;
+
+	std::vector<unsigned char> mNoTiles;
+
+	TaskScheduler* mScheduler = nullptr;
+};
+
+#endif // OCEANFFT_H
@@ -0,0 +1,75 @@
+//***************************************************************************************
+// WaterHeights.hlsl
+//
+// Vertex shader for the height-only water path.  The CPU uploads one height per grid
+// vertex; position, normal and texture coordinates are rebuilt here from the vertex
+// index and the neighbouring heights.  Shares everything else with Default.hlsl.
+// The layout, the fixed upward boundary normals and the texture coordinates follow
+// Waves; engines that are not height fields (WaveSimulator::IsHeightField) are drawn
+// from full vertices instead.
+//***************************************************************************************
+
+#include "Default.hlsl"
+
+// Blended wave heights, one per grid vertex in row-major order.
+StructuredBuffer<float> gWaterHeights : register(t1);
+
+// Grid layout, set as root constants.  The water is drawn in chunks whose indices are
+// relative to gWaterBaseVertex, the grid index of the chunk's first vertex.
+cbuffer cbWaterGrid : register(b3)
+{
+    uint  gWaterNumRows;
+    uint  gWaterNumCols;
+    float gWaterSpatialStep;
+    uint  gWaterBaseVertex;
+};
+
+VertexOut WaterVS(uint localId : SV_VertexID)
+{
+    VertexOut vout = (VertexOut)0.0f;
+
+    uint vertexId = gWaterBaseVertex + localId;
+
+    uint row = vertexId / gWaterNumCols;
+    uint col = vertexId - row*gWaterNumCols;
+
+    // Same layout as Waves: x grows with the column, z shrinks with the row.
+    float halfWidth = (gWaterNumCols - 1)*gWaterSpatialStep*0.5f;
+    float halfDepth = (gWaterNumRows - 1)*gWaterSpatialStep*0.5f;
+
+    float3 posL;
+    posL.x = -halfWidth + col*gWaterSpatialStep;
+    posL.y = gWaterHeights[vertexId];
+    posL.z = halfDepth - row*gWaterSpatialStep;
+
+    // Central differences, as Waves computes them; the boundary stays pointing up.
+    float3 normalL = float3(0.0f, 1.0f, 0.0f);
+    if(row > 0 && row + 1 < gWaterNumRows && col > 0 && col + 1 < gWaterNumCols)
+    {
+        float l = gWaterHeights[vertexId - 1];
+        float r = gWaterHeights[vertexId + 1];
+        float t = gWaterHeights[vertexId - gWaterNumCols];
+        float b = gWaterHeights[vertexId + gWaterNumCols];
+        normalL = normalize(float3(l - r, 2.0f*gWaterSpatialStep, b - t));
+    }
+
+    float2 texC;
+    texC.x = 0.5f + posL.x / (gWaterNumCols*gWaterSpatialStep);
+    texC.y = 0.5f - posL.z / (gWaterNumRows*gWaterSpatialStep);
+
+    // Transform to world space.
+    float4 posW = mul(float4(posL, 1.0f), gWorld);
+    vout.PosW = posW.xyz;
+
+    // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
+    vout.NormalW = mul(normalL, (float3x3)gWorld);
+
+    // Transform to homogeneous clip space.
+    vout.PosH = mul(posW, gViewProj);
+
+    // Output vertex attributes for interpolation across triangle.
+    float4 tex = mul(float4(texC, 0.0f, 1.0f), gTexTransform);
+    vout.TexC = mul(tex, gMatTransform).xy;
+
+    return vout;
+}
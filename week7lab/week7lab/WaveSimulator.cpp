@@ -0,0 +1,60 @@
+//***************************************************************************************
+// WaveSimulator.cpp
+//***************************************************************************************
+
+#include "WaveSimulator.h"
+#include "OceanFFT.h"
+#include "Waves.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	const char* const EngineNames[] = { "scalar", "simd", "tracked", "spectral" };
+	static_assert(sizeof(EngineNames) / sizeof(EngineNames[0]) == (size_t)WaveEngine::Count,
+		"EngineNames must list every WaveEngine.");
+}
+
+const char* WaveEngineName(WaveEngine engine)
+{
+	int k = (int)engine;
+	return (k >= 0 && k < (int)WaveEngine::Count) ? EngineNames[k] : "unknown";
+}
+
+bool ParseWaveEngine(const char* name, WaveEngine& engine)
+{
+	for(int k = 0; k < (int)WaveEngine::Count; ++k)
+	{
+		if(strcmp(name, EngineNames[k]) == 0)
+		{
+			engine = (WaveEngine)k;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::unique_ptr<WaveSimulator> CreateWaveSimulator(WaveEngine engine, const WaveSimulatorDesc& desc)
+{
+	if(engine == WaveEngine::Spectral)
+	{
+		int cells = std::max(desc.Rows, desc.Columns) - 1;
+		int n = 2;
+		while(n < cells)
+			n *= 2;
+
+		return std::unique_ptr<WaveSimulator>(new OceanFFT(n, n*desc.SpatialStep, desc.WindSpeed,
+			desc.WindDirection, desc.Amplitude, desc.Choppiness, desc.Seed));
+	}
+
+	std::unique_ptr<Waves> waves(new Waves(desc.Rows, desc.Columns, desc.SpatialStep,
+		desc.TimeStep, desc.Speed, desc.Damping));
+
+	// Waves picks the widest kernel by default.
+	if(engine == WaveEngine::Scalar)
+		waves->SetKernel(WaveKernels::Isa::Scalar);
+	waves->SetActiveTileTracking(engine == WaveEngine::Tracked);
+	waves->SetMaxAmplitude(desc.MaxHeight);
+
+	return waves;
+}
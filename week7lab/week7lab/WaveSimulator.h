@@ -0,0 +1,120 @@
+//***************************************************************************************
+// WaveSimulator.h
+//
+// Interface shared by the water engines, so the renderer and the benchmark can drive
+// any of them.  An engine is picked by name at run time through CreateWaveSimulator:
+//
+//   scalar    finite-difference Waves with the scalar stencil on every cell
+//   simd      finite-difference Waves with the widest stencil the CPU supports
+//   tracked   as simd, but tiles that have gone quiet are skipped (see
+//             Waves::SetActiveTileTracking)
+//   spectral  OceanFFT, a periodic FFT ocean that ignores Disturb
+//***************************************************************************************
+
+#ifndef WAVESIMULATOR_H
+#define WAVESIMULATOR_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <DirectXMath.h>
+
+class TaskScheduler;
+
+class WaveSimulator
+{
+public:
+	virtual ~WaveSimulator() {}
+
+	// The surface is a RowCount() x ColumnCount() grid of vertices in row-major order,
+	// centred on the origin in the xz-plane, with row 0 at +z.
+	virtual int RowCount()const = 0;
+	virtual int ColumnCount()const = 0;
+	virtual int VertexCount()const = 0;
+	virtual int TriangleCount()const = 0;
+	virtual float Width()const = 0;
+	virtual float Depth()const = 0;
+	virtual float SpatialStep()const = 0;
+
+	// Bound on how far a vertex strays from its rest position on the flat grid, both in
+	// height and sideways.  For padding culling bounds.
+	virtual float MaxAmplitude()const = 0;
+
+	// True when the heights alone describe the surface: x and z stay on the rest grid
+	// and the normals follow from central differences of the heights, with the
+	// boundary pointing up.  Only then can a renderer draw from WriteHeights.
+	virtual bool IsHeightField()const = 0;
+
+	virtual DirectX::XMFLOAT3 Position(int i)const = 0;
+	virtual float Height(int i)const = 0;
+	virtual const DirectX::XMFLOAT3& Normal(int i)const = 0;
+
+	// Interleaved layout written by WriteVertices, 32 bytes per vertex.
+	struct VertexRecord
+	{
+		DirectX::XMFLOAT3 Pos;
+		DirectX::XMFLOAT3 Normal;
+		DirectX::XMFLOAT2 TexC;
+	};
+
+	// Bulk export of the surface into dst, which may be mapped upload memory.  alpha
+	// blends toward the newest solution (see InterpolationAlpha); tileMask selects the
+	// tiles to write, one byte per entry of DirtyTiles, or every tile when null.
+	virtual void WriteVertices(void* dst, size_t byteSize, float alpha, const unsigned char* tileMask = nullptr)const = 0;
+	virtual void WriteHeights(float* dst, size_t count, float alpha, const unsigned char* tileMask = nullptr)const = 0;
+
+	virtual void SetScheduler(TaskScheduler* scheduler) = 0;
+
+	// Advances the surface by dt and returns the number of simulation steps taken.
+	virtual int Update(float dt) = 0;
+	virtual void Disturb(int i, int j, float magnitude) = 0;
+	virtual float InterpolationAlpha()const = 0;
+
+	// Tiles whose vertices changed since the last ClearDirtyTiles.  An engine without
+	// tiles returns an empty vector, and callers then write the whole surface.
+	virtual const std::vector<unsigned char>& DirtyTiles()const = 0;
+	virtual void ClearDirtyTiles() = 0;
+};
+
+enum class WaveEngine
+{
+	Scalar,
+	Simd,
+	Tracked,
+	Spectral,
+	Count
+};
+
+const char* WaveEngineName(WaveEngine engine);
+
+// Looks up an engine by the name WaveEngineName gives it.  Returns false if there is none.
+bool ParseWaveEngine(const char* name, WaveEngine& engine);
+
+// Parameters for every engine; each one reads the fields it needs.
+struct WaveSimulatorDesc
+{
+	int Rows = 128;
+	int Columns = 128;
+	float SpatialStep = 1.0f;
+
+	// Finite-difference engines.
+	float TimeStep = 0.03f;
+	float Speed = 4.0f;
+	float Damping = 0.2f;
+
+	// The finite-difference grid does not bound its heights; this is the largest the
+	// caller's disturbances are expected to raise them.  Only used for culling.
+	float MaxHeight = 2.0f;
+
+	// Spectral engine.  The FFT size is max(Rows, Columns) - 1 rounded up to a power of
+	// two, so the patch covers at least the requested grid.
+	float WindSpeed = 8.0f;
+	DirectX::XMFLOAT2 WindDirection = DirectX::XMFLOAT2(1.0f, 0.5f);
+	float Amplitude = 3.0e-6f;
+	float Choppiness = 0.8f;
+	unsigned Seed = 1;
+};
+
+std::unique_ptr<WaveSimulator> CreateWaveSimulator(WaveEngine engine, const WaveSimulatorDesc& desc);
+
+#endif // WAVESIMULATOR_H
@@ -3,13 +3,49 @@
 //***************************************************************************************
 
 #include "Waves.h"
-#include <ppl.h>
+#include "../Common/MappedFile.h"
+#include "../Common/TaskScheduler.h"
 #include <algorithm>
 #include <vector>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
 
 using namespace DirectX;
 
+namespace
+{
+	// Layout of a snapshot file.  The header is followed by zero padding up to
+	// PrevOffset and CurrOffset, each holding Rows*Columns floats.  Files are written
+	// in the byte order of the machine that wrote them.
+	struct SnapshotHeader
+	{
+		char Magic[4];
+		std::uint32_t Version;
+		std::uint32_t HeaderSize;
+		std::int32_t Rows;
+		std::int32_t Columns;
+		float SpatialStep;
+		float TimeStep;
+		float K1;
+		float K2;
+		float K3;
+		float Accumulator;
+		std::uint32_t Reserved;
+		std::uint64_t PrevOffset;
+		std::uint64_t CurrOffset;
+	};
+
+	const char SnapshotMagic[4] = { 'W', 'A', 'V', 'S' };
+	const std::uint32_t SnapshotVersion = 1;
+
+	// StepBlocked's copy of a tile and its halo.  One per thread, grown on first use
+	// and then reused by every blocked step without being cleared.
+	thread_local std::vector<float> tBlockTile;
+}
+
 Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 {
     mNumRows = m;
@@ -27,28 +63,45 @@ Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
     mK2 = (4.0f - 8.0f*e) / d;
     mK3 = (2.0f*e) / d;
 
-    mPrevSolution.resize(m*n);
-    mCurrSolution.resize(m*n);
-    mNormals.resize(m*n);
-    mTangentX.resize(m*n);
+    // The grid starts flat; x and z are derived from the grid indices in Position().
+    mHalfWidth = (n - 1)*dx*0.5f;
+    mHalfDepth = (m - 1)*dx*0.5f;
 
-    // Generate grid vertices in system memory.
+    mVertexX.resize(n);
+    mTexU.resize(n);
+    for(int j = 0; j < n; ++j)
+    {
+        mVertexX[j] = -mHalfWidth + j*dx;
+        mTexU[j] = 0.5f + mVertexX[j] / Width();
+    }
 
-    float halfWidth = (n - 1)*dx*0.5f;
-    float halfDepth = (m - 1)*dx*0.5f;
+    mVertexZ.resize(m);
+    mTexV.resize(m);
     for(int i = 0; i < m; ++i)
     {
-        float z = halfDepth - i*dx;
-        for(int j = 0; j < n; ++j)
-        {
-            float x = -halfWidth + j*dx;
-
-            mPrevSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
-            mCurrSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
-            mNormals[i*n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-            mTangentX[i*n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
-        }
+        mVertexZ[i] = mHalfDepth - i*dx;
+        mTexV[i] = 0.5f - mVertexZ[i] / Depth();
     }
+
+    mPrevSolution.assign(m*n, 0.0f);
+    mCurrSolution.assign(m*n, 0.0f);
+    mNormals.assign(m*n, XMFLOAT3(0.0f, 1.0f, 0.0f));
+    mTangentX.assign(m*n, XMFLOAT3(1.0f, 0.0f, 0.0f));
+
+    SetKernel(WaveKernels::DetectIsa());
+    mScheduler = &TaskScheduler::Default();
+
+    // Everything starts flat, so every tile starts asleep.
+    mTileRows = (m + mTileSize - 1) / mTileSize;
+    mTileCols = (n + mTileSize - 1) / mTileSize;
+    mTileActive.assign(mTileRows*mTileCols, 0);
+    mTileDirty.assign(mTileRows*mTileCols, 1);
+    mTileEnergetic.assign(mTileRows*mTileCols, 0);
+    mTileWasActive.assign(mTileRows*mTileCols, 0);
+    mRowTileHeight.assign(m*mTileCols, 0.0f);
+    mRowTileChange.assign(m*mTileCols, 0.0f);
+
+    PublishHeights();
 }
 
 Waves::~Waves()
@@ -85,73 +138,702 @@ float Waves::Depth()const
 	return mNumRows*mSpatialStep;
 }
 
-void Waves::Update(float dt)
+template<typename Fn>
+void Waves::ForEachFlaggedSpan(const unsigned char* tileMask, Fn fn)const
+{
+	mScheduler->ParallelFor(0, mNumRows, mRowChunkSize, [this, tileMask, &fn](int i0, int i1)
+	{
+		for(int i = i0; i < i1; ++i)
+		{
+			const unsigned char* rowMask = tileMask ? tileMask + (i / mTileSize)*mTileCols : nullptr;
+
+			// Hand over each run of flagged tiles as one sequential span.
+			int tc = 0;
+			while(tc < mTileCols)
+			{
+				if(rowMask && !rowMask[tc])
+				{
+					++tc;
+					continue;
+				}
+
+				int first = tc;
+				while(tc < mTileCols && (!rowMask || rowMask[tc]))
+					++tc;
+
+				fn(i, first*mTileSize, std::min(tc*mTileSize, mNumCols));
+			}
+		}
+	});
+}
+
+void Waves::WriteVertices(void* dst, size_t byteSize, float alpha, const unsigned char* tileMask)const
+{
+	assert(byteSize >= (size_t)mVertexCount*sizeof(VertexRecord));
+	(void)byteSize;
+
+	VertexRecord* out = static_cast<VertexRecord*>(dst);
+	ForEachFlaggedSpan(tileMask, [this, out, alpha](int i, int j0, int j1)
+	{
+		int k = i*mNumCols + j0;
+		WaveKernels::EmitVertexRow(&out[k].Pos.x, &mPrevSolution[k], &mCurrSolution[k], &mNormals[k].x,
+			&mVertexX[j0], mVertexZ[i], &mTexU[j0], mTexV[i], j1 - j0, alpha);
+	});
+}
+
+void Waves::SampleHeights(const XMFLOAT2* xz, float* heights, size_t count, XMFLOAT3* normals)const
+{
+	if(count == 0)
+		return;
+
+	const float* h = mPublishedHeights.load(std::memory_order_acquire);
+	WaveKernels::SampleBilinear(h, mNumRows, mNumCols, -mHalfWidth, mHalfDepth, mSpatialStep,
+		&xz[0].x, (int)count, heights, normals != nullptr ? &normals[0].x : nullptr);
+}
+
+void Waves::WriteHeights(float* dst, size_t count, float alpha, const unsigned char* tileMask)const
 {
-	static float t = 0;
+	assert(count >= (size_t)mVertexCount);
+	(void)count;
 
+	ForEachFlaggedSpan(tileMask, [this, dst, alpha](int i, int j0, int j1)
+	{
+		int k = i*mNumCols + j0;
+		WaveKernels::EmitHeightRow(dst + k, &mPrevSolution[k], &mCurrSolution[k], j1 - j0, alpha);
+	});
+}
+
+void Waves::SetKernel(WaveKernels::Isa isa)
+{
+	mKernel = std::min(isa, WaveKernels::DetectIsa());
+	mStencilRow = WaveKernels::GetStencilRow(mKernel);
+}
+
+void Waves::SetScheduler(TaskScheduler* scheduler)
+{
+	mScheduler = scheduler != nullptr ? scheduler : &TaskScheduler::Default();
+}
+
+void Waves::SetRowChunkSize(int rows)
+{
+	mRowChunkSize = rows;
+}
+
+void Waves::SetActiveTileTracking(bool enable)
+{
+	mTrackActiveTiles = enable;
+
+	// Waking everything is always safe; tracking puts idle tiles back to sleep.
+	std::fill(mTileActive.begin(), mTileActive.end(), (unsigned char)1);
+	std::fill(mTileDirty.begin(), mTileDirty.end(), (unsigned char)1);
+}
+
+void Waves::ClearDirtyTiles()
+{
+	mTileDirty = mTileActive;
+}
+
+void Waves::SetMaxSubsteps(int steps)
+{
+	mMaxSubsteps = std::max(1, steps);
+}
+
+void Waves::SetTemporalBlockSteps(int steps)
+{
+	mTemporalBlockSteps = std::max(1, steps);
+}
+
+int Waves::Update(float dt)
+{
 	// Accumulate time.
-	t += dt;
+	mAccumulator += dt;
 
 	// Only update the simulation at the specified time step.
-	if( t >= mTimeStep )
+	int steps = 0;
+	while(mAccumulator >= mTimeStep && steps < mMaxSubsteps)
 	{
-		// Only update interior points; we use zero boundary conditions.
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-		//for(int i = 1; i < mNumRows-1; ++i)
+		mAccumulator -= mTimeStep;
+		++steps;
+	}
+
+	// Fell too far behind; drop the backlog rather than trying to catch up.
+	if(mAccumulator >= mTimeStep)
+		mAccumulator = std::fmod(mAccumulator, mTimeStep);
+
+	Simulate(steps);
+	return steps;
+}
+
+void Waves::Simulate(int steps)
+{
+	while(steps > 0)
+	{
+		// Queued impulses land after the next step, so that step has to run on its own.
+		int block = (mTrackActiveTiles || !mPendingImpulses.empty()) ? 1 : std::min(steps, mTemporalBlockSteps);
+		if(block > 1)
+			StepBlocked(block);
+		else
+			Step();
+
+		steps -= block;
+	}
+}
+
+void Waves::Step()
+{
+	FlattenSleptTiles();
+	BuildTileRuns();
+	BucketImpulses();
+
+	if(mUpdateMode == UpdateMode::Fused)
+		StepFused();
+	else
+		StepTwoPass();
+
+	UpdateTileActivity();
+	FinishImpulses();
+	PublishHeights();
+}
+
+void Waves::FlattenSleptTiles()
+{
+	// mPrevSolution was published until the last step finished; nothing samples it now.
+	for(int t : mTilesToFlatten)
+	{
+		int i0 = (t / mTileCols)*mTileSize;
+		int j0 = (t % mTileCols)*mTileSize;
+		int i1 = std::min(i0 + mTileSize, mNumRows);
+		int j1 = std::min(j0 + mTileSize, mNumCols);
+		for(int i = i0; i < i1; ++i)
+			std::fill(&mPrevSolution[i*mNumCols + j0], &mPrevSolution[i*mNumCols + j1], 0.0f);
+
+		mTileDirty[t] = 1;
+	}
+
+	mTilesToFlatten.clear();
+}
+
+void Waves::PublishHeights()
+{
+	mPublishedHeights.store(mCurrSolution.data(), std::memory_order_release);
+}
+
+bool Waves::SaveSnapshot(const char* path)const
+{
+	const std::uint64_t heightBytes = (std::uint64_t)mVertexCount*sizeof(float);
+
+	SnapshotHeader header = {};
+	memcpy(header.Magic, SnapshotMagic, sizeof(header.Magic));
+	header.Version = SnapshotVersion;
+	header.HeaderSize = sizeof(SnapshotHeader);
+	header.Rows = mNumRows;
+	header.Columns = mNumCols;
+	header.SpatialStep = mSpatialStep;
+	header.TimeStep = mTimeStep;
+	header.K1 = mK1;
+	header.K2 = mK2;
+	header.K3 = mK3;
+	header.Accumulator = mAccumulator;
+	header.PrevOffset = MappedFile::AlignToPage(sizeof(SnapshotHeader));
+	header.CurrOffset = MappedFile::AlignToPage(header.PrevOffset + heightBytes);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if(!file)
+		return false;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	MappedFile::PadTo(file, header.PrevOffset);
+	file.write(reinterpret_cast<const char*>(mPrevSolution.data()), (std::streamsize)heightBytes);
+	MappedFile::PadTo(file, header.CurrOffset);
+	file.write(reinterpret_cast<const char*>(mCurrSolution.data()), (std::streamsize)heightBytes);
+
+	return (bool)file;
+}
+
+bool Waves::LoadSnapshot(const char* path)
+{
+	MappedFile file;
+	if(!file.Open(path) || file.Size() < sizeof(SnapshotHeader))
+		return false;
+
+	SnapshotHeader header;
+	memcpy(&header, file.Data(), sizeof(header));
+
+	const std::uint64_t heightBytes = (std::uint64_t)mVertexCount*sizeof(float);
+	if(memcmp(header.Magic, SnapshotMagic, sizeof(header.Magic)) != 0 ||
+		header.Version != SnapshotVersion ||
+		header.HeaderSize != sizeof(SnapshotHeader) ||
+		header.Rows != mNumRows || header.Columns != mNumCols ||
+		header.SpatialStep != mSpatialStep ||
+		header.TimeStep != mTimeStep ||
+		header.K1 != mK1 || header.K2 != mK2 || header.K3 != mK3 ||
+		!(header.Accumulator >= 0.0f && header.Accumulator < mTimeStep) ||
+		!file.SectionFits(header.PrevOffset, heightBytes) ||
+		!file.SectionFits(header.CurrOffset, heightBytes))
+	{
+		return false;
+	}
+
+	const float* prev = reinterpret_cast<const float*>(file.Data() + header.PrevOffset);
+	const float* curr = reinterpret_cast<const float*>(file.Data() + header.CurrOffset);
+	std::copy(prev, prev + mVertexCount, mPrevSolution.begin());
+	std::copy(curr, curr + mVertexCount, mCurrSolution.begin());
+
+	mAccumulator = header.Accumulator;
+	mPendingImpulses.clear();
+	mTilesToFlatten.clear();
+
+	// Start with every tile awake; tracking puts the calm ones back to sleep.
+	std::fill(mTileActive.begin(), mTileActive.end(), (unsigned char)1);
+	std::fill(mTileDirty.begin(), mTileDirty.end(), (unsigned char)1);
+
+	NormalPass();
+	PublishHeights();
+
+	return true;
+}
+
+void Waves::StepBlocked(int steps)
+{
+	// Simulate steps on its own whenever impulses are queued.
+	assert(mPendingImpulses.empty());
+
+	FlattenSleptTiles();
+
+	// A tile plus its halo, in both height buffers, should fit in a 256 KB L2: two
+	// 160 x 160 float grids take 200 KB.  The halo is recomputed by every tile that
+	// overlaps it, so the tiles cannot shrink too far.
+	const int localEdge = 160;
+	const int tileEdge = std::max(localEdge - 2*steps, 32);
+	const int tileRows = (mNumRows + tileEdge - 1) / tileEdge;
+	const int tileCols = (mNumCols + tileEdge - 1) / tileEdge;
+
+	mBlockPrev.resize(mVertexCount);
+	mBlockCurr.resize(mVertexCount);
+
+	mScheduler->ParallelFor(0, tileRows*tileCols, 0, [this, steps, tileEdge, tileCols](int t0, int t1)
+	{
+		const size_t span = tileEdge + 2*steps;
+		if(tBlockTile.size() < 2*span*span)
+			tBlockTile.resize(2*span*span);
+
+		for(int t = t0; t < t1; ++t)
 		{
-			for(int j = 1; j < mNumCols-1; ++j)
+			int i0 = (t / tileCols)*tileEdge;
+			int j0 = (t % tileCols)*tileEdge;
+			int i1 = std::min(i0 + tileEdge, mNumRows);
+			int j1 = std::min(j0 + tileEdge, mNumCols);
+
+			// Copy the tile and its halo, clipped to the grid.
+			int li0 = std::max(i0 - steps, 0);
+			int lj0 = std::max(j0 - steps, 0);
+			int li1 = std::min(i1 + steps, mNumRows);
+			int lj1 = std::min(j1 + steps, mNumCols);
+			int w = lj1 - lj0;
+
+			float* prev = tBlockTile.data();
+			float* curr = prev + span*span;
+			for(int i = li0; i < li1; ++i)
 			{
-				// After this update we will be discarding the old previous
-				// buffer, so overwrite that buffer with the new update.
-				// Note how we can do this inplace (read/write to same element) 
-				// because we won't need prev_ij again and the assignment happens last.
-
-				// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-				// Moreover, our +z axis goes "down"; this is just to 
-				// keep consistent with our row indices going down.
-
-				mPrevSolution[i*mNumCols+j].y = 
-					mK1*mPrevSolution[i*mNumCols+j].y +
-					mK2*mCurrSolution[i*mNumCols+j].y +
-					mK3*(mCurrSolution[(i+1)*mNumCols+j].y + 
-					     mCurrSolution[(i-1)*mNumCols+j].y + 
-					     mCurrSolution[i*mNumCols+j+1].y + 
-						 mCurrSolution[i*mNumCols+j-1].y);
+				std::copy(&mPrevSolution[i*mNumCols + lj0], &mPrevSolution[i*mNumCols + lj1], prev + (i - li0)*w);
+				std::copy(&mCurrSolution[i*mNumCols + lj0], &mCurrSolution[i*mNumCols + lj1], curr + (i - li0)*w);
 			}
-		});
 
-		// We just overwrote the previous buffer with the new data, so
-		// this data needs to become the current solution and the old
-		// current solution becomes the new previous solution.
-		std::swap(mPrevSolution, mCurrSolution);
+			// After step s the heights are correct up to steps - s cells outside the
+			// tile, so each step updates a region one cell smaller on every side.  The
+			// grid boundary is never updated, exactly as in Step.
+			for(int s = 1; s <= steps; ++s)
+			{
+				int e = steps - s;
+				int r0 = std::max(i0 - e, 1);
+				int r1 = std::min(i1 + e, mNumRows - 1);
+				int c0 = std::max(j0 - e, 1);
+				int c1 = std::min(j1 + e, mNumCols - 1);
+
+				if(c1 > c0)
+				{
+					for(int i = r0; i < r1; ++i)
+					{
+						int k = (i - li0)*w + (c0 - lj0);
+						mStencilRow(prev + k, curr + k, curr + k - w, curr + k + w, c1 - c0, mK1, mK2, mK3);
+					}
+				}
+
+				std::swap(prev, curr);
+			}
 
-		t = 0.0f; // reset time
+			for(int i = i0; i < i1; ++i)
+			{
+				int k = (i - li0)*w + (j0 - lj0);
+				std::copy(prev + k, prev + k + (j1 - j0), &mBlockPrev[i*mNumCols + j0]);
+				std::copy(curr + k, curr + k + (j1 - j0), &mBlockCurr[i*mNumCols + j0]);
+			}
+		}
+	});
+
+	std::swap(mPrevSolution, mBlockPrev);
+	std::swap(mCurrSolution, mBlockCurr);
+
+	// Only the normals of the last step are ever seen.
+	NormalPass();
+
+	UpdateTileActivity();
+	PublishHeights();
+}
+
+void Waves::BucketImpulses()
+{
+	if(mPendingImpulses.empty())
+		return;
 
-		//
-		// Compute normals using finite difference scheme.
-		//
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-		//for(int i = 1; i < mNumRows - 1; ++i)
+	// Split each impulse into its contributions to three rows and counting-sort them by
+	// row.  The sort is stable, so every cell still receives its additions in the
+	// order the impulses were queued.
+	mImpulseRowStart.assign(mNumRows + 1, 0);
+	for(const Impulse& p : mPendingImpulses)
+	{
+		mImpulseRowStart[p.Row - 1 + 1]++;
+		mImpulseRowStart[p.Row + 1]++;
+		mImpulseRowStart[p.Row + 1 + 1]++;
+	}
+
+	for(int i = 0; i < mNumRows; ++i)
+		mImpulseRowStart[i + 1] += mImpulseRowStart[i];
+
+	mRowImpulses.resize(mImpulseRowStart[mNumRows]);
+	mImpulseCursor.assign(mImpulseRowStart.begin(), mImpulseRowStart.end() - 1);
+	for(const Impulse& p : mPendingImpulses)
+	{
+		float halfMag = 0.5f*p.Magnitude;
+		mRowImpulses[mImpulseCursor[p.Row - 1]++] = { p.Column, halfMag, 0.0f };
+		mRowImpulses[mImpulseCursor[p.Row]++]     = { p.Column, p.Magnitude, halfMag };
+		mRowImpulses[mImpulseCursor[p.Row + 1]++] = { p.Column, halfMag, 0.0f };
+	}
+}
+
+void Waves::ImpulseRow(int i)
+{
+	if(mImpulseRowStart.empty())
+		return;
+
+	// Row i of the new heights is only written by the task that just stepped it.
+	float* row = &mPrevSolution[i*mNumCols];
+	for(int k = mImpulseRowStart[i]; k < mImpulseRowStart[i + 1]; ++k)
+	{
+		const RowImpulse& p = mRowImpulses[k];
+		row[p.Column] += p.Center;
+		if(p.Side != 0.0f)
+		{
+			row[p.Column + 1] += p.Side;
+			row[p.Column - 1] += p.Side;
+		}
+	}
+}
+
+void Waves::FinishImpulses()
+{
+	if(mPendingImpulses.empty())
+		return;
+
+	// The sweep only computed normals in tiles that were active.  An impulse that woke
+	// a sleeping tile changes the normals up to two cells away, so redo those.
+	if(mTrackActiveTiles)
+	{
+		for(const Impulse& p : mPendingImpulses)
+		{
+			int j0 = std::max(p.Column - 2, 1);
+			int j1 = std::min(p.Column + 3, mNumCols - 1);
+			for(int i = std::max(p.Row - 2, 1); i <= std::min(p.Row + 2, mNumRows - 2); ++i)
+				NormalSpan(mCurrSolution, i, j0, j1);
+		}
+	}
+
+	mPendingImpulses.clear();
+	mImpulseRowStart.clear();
+}
+
+void Waves::StepTwoPass()
+{
+	// Only update interior points; we use zero boundary conditions.
+	mScheduler->ParallelFor(1, mNumRows - 1, mRowChunkSize, [this](int i0, int i1)
+	{
+		for(int i = i0; i < i1; ++i)
+		{
+			StencilRow(i);
+			ImpulseRow(i);
+			ActivityRow(i);
+		}
+	});
+
+	// We just overwrote the previous buffer with the new data, so
+	// this data needs to become the current solution and the old
+	// current solution becomes the new previous solution.
+	std::swap(mPrevSolution, mCurrSolution);
+
+	//
+	// Compute normals using finite difference scheme.
+	//
+	mScheduler->ParallelFor(1, mNumRows - 1, mRowChunkSize, [this](int i0, int i1)
+	{
+		for(int i = i0; i < i1; ++i)
+			NormalRow(mCurrSolution, i);
+	});
+}
+
+void Waves::StepFused()
+{
+	// The new heights land in mPrevSolution.  Within a band, the normals of row i-1 can
+	// be computed as soon as row i is done.  Only the first and last row of each band
+	// depend on a neighbouring band, so they are patched up once every band is done.
+	int bandRows = BandRowCount();
+	int numBands = (mNumRows - 2 + bandRows - 1) / bandRows;
+
+	mScheduler->ParallelFor(0, numBands, 1, [this, bandRows](int b0, int b1)
+	{
+		for(int band = b0; band < b1; ++band)
+		{
+			int first = 1 + band*bandRows;
+			int last = std::min(first + bandRows, mNumRows - 1) - 1;
+
+			for(int i = first; i <= last; ++i)
+			{
+				StencilRow(i);
+				ImpulseRow(i);
+				ActivityRow(i);
+				if(i - 1 > first)
+					NormalRow(mPrevSolution, i - 1);
+			}
+		}
+	});
+
+	mScheduler->ParallelFor(0, numBands, 0, [this, bandRows](int b0, int b1)
+	{
+		for(int band = b0; band < b1; ++band)
+		{
+			int first = 1 + band*bandRows;
+			int last = std::min(first + bandRows, mNumRows - 1) - 1;
+
+			NormalRow(mPrevSolution, first);
+			if(last != first)
+				NormalRow(mPrevSolution, last);
+		}
+	});
+
+	std::swap(mPrevSolution, mCurrSolution);
+}
+
+void Waves::StencilRow(int i)
+{
+	// After this update we will be discarding the old previous
+	// buffer, so overwrite that buffer with the new update.
+	// Note how we can do this inplace (read/write to same element) 
+	// because we won't need prev_ij again and the assignment happens last.
+
+	// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+	// Moreover, our +z axis goes "down"; this is just to 
+	// keep consistent with our row indices going down.
+
+	// The kernel runs once per span of active tiles; sleeping tiles are flat in
+	// both buffers, so skipping them leaves them flat after the swap too.
+	int tileRow = i / mTileSize;
+	for(int r = mTileRunStart[tileRow]; r < mTileRunStart[tileRow + 1]; r += 2)
+	{
+		int row = i*mNumCols + mTileRuns[r];
+		mStencilRow(&mPrevSolution[row], &mCurrSolution[row],
+			&mCurrSolution[row - mNumCols], &mCurrSolution[row + mNumCols],
+			mTileRuns[r + 1] - mTileRuns[r], mK1, mK2, mK3);
+	}
+}
+
+void Waves::ActivityRow(int i)
+{
+	if(!mTrackActiveTiles)
+		return;
+
+	// Row i of the new heights was just written and is still in cache.  Record its
+	// largest height and change per active tile; UpdateTileActivity folds the rows.
+	int tileRow = i / mTileSize;
+	for(int r = mTileRunStart[tileRow]; r < mTileRunStart[tileRow + 1]; r += 2)
+	{
+		for(int j0 = mTileRuns[r]; j0 < mTileRuns[r + 1]; )
+		{
+			int tc = j0 / mTileSize;
+			int j1 = std::min((tc + 1)*mTileSize, mTileRuns[r + 1]);
+
+			float maxHeight = 0.0f;
+			float maxChange = 0.0f;
+			WaveKernels::RowActivity(&mPrevSolution[i*mNumCols + j0], &mCurrSolution[i*mNumCols + j0],
+				j1 - j0, maxHeight, maxChange);
+			mRowTileHeight[i*mTileCols + tc] = maxHeight;
+			mRowTileChange[i*mTileCols + tc] = maxChange;
+
+			j0 = j1;
+		}
+	}
+}
+
+void Waves::NormalPass()
+{
+	BuildTileRuns();
+	mScheduler->ParallelFor(1, mNumRows - 1, mRowChunkSize, [this](int i0, int i1)
+	{
+		for(int i = i0; i < i1; ++i)
+			NormalRow(mCurrSolution, i);
+	});
+}
+
+void Waves::NormalRow(const std::vector<float>& h, int i)
+{
+	int tileRow = i / mTileSize;
+	for(int r = mTileRunStart[tileRow]; r < mTileRunStart[tileRow + 1]; r += 2)
+		NormalSpan(h, i, mTileRuns[r], mTileRuns[r + 1]);
+}
+
+void Waves::NormalSpan(const std::vector<float>& h, int i, int j0, int j1)
+{
+	const float twoDx = 2.0f*mSpatialStep;
+	const float twoDxSq = twoDx*twoDx;
+
+	for(int j = j0; j < j1; ++j)
+	{
+		float l = h[i*mNumCols+j-1];
+		float r = h[i*mNumCols+j+1];
+		float t = h[(i-1)*mNumCols+j];
+		float b = h[(i+1)*mNumCols+j];
+
+		// n = (l-r, 2dx, b-t) and T = (2dx, r-l, 0), normalized.
+		float dxh = l - r;
+		float dzh = b - t;
+
+		float invN = 1.0f / sqrtf(dxh*dxh + twoDxSq + dzh*dzh);
+		mNormals[i*mNumCols+j] = XMFLOAT3(dxh*invN, twoDx*invN, dzh*invN);
+
+		float invT = 1.0f / sqrtf(twoDxSq + dxh*dxh);
+		mTangentX[i*mNumCols+j] = XMFLOAT3(twoDx*invT, -dxh*invT, 0.0f);
+	}
+}
+
+void Waves::WakeTilesAround(int i, int j)
+{
+	int tileRow = i / mTileSize;
+	int tileCol = j / mTileSize;
+
+	for(int tr = std::max(tileRow - 1, 0); tr <= std::min(tileRow + 1, mTileRows - 1); ++tr)
+	{
+		for(int tc = std::max(tileCol - 1, 0); tc <= std::min(tileCol + 1, mTileCols - 1); ++tc)
 		{
-			for(int j = 1; j < mNumCols-1; ++j)
+			mTileActive[tr*mTileCols + tc] = 1;
+			mTileDirty[tr*mTileCols + tc] = 1;
+		}
+	}
+}
+
+void Waves::BuildTileRuns()
+{
+	mTileRunStart.resize(mTileRows + 1);
+	mTileRuns.clear();
+
+	// Merge neighbouring active tiles into one span so the kernels see long rows.
+	for(int tr = 0; tr < mTileRows; ++tr)
+	{
+		mTileRunStart[tr] = (int)mTileRuns.size();
+
+		int tc = 0;
+		while(tc < mTileCols)
+		{
+			if(mTrackActiveTiles && !mTileActive[tr*mTileCols + tc])
 			{
-				float l = mCurrSolution[i*mNumCols+j-1].y;
-				float r = mCurrSolution[i*mNumCols+j+1].y;
-				float t = mCurrSolution[(i-1)*mNumCols+j].y;
-				float b = mCurrSolution[(i+1)*mNumCols+j].y;
-				mNormals[i*mNumCols+j].x = -r+l;
-				mNormals[i*mNumCols+j].y = 2.0f*mSpatialStep;
-				mNormals[i*mNumCols+j].z = b-t;
-
-				XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i*mNumCols+j]));
-				XMStoreFloat3(&mNormals[i*mNumCols+j], n);
-
-				mTangentX[i*mNumCols+j] = XMFLOAT3(2.0f*mSpatialStep, r-l, 0.0f);
-				XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i*mNumCols+j]));
-				XMStoreFloat3(&mTangentX[i*mNumCols+j], T);
+				++tc;
+				continue;
 			}
-		});
+
+			int first = tc;
+			while(tc < mTileCols && (!mTrackActiveTiles || mTileActive[tr*mTileCols + tc]))
+				++tc;
+
+			mTileRuns.push_back(std::max(first*mTileSize, 1));
+			mTileRuns.push_back(std::min(tc*mTileSize, mNumCols - 1));
+		}
 	}
+
+	mTileRunStart[mTileRows] = (int)mTileRuns.size();
+}
+
+void Waves::UpdateTileActivity()
+{
+	if(!mTrackActiveTiles)
+		return;
+
+	// The sweep recorded each row's maxima per tile; only the boundary rows, which
+	// never move, were skipped and stay zero.
+	int tileCount = mTileRows*mTileCols;
+	for(int t = 0; t < tileCount; ++t)
+	{
+		mTileEnergetic[t] = 0;
+		if(!mTileActive[t])
+			continue;
+
+		int tc = t % mTileCols;
+		int i0 = (t / mTileCols)*mTileSize;
+		int i1 = std::min(i0 + mTileSize, mNumRows);
+
+		float maxHeight = 0.0f;
+		float maxChange = 0.0f;
+		for(int i = i0; i < i1; ++i)
+		{
+			maxHeight = std::max(maxHeight, mRowTileHeight[i*mTileCols + tc]);
+			maxChange = std::max(maxChange, mRowTileChange[i*mTileCols + tc]);
+		}
+
+		mTileEnergetic[t] = (maxHeight >= mSleepThreshold || maxChange >= mSleepThreshold) ? 1 : 0;
+	}
+
+	// A wave moves one cell per step, so energy in a tile can reach its neighbours by
+	// the next step.  Keep them awake too.
+	std::copy(mTileActive.begin(), mTileActive.end(), mTileWasActive.begin());
+	std::fill(mTileActive.begin(), mTileActive.end(), (unsigned char)0);
+	for(int t = 0; t < tileCount; ++t)
+	{
+		if(mTileEnergetic[t])
+			WakeTilesAround((t / mTileCols)*mTileSize, (t % mTileCols)*mTileSize);
+	}
+
+	// Queued impulses were just added to the new heights; keep their tiles from being
+	// flattened below.
+	for(const Impulse& p : mPendingImpulses)
+		WakeTilesAround(p.Row, p.Column);
+
+	// Tiles that went to sleep are flattened so that skipping them is exact from now on.
+	// mPrevSolution holds the published heights, so its half waits for the next step.
+	for(int t = 0; t < tileCount; ++t)
+	{
+		if(!mTileWasActive[t] || mTileActive[t])
+			continue;
+
+		int i0 = (t / mTileCols)*mTileSize;
+		int j0 = (t % mTileCols)*mTileSize;
+		int i1 = std::min(i0 + mTileSize, mNumRows);
+		int j1 = std::min(j0 + mTileSize, mNumCols);
+		for(int i = i0; i < i1; ++i)
+		{
+			std::fill(&mCurrSolution[i*mNumCols + j0], &mCurrSolution[i*mNumCols + j1], 0.0f);
+			std::fill(&mNormals[i*mNumCols + j0], &mNormals[i*mNumCols + j1], XMFLOAT3(0.0f, 1.0f, 0.0f));
+			std::fill(&mTangentX[i*mNumCols + j0], &mTangentX[i*mNumCols + j1], XMFLOAT3(1.0f, 0.0f, 0.0f));
+		}
+
+		mTileDirty[t] = 1;
+		mTilesToFlatten.push_back(t);
+	}
+}
+
+int Waves::BandRowCount()const
+{
+	if(mRowChunkSize > 0)
+		return mRowChunkSize;
+
+	// Enough bands to keep every thread busy; the two patched rows per band are cheap.
+	int bands = 4*(int)mScheduler->ThreadCount();
+	return std::max(8, (mNumRows - 2 + bands - 1) / bands);
 }
 
 void Waves::Disturb(int i, int j, float magnitude)
@@ -163,10 +845,28 @@ void Waves::Disturb(int i, int j, float magnitude)
 	float halfMag = 0.5f*magnitude;
 
 	// Disturb the ijth vertex height and its neighbors.
-	mCurrSolution[i*mNumCols+j].y     += magnitude;
-	mCurrSolution[i*mNumCols+j+1].y   += halfMag;
-	mCurrSolution[i*mNumCols+j-1].y   += halfMag;
-	mCurrSolution[(i+1)*mNumCols+j].y += halfMag;
-	mCurrSolution[(i-1)*mNumCols+j].y += halfMag;
+	mCurrSolution[i*mNumCols+j]     += magnitude;
+	mCurrSolution[i*mNumCols+j+1]   += halfMag;
+	mCurrSolution[i*mNumCols+j-1]   += halfMag;
+	mCurrSolution[(i+1)*mNumCols+j] += halfMag;
+	mCurrSolution[(i-1)*mNumCols+j] += halfMag;
+
+	WakeTilesAround(i, j);
 }
 	
+
+void Waves::DisturbBatch(const Impulse* impulses, size_t count)
+{
+	// The 5-point footprint has to stay off the fixed boundary.
+	if(mNumRows < 5 || mNumCols < 5)
+		return;
+
+	mPendingImpulses.reserve(mPendingImpulses.size() + count);
+	for(size_t k = 0; k < count; ++k)
+	{
+		Impulse p = impulses[k];
+		p.Row = std::min(std::max(p.Row, 2), mNumRows - 3);
+		p.Column = std::min(std::max(p.Column, 2), mNumCols - 3);
+		mPendingImpulses.push_back(p);
+	}
+}
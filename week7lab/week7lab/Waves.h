@@ -9,10 +9,13 @@
 #ifndef WAVES_H
 #define WAVES_H
 
+#include <atomic>
 #include <vector>
 #include <DirectXMath.h>
+#include "WaveSimulator.h"
+#include "WavesKernels.h"
 
-class Waves
+class Waves : public WaveSimulator
 {
 public:
     Waves(int m, int n, float dx, float dt, float speed, float damping);
@@ -20,24 +23,198 @@ public:
     Waves& operator=(const Waves& rhs) = delete;
     ~Waves();
 
-	int RowCount()const;
-	int ColumnCount()const;
-	int VertexCount()const;
-	int TriangleCount()const;
-	float Width()const;
-	float Depth()const;
+	int RowCount()const override;
+	int ColumnCount()const override;
+	int VertexCount()const override;
+	int TriangleCount()const override;
+	float Width()const override;
+	float Depth()const override;
+	float SpatialStep()const override { return mSpatialStep; }
 
-	// Returns the solution at the ith grid point.
-    const DirectX::XMFLOAT3& Position(int i)const { return mCurrSolution[i]; }
+	// Heights are not bounded by the simulation, so the bound is whatever the caller
+	// sets; x and z never move.
+	float MaxAmplitude()const override { return mMaxAmplitude; }
+	bool IsHeightField()const override { return true; }
+	void SetMaxAmplitude(float height) { mMaxAmplitude = height; }
+
+	// Returns the solution at the ith grid point.  Only the height is stored; the x and z
+	// coordinates are derived from the grid indices since they never change.
+    DirectX::XMFLOAT3 Position(int i)const override
+    {
+        int row = i / mNumCols;
+        int col = i - row*mNumCols;
+        return DirectX::XMFLOAT3(-mHalfWidth + col*mSpatialStep, mCurrSolution[i], mHalfDepth - row*mSpatialStep);
+    }
+
+	// Returns the solution height at the ith grid point.
+    float Height(int i)const override { return mCurrSolution[i]; }
+
+	// Returns the height at the ith grid point one time step earlier.
+    float PreviousHeight(int i)const { return mPrevSolution[i]; }
 
 	// Returns the solution normal at the ith grid point.
-    const DirectX::XMFLOAT3& Normal(int i)const { return mNormals[i]; }
+    const DirectX::XMFLOAT3& Normal(int i)const override { return mNormals[i]; }
 
 	// Returns the unit tangent vector at the ith grid point in the local x-axis direction.
     const DirectX::XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
 
-	void Update(float dt);
-	void Disturb(int i, int j, float magnitude);
+	// Samples the surface at count world-space (x, z) points, for buoyancy and other
+	// gameplay queries.  Heights are bilinear over the grid and points off the grid are
+	// clamped to its edge.  If normals is given it receives the normal of the bilinear
+	// patch under each point.  Only the heights of the last completed step are read,
+	// without the InterpolationAlpha blend.
+	//
+	// Each step publishes its heights when it finishes and never writes them while the
+	// next step runs, so this may be called from any thread while Update runs on
+	// another.  A call must not outlast two steps, and must not overlap Disturb,
+	// Simulate or LoadSnapshot.
+	void SampleHeights(const DirectX::XMFLOAT2* xz, float* heights, size_t count,
+		DirectX::XMFLOAT3* normals = nullptr)const;
+
+	// Writes the grid as VertexRecords straight into dst, which must hold VertexCount()
+	// records.  Heights are blended from PreviousHeight to Height by alpha.  If tileMask
+	// is given (one byte per tile, see DirtyTiles), only flagged tiles are written.  Rows
+	// are written in parallel with streaming stores, so dst can be mapped upload memory.
+	// Texture coordinates map [-w/2,w/2] --> [0,1] across the grid.
+	void WriteVertices(void* dst, size_t byteSize, float alpha, const unsigned char* tileMask = nullptr)const override;
+
+	// Height-only variant of WriteVertices: one float per vertex, in row-major order.
+	// The renderer rebuilds x, z, the normal and the texture coordinates from the
+	// vertex index and the neighbouring heights, so a quarter of a record is uploaded.
+	void WriteHeights(float* dst, size_t count, float alpha, const unsigned char* tileMask = nullptr)const override;
+
+	// Selects the stencil kernel.  Requests for an instruction set the CPU lacks fall
+	// back to the widest one it supports.  The widest is chosen by default.
+	void SetKernel(WaveKernels::Isa isa);
+	WaveKernels::Isa Kernel()const { return mKernel; }
+
+	// Rows are handed to the scheduler in chunks of this many rows; 0 lets the
+	// scheduler pick.  Defaults to TaskScheduler::Default() with automatic chunks.
+	void SetScheduler(TaskScheduler* scheduler)override;
+	void SetRowChunkSize(int rows);
+
+	// TwoPass sweeps the grid once for heights and again for normals.  Fused walks
+	// bands of rows and computes each row's normals right after the row below it has
+	// its new height, while the data is still in cache.  Both give identical results.
+	enum class UpdateMode
+	{
+		TwoPass,
+		Fused
+	};
+
+	void SetUpdateMode(UpdateMode mode) { mUpdateMode = mode; }
+	UpdateMode GetUpdateMode()const { return mUpdateMode; }
+
+	// The grid is split into TileSize x TileSize tiles.  Only active tiles are stepped
+	// and get new normals.  Disturbing a tile wakes it and its neighbours.  A tile
+	// falls asleep once its largest height and its largest per-step height change both
+	// drop below the sleep threshold; its heights are then flattened to zero.  With
+	// tracking disabled every tile is always active.
+	void SetActiveTileTracking(bool enable);
+	void SetSleepThreshold(float epsilon) { mSleepThreshold = epsilon; }
+
+	int TileSize()const { return mTileSize; }
+	int TileRowCount()const { return mTileRows; }
+	int TileColumnCount()const { return mTileCols; }
+	bool IsTileActive(int tileRow, int tileCol)const { return mTileActive[tileRow*mTileCols + tileCol] != 0; }
+
+	// Tiles whose vertices may have changed since the last ClearDirtyTiles, one byte
+	// per tile in row-major order.  Active tiles always count as dirty because the
+	// interpolated heights move every frame.
+	const std::vector<unsigned char>& DirtyTiles()const override { return mTileDirty; }
+	void ClearDirtyTiles()override;
+
+	// Advances the simulation by dt in fixed steps of the time step given at construction.
+	// Leftover time carries over to the next call.  At most MaxSubsteps steps run per call
+	// and any time beyond that is dropped, so a long hitch cannot snowball.  Returns the
+	// number of steps taken.
+	int Update(float dt)override;
+	void Disturb(int i, int j, float magnitude)override;
+
+	// A Disturb request: raises the (Row, Column) vertex by Magnitude and its four
+	// neighbours by half of it.
+	struct Impulse
+	{
+		int Row = 0;
+		int Column = 0;
+		float Magnitude = 0.0f;
+	};
+
+	// Queues impulses for the next step.  Unlike Disturb, points too close to the
+	// boundary are clamped into the interior rather than asserted on.  The queue is
+	// bucketed by row, and the stencil sweep adds each row's impulses right after it
+	// writes that row, before the row's normals are computed.  This gives the same
+	// heights as calling Disturb for each impulse in order right after the step.
+	void DisturbBatch(const Impulse* impulses, size_t count);
+
+	void SetMaxSubsteps(int steps);
+	int MaxSubsteps()const { return mMaxSubsteps; }
+
+	// When several steps are due at once, up to this many are advanced together one
+	// cache-sized tile at a time.  Each tile is copied out with a halo as wide as the
+	// number of steps, so it can be stepped on its own while it stays in cache, and the
+	// normals are only computed after the last step.  The heights are identical to
+	// stepping one at a time.  1 disables blocking.  Only used while active tile
+	// tracking is off, since tracking decides which tiles to skip after every step, and
+	// the step that applies queued DisturbBatch impulses always runs on its own.
+	void SetTemporalBlockSteps(int steps);
+	int TemporalBlockSteps()const { return mTemporalBlockSteps; }
+
+	// Advances exactly steps time steps, independent of the accumulator.  For
+	// settling the water before it is first shown.
+	void Simulate(int steps);
+
+	// Writes both height buffers, the simulation constants and the accumulator to a
+	// versioned binary file.  The heights sit at page-aligned offsets in the form they
+	// take in memory, so LoadSnapshot maps the file and copies them across without
+	// parsing.  Load fails, leaving the simulation untouched, unless the file was
+	// written by a grid of the same size and spacing with the same time step, speed
+	// and damping; the constants in the file are only checked, never adopted.
+	// Normals are rebuilt and every tile is woken after a load.
+	bool SaveSnapshot(const char* path)const;
+	bool LoadSnapshot(const char* path);
+
+	// Fraction of a time step that has accumulated but not been simulated yet, in [0, 1).
+	// Blending PreviousHeight toward Height by this amount gives smooth motion when the
+	// frame rate and the simulation rate differ.
+	float InterpolationAlpha()const override { return mAccumulator / mTimeStep; }
+
+private:
+	void Step();
+	void StepBlocked(int steps);
+	void BucketImpulses();
+	void FinishImpulses();
+	void FlattenSleptTiles();
+	void PublishHeights();
+	void StepTwoPass();
+	void StepFused();
+
+	// Advances the active interior cells of row i into mPrevSolution.
+	void StencilRow(int i);
+
+	// Adds the bucketed impulses of row i to the new heights in mPrevSolution.
+	void ImpulseRow(int i);
+
+	// Records the largest new height and change of row i in each active tile.
+	void ActivityRow(int i);
+
+	// Recomputes the active interior normals and tangents of row i from the heights h.
+	void NormalRow(const std::vector<float>& h, int i);
+	void NormalSpan(const std::vector<float>& h, int i, int j0, int j1);
+
+	// Recomputes the normals of every active row from mCurrSolution.
+	void NormalPass();
+
+	void WakeTilesAround(int i, int j);
+	void BuildTileRuns();
+	void UpdateTileActivity();
+
+	int BandRowCount()const;
+
+	// Calls fn(i, j0, j1) in parallel for every run of tiles flagged in tileMask
+	// (every tile when tileMask is null), one row span at a time.
+	template<typename Fn>
+	void ForEachFlaggedSpan(const unsigned char* tileMask, Fn fn)const;
 
 private:
     int mNumRows = 0;
@@ -53,11 +230,78 @@ private:
 
     float mTimeStep = 0.0f;
     float mSpatialStep = 0.0f;
+    float mAccumulator = 0.0f;
+    int mMaxSubsteps = 4;
+    int mTemporalBlockSteps = 4;
+    float mHalfWidth = 0.0f;
+    float mHalfDepth = 0.0f;
+    float mMaxAmplitude = 2.0f;
 
-    std::vector<DirectX::XMFLOAT3> mPrevSolution;
-    std::vector<DirectX::XMFLOAT3> mCurrSolution;
+    // Per-column x and texture u, per-row z and texture v, used to emit vertices.
+    std::vector<float> mVertexX;
+    std::vector<float> mVertexZ;
+    std::vector<float> mTexU;
+    std::vector<float> mTexV;
+
+    // Heights only, tightly packed so the stencil streams nothing but useful data.
+    std::vector<float> mPrevSolution;
+    std::vector<float> mCurrSolution;
     std::vector<DirectX::XMFLOAT3> mNormals;
     std::vector<DirectX::XMFLOAT3> mTangentX;
+
+    // Output heights of StepBlocked.  Tiles read the old buffers for their halos, so
+    // the results cannot be written in place; the pairs are swapped afterwards.
+    std::vector<float> mBlockPrev;
+    std::vector<float> mBlockCurr;
+
+    WaveKernels::Isa mKernel = WaveKernels::Isa::Scalar;
+    WaveKernels::StencilRowFn mStencilRow = nullptr;
+
+    TaskScheduler* mScheduler = nullptr;
+    int mRowChunkSize = 0;
+
+    UpdateMode mUpdateMode = UpdateMode::Fused;
+
+    // Impulses queued by DisturbBatch, and the scratch used to bucket them by row.
+    struct RowImpulse
+    {
+        int Column;
+        float Center;
+        float Side;
+    };
+
+    std::vector<Impulse> mPendingImpulses;
+    std::vector<int> mImpulseRowStart;
+    std::vector<int> mImpulseCursor;
+    std::vector<RowImpulse> mRowImpulses;
+
+    // Active tile bookkeeping.  mTileRuns holds [begin, end) column pairs of the active
+    // interior cells of each tile row, starting at mTileRunStart[tileRow].
+    int mTileSize = 32;
+    int mTileRows = 0;
+    int mTileCols = 0;
+    bool mTrackActiveTiles = true;
+    float mSleepThreshold = 1.0e-4f;
+    std::vector<unsigned char> mTileActive;
+    std::vector<unsigned char> mTileDirty;
+
+    // Largest new height and per-step change of each row within each tile, written by
+    // the stencil sweep for active tiles and reduced per tile by UpdateTileActivity.
+    std::vector<float> mRowTileHeight;
+    std::vector<float> mRowTileChange;
+
+    // Per-step scratch of UpdateTileActivity, kept to avoid allocating every step.
+    std::vector<unsigned char> mTileEnergetic;
+    std::vector<unsigned char> mTileWasActive;
+
+    // Tiles that fell asleep in the last step.  Their previous heights may still be
+    // read by SampleHeights, so they are zeroed at the start of the next step.
+    std::vector<int> mTilesToFlatten;
+
+    // Heights read by SampleHeights; always one of the two solution buffers.
+    std::atomic<const float*> mPublishedHeights;
+    std::vector<int> mTileRunStart;
+    std::vector<int> mTileRuns;
 };
 
 #endif // WAVES_H
\ No newline at end of file
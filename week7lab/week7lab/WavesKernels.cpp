@@ -0,0 +1,431 @@
+//***************************************************************************************
+// WavesKernels.cpp
+//***************************************************************************************
+
+#include "WavesKernels.h"
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define WAVES_X86 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#endif
+#else
+	#define WAVES_X86 0
+#endif
+
+// MSVC lets us use any intrinsic in any function; GCC and Clang need the wider
+// instruction set enabled per function so the rest of the file stays baseline.
+#if WAVES_X86 && (defined(__GNUC__) || defined(__clang__))
+	#define WAVES_TARGET_AVX __attribute__((target("avx")))
+#else
+	#define WAVES_TARGET_AVX
+#endif
+
+namespace WaveKernels
+{
+
+void StencilRowScalar(float* prev, const float* curr, const float* up, const float* down,
+	int count, float k1, float k2, float k3)
+{
+	for(int j = 0; j < count; ++j)
+	{
+		prev[j] = k1*prev[j] + k2*curr[j] + k3*(down[j] + up[j] + curr[j+1] + curr[j-1]);
+	}
+}
+
+static void EmitVertexRowScalar(float* dst, const float* prevH, const float* currH, const float* normals,
+	const float* x, float z, const float* u, float v, int count, float alpha)
+{
+	for(int j = 0; j < count; ++j, dst += 8, normals += 3)
+	{
+		dst[0] = x[j];
+		dst[1] = prevH[j] + alpha*(currH[j] - prevH[j]);
+		dst[2] = z;
+		dst[3] = normals[0];
+		dst[4] = normals[1];
+		dst[5] = normals[2];
+		dst[6] = u[j];
+		dst[7] = v;
+	}
+}
+
+static void SampleBilinearScalar(const float* h, int rows, int cols, float x0, float z0, float dx,
+	const float* xz, int count, float* heights, float* normals)
+{
+	const float invDx = 1.0f / dx;
+	const float maxX = (float)(cols - 1);
+	const float maxZ = (float)(rows - 1);
+
+	for(int k = 0; k < count; ++k)
+	{
+		float fx = (xz[2*k] - x0)*invDx;
+		float fz = (z0 - xz[2*k + 1])*invDx;
+		fx = fx < 0.0f ? 0.0f : (fx > maxX ? maxX : fx);
+		fz = fz < 0.0f ? 0.0f : (fz > maxZ ? maxZ : fz);
+
+		// The last cell is used for points on the far edge, with u or v equal to 1.
+		int j = (int)(fx < maxX - 1.0f ? fx : maxX - 1.0f);
+		int i = (int)(fz < maxZ - 1.0f ? fz : maxZ - 1.0f);
+		float u = fx - (float)j;
+		float v = fz - (float)i;
+
+		const float* row = h + i*cols + j;
+		float h00 = row[0];
+		float h10 = row[1];
+		float h01 = row[cols];
+		float h11 = row[cols + 1];
+
+		float top = h00 + u*(h10 - h00);
+		float bottom = h01 + u*(h11 - h01);
+		heights[k] = top + v*(bottom - top);
+
+		if(normals != nullptr)
+		{
+			// Scaled by dx: n = (-dh/du, dx, dh/dv), since v runs toward -z.
+			float du = (h10 - h00) + v*((h11 - h01) - (h10 - h00));
+			float dv = bottom - top;
+			float invLen = 1.0f / sqrtf(du*du + dx*dx + dv*dv);
+			normals[3*k + 0] = -du*invLen;
+			normals[3*k + 1] = dx*invLen;
+			normals[3*k + 2] = dv*invLen;
+		}
+	}
+}
+
+static void EmitHeightRowScalar(float* dst, const float* prevH, const float* currH, int count, float alpha)
+{
+	for(int j = 0; j < count; ++j)
+		dst[j] = prevH[j] + alpha*(currH[j] - prevH[j]);
+}
+
+#if WAVES_X86
+
+void EmitHeightRow(float* dst, const float* prevH, const float* currH, int count, float alpha)
+{
+	// Rows start at arbitrary float offsets, so peel up to three heights to align dst.
+	int head = (int)(((16 - ((size_t)dst & 15)) & 15) / sizeof(float));
+	if(((size_t)dst & 3) != 0 || head >= count)
+	{
+		EmitHeightRowScalar(dst, prevH, currH, count, alpha);
+		return;
+	}
+
+	EmitHeightRowScalar(dst, prevH, currH, head, alpha);
+
+	const __m128 A = _mm_set1_ps(alpha);
+	int j = head;
+	for(; j + 4 <= count; j += 4)
+	{
+		__m128 p = _mm_loadu_ps(prevH + j);
+		__m128 c = _mm_loadu_ps(currH + j);
+		_mm_stream_ps(dst + j, _mm_add_ps(p, _mm_mul_ps(A, _mm_sub_ps(c, p))));
+	}
+	_mm_sfence();
+
+	EmitHeightRowScalar(dst + j, prevH + j, currH + j, count - j, alpha);
+}
+
+void EmitVertexRow(float* dst, const float* prevH, const float* currH, const float* normals,
+	const float* x, float z, const float* u, float v, int count, float alpha)
+{
+	if(((size_t)dst & 15) != 0)
+	{
+		EmitVertexRowScalar(dst, prevH, currH, normals, x, z, u, v, count, alpha);
+		return;
+	}
+
+	for(int j = 0; j < count; ++j, dst += 8, normals += 3)
+	{
+		float y = prevH[j] + alpha*(currH[j] - prevH[j]);
+		_mm_stream_ps(dst, _mm_setr_ps(x[j], y, z, normals[0]));
+		_mm_stream_ps(dst + 4, _mm_setr_ps(normals[1], normals[2], u[j], v));
+	}
+
+	// Make the streamed vertices visible before the caller hands the buffer to the GPU.
+	_mm_sfence();
+}
+
+void StencilRowSSE2(float* prev, const float* curr, const float* up, const float* down,
+	int count, float k1, float k2, float k3)
+{
+	const __m128 K1 = _mm_set1_ps(k1);
+	const __m128 K2 = _mm_set1_ps(k2);
+	const __m128 K3 = _mm_set1_ps(k3);
+
+	// Two 4-wide lanes per iteration.  The adds are issued in the same order as the
+	// scalar kernel so the results match it exactly.
+	int j = 0;
+	for(; j + 8 <= count; j += 8)
+	{
+		__m128 s0 = _mm_add_ps(_mm_loadu_ps(down + j), _mm_loadu_ps(up + j));
+		__m128 s1 = _mm_add_ps(_mm_loadu_ps(down + j + 4), _mm_loadu_ps(up + j + 4));
+		s0 = _mm_add_ps(s0, _mm_loadu_ps(curr + j + 1));
+		s1 = _mm_add_ps(s1, _mm_loadu_ps(curr + j + 5));
+		s0 = _mm_add_ps(s0, _mm_loadu_ps(curr + j - 1));
+		s1 = _mm_add_ps(s1, _mm_loadu_ps(curr + j + 3));
+
+		__m128 r0 = _mm_add_ps(_mm_mul_ps(K1, _mm_loadu_ps(prev + j)), _mm_mul_ps(K2, _mm_loadu_ps(curr + j)));
+		__m128 r1 = _mm_add_ps(_mm_mul_ps(K1, _mm_loadu_ps(prev + j + 4)), _mm_mul_ps(K2, _mm_loadu_ps(curr + j + 4)));
+		r0 = _mm_add_ps(r0, _mm_mul_ps(K3, s0));
+		r1 = _mm_add_ps(r1, _mm_mul_ps(K3, s1));
+
+		_mm_storeu_ps(prev + j, r0);
+		_mm_storeu_ps(prev + j + 4, r1);
+	}
+
+	StencilRowScalar(prev + j, curr + j, up + j, down + j, count - j, k1, k2, k3);
+}
+
+WAVES_TARGET_AVX
+void StencilRowAVX(float* prev, const float* curr, const float* up, const float* down,
+	int count, float k1, float k2, float k3)
+{
+	const __m256 K1 = _mm256_set1_ps(k1);
+	const __m256 K2 = _mm256_set1_ps(k2);
+	const __m256 K3 = _mm256_set1_ps(k3);
+
+	// Multiplies and adds are kept separate (no FMA) so rounding matches the scalar kernel.
+	int j = 0;
+	for(; j + 8 <= count; j += 8)
+	{
+		__m256 s = _mm256_add_ps(_mm256_loadu_ps(down + j), _mm256_loadu_ps(up + j));
+		s = _mm256_add_ps(s, _mm256_loadu_ps(curr + j + 1));
+		s = _mm256_add_ps(s, _mm256_loadu_ps(curr + j - 1));
+
+		__m256 r = _mm256_add_ps(_mm256_mul_ps(K1, _mm256_loadu_ps(prev + j)), _mm256_mul_ps(K2, _mm256_loadu_ps(curr + j)));
+		r = _mm256_add_ps(r, _mm256_mul_ps(K3, s));
+
+		_mm256_storeu_ps(prev + j, r);
+	}
+
+	// Avoid the AVX-SSE transition penalty before dropping into the scalar tail.
+	_mm256_zeroupper();
+
+	StencilRowScalar(prev + j, curr + j, up + j, down + j, count - j, k1, k2, k3);
+}
+
+Isa DetectIsa()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+
+	// AVX also needs the OS to save the upper halves of the ymm registers.
+	if(avx && osxsave && (_xgetbv(0) & 0x6) == 0x6)
+		return Isa::AVX;
+
+	return sse2 ? Isa::SSE2 : Isa::Scalar;
+#else
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx"))
+		return Isa::AVX;
+
+	return __builtin_cpu_supports("sse2") ? Isa::SSE2 : Isa::Scalar;
+#endif
+}
+
+#else
+
+void EmitHeightRow(float* dst, const float* prevH, const float* currH, int count, float alpha)
+{
+	EmitHeightRowScalar(dst, prevH, currH, count, alpha);
+}
+
+void EmitVertexRow(float* dst, const float* prevH, const float* currH, const float* normals,
+	const float* x, float z, const float* u, float v, int count, float alpha)
+{
+	EmitVertexRowScalar(dst, prevH, currH, normals, x, z, u, v, count, alpha);
+}
+
+// No vector kernels on this architecture; both entry points forward to the scalar one.
+void StencilRowSSE2(float* prev, const float* curr, const float* up, const float* down,
+	int count, float k1, float k2, float k3)
+{
+	StencilRowScalar(prev, curr, up, down, count, k1, k2, k3);
+}
+
+void StencilRowAVX(float* prev, const float* curr, const float* up, const float* down,
+	int count, float k1, float k2, float k3)
+{
+	StencilRowScalar(prev, curr, up, down, count, k1, k2, k3);
+}
+
+Isa DetectIsa()
+{
+	return Isa::Scalar;
+}
+
+#endif // WAVES_X86
+
+#if WAVES_X86
+
+void SampleBilinear(const float* h, int rows, int cols, float x0, float z0, float dx,
+	const float* xz, int count, float* heights, float* normals)
+{
+	const __m128 X0 = _mm_set1_ps(x0);
+	const __m128 Z0 = _mm_set1_ps(z0);
+	const __m128 InvDx = _mm_set1_ps(1.0f / dx);
+	const __m128 Dx = _mm_set1_ps(dx);
+	const __m128 DxSq = _mm_set1_ps(dx*dx);
+	const __m128 Zero = _mm_setzero_ps();
+	const __m128 One = _mm_set1_ps(1.0f);
+	const __m128 MaxX = _mm_set1_ps((float)(cols - 1));
+	const __m128 MaxZ = _mm_set1_ps((float)(rows - 1));
+	const __m128 MaxCellX = _mm_set1_ps((float)(cols - 2));
+	const __m128 MaxCellZ = _mm_set1_ps((float)(rows - 2));
+
+	int k = 0;
+	for(; k + 4 <= count; k += 4)
+	{
+		// Split (x0 z0 x1 z1)(x2 z2 x3 z3) into x and z lanes.
+		__m128 a = _mm_loadu_ps(xz + 2*k);
+		__m128 b = _mm_loadu_ps(xz + 2*k + 4);
+		__m128 x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 z = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+
+		__m128 fx = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(x, X0), InvDx), Zero), MaxX);
+		__m128 fz = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(Z0, z), InvDx), Zero), MaxZ);
+		__m128i j = _mm_cvttps_epi32(_mm_min_ps(fx, MaxCellX));
+		__m128i i = _mm_cvttps_epi32(_mm_min_ps(fz, MaxCellZ));
+		__m128 u = _mm_sub_ps(fx, _mm_cvtepi32_ps(j));
+		__m128 v = _mm_sub_ps(fz, _mm_cvtepi32_ps(i));
+
+		// SSE2 has no gather; fetch the four corners of each cell by hand.
+		alignas(16) int ji[4];
+		alignas(16) int ii[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(ji), j);
+		_mm_store_si128(reinterpret_cast<__m128i*>(ii), i);
+
+		alignas(16) float c00[4], c10[4], c01[4], c11[4];
+		for(int l = 0; l < 4; ++l)
+		{
+			const float* row = h + ii[l]*cols + ji[l];
+			c00[l] = row[0];
+			c10[l] = row[1];
+			c01[l] = row[cols];
+			c11[l] = row[cols + 1];
+		}
+
+		__m128 h00 = _mm_load_ps(c00);
+		__m128 h10 = _mm_load_ps(c10);
+		__m128 h01 = _mm_load_ps(c01);
+		__m128 h11 = _mm_load_ps(c11);
+
+		__m128 topSlope = _mm_sub_ps(h10, h00);
+		__m128 bottomSlope = _mm_sub_ps(h11, h01);
+		__m128 top = _mm_add_ps(h00, _mm_mul_ps(u, topSlope));
+		__m128 bottom = _mm_add_ps(h01, _mm_mul_ps(u, bottomSlope));
+		__m128 dv = _mm_sub_ps(bottom, top);
+		_mm_storeu_ps(heights + k, _mm_add_ps(top, _mm_mul_ps(v, dv)));
+
+		if(normals != nullptr)
+		{
+			__m128 du = _mm_add_ps(topSlope, _mm_mul_ps(v, _mm_sub_ps(bottomSlope, topSlope)));
+			__m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(du, du), DxSq), _mm_mul_ps(dv, dv));
+			__m128 invLen = _mm_div_ps(One, _mm_sqrt_ps(lenSq));
+
+			alignas(16) float nx[4], ny[4], nz[4];
+			_mm_store_ps(nx, _mm_mul_ps(_mm_sub_ps(Zero, du), invLen));
+			_mm_store_ps(ny, _mm_mul_ps(Dx, invLen));
+			_mm_store_ps(nz, _mm_mul_ps(dv, invLen));
+			for(int l = 0; l < 4; ++l)
+			{
+				normals[3*(k + l) + 0] = nx[l];
+				normals[3*(k + l) + 1] = ny[l];
+				normals[3*(k + l) + 2] = nz[l];
+			}
+		}
+	}
+
+	SampleBilinearScalar(h, rows, cols, x0, z0, dx, xz + 2*k, count - k, heights + k,
+		normals != nullptr ? normals + 3*k : nullptr);
+}
+
+#else
+
+void SampleBilinear(const float* h, int rows, int cols, float x0, float z0, float dx,
+	const float* xz, int count, float* heights, float* normals)
+{
+	SampleBilinearScalar(h, rows, cols, x0, z0, dx, xz, count, heights, normals);
+}
+
+#endif // WAVES_X86
+
+static void RowActivityScalar(const float* newH, const float* oldH, int count, float& maxHeight, float& maxChange)
+{
+	for(int j = 0; j < count; ++j)
+	{
+		maxHeight = std::fmax(maxHeight, std::fabs(newH[j]));
+		maxChange = std::fmax(maxChange, std::fabs(newH[j] - oldH[j]));
+	}
+}
+
+#if WAVES_X86
+
+void RowActivity(const float* newH, const float* oldH, int count, float& maxHeight, float& maxChange)
+{
+	// Clearing the sign bit gives the absolute value.
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 h = _mm_set1_ps(maxHeight);
+	__m128 c = _mm_set1_ps(maxChange);
+
+	int j = 0;
+	for(; j + 4 <= count; j += 4)
+	{
+		__m128 n = _mm_loadu_ps(newH + j);
+		__m128 o = _mm_loadu_ps(oldH + j);
+		h = _mm_max_ps(h, _mm_and_ps(n, absMask));
+		c = _mm_max_ps(c, _mm_and_ps(_mm_sub_ps(n, o), absMask));
+	}
+
+	// Fold the four lanes.
+	h = _mm_max_ps(h, _mm_movehl_ps(h, h));
+	h = _mm_max_ss(h, _mm_shuffle_ps(h, h, 1));
+	c = _mm_max_ps(c, _mm_movehl_ps(c, c));
+	c = _mm_max_ss(c, _mm_shuffle_ps(c, c, 1));
+	maxHeight = _mm_cvtss_f32(h);
+	maxChange = _mm_cvtss_f32(c);
+
+	RowActivityScalar(newH + j, oldH + j, count - j, maxHeight, maxChange);
+}
+
+#else
+
+void RowActivity(const float* newH, const float* oldH, int count, float& maxHeight, float& maxChange)
+{
+	RowActivityScalar(newH, oldH, count, maxHeight, maxChange);
+}
+
+#endif // WAVES_X86
+
+StencilRowFn GetStencilRow(Isa isa)
+{
+	static const Isa supported = DetectIsa();
+	if((int)isa > (int)supported)
+		isa = supported;
+
+	switch(isa)
+	{
+	case Isa::AVX:  return StencilRowAVX;
+	case Isa::SSE2: return StencilRowSSE2;
+	default:        return StencilRowScalar;
+	}
+}
+
+const char* IsaName(Isa isa)
+{
+	switch(isa)
+	{
+	case Isa::AVX:  return "avx";
+	case Isa::SSE2: return "sse2";
+	default:        return "scalar";
+	}
+}
+
+}
@@ -0,0 +1,69 @@
+//***************************************************************************************
+// WavesKernels.h
+//
+// Row kernels for the wave simulation.  Each kernel evaluates the same 5-point stencil
+// with the same operation order, so every variant produces bit-identical heights.  The
+// widest variant supported by the CPU is picked at runtime.
+//***************************************************************************************
+
+#ifndef WAVESKERNELS_H
+#define WAVESKERNELS_H
+
+namespace WaveKernels
+{
+	enum class Isa : int
+	{
+		Scalar = 0,
+		SSE2,
+		AVX,
+		Count
+	};
+
+	// Advances count cells of one row in place:
+	//   prev[j] = k1*prev[j] + k2*curr[j] + k3*(down[j] + up[j] + curr[j+1] + curr[j-1])
+	// The pointers are offset to the first cell to update, so curr[-1] and curr[count]
+	// must be readable.
+	typedef void (*StencilRowFn)(float* prev, const float* curr, const float* up, const float* down,
+		int count, float k1, float k2, float k3);
+
+	void StencilRowScalar(float* prev, const float* curr, const float* up, const float* down,
+		int count, float k1, float k2, float k3);
+	void StencilRowSSE2(float* prev, const float* curr, const float* up, const float* down,
+		int count, float k1, float k2, float k3);
+	void StencilRowAVX(float* prev, const float* curr, const float* up, const float* down,
+		int count, float k1, float k2, float k3);
+
+	// Raises maxHeight to the largest |newH[j]| and maxChange to the largest
+	// |newH[j] - oldH[j]| of count cells.  Used to decide which tiles may sleep.
+	void RowActivity(const float* newH, const float* oldH, int count, float& maxHeight, float& maxChange);
+
+	// Writes count interleaved vertices of one row to dst, 8 floats each:
+	//   position (x[j], lerp(prevH[j], currH[j], alpha), z), normal[j], texcoord (u[j], v)
+	// normals holds 3 floats per vertex.  When dst is 16-byte aligned the vertices go
+	// out with non-temporal stores, which suits write-combined upload heaps.
+	void EmitVertexRow(float* dst, const float* prevH, const float* currH, const float* normals,
+		const float* x, float z, const float* u, float v, int count, float alpha);
+
+	// Writes count blended heights, lerp(prevH[j], currH[j], alpha), to dst.  Uses
+	// non-temporal stores once dst reaches 16-byte alignment.
+	void EmitHeightRow(float* dst, const float* prevH, const float* currH, int count, float alpha);
+
+	// Samples count points of a rows x cols height grid h with spacing dx.  Vertex (0, 0)
+	// sits at (x0, z0); x grows along a row and z shrinks down a column.  xz holds count
+	// (x, z) pairs; points off the grid are clamped to its edge.  Writes the bilinear
+	// height of each point to heights and, if normals is not null, the unit normal of
+	// the bilinear patch under it as 3 floats per point.  Four points are done at a time
+	// with SSE2.  rows and cols must be at least 2.
+	void SampleBilinear(const float* h, int rows, int cols, float x0, float z0, float dx,
+		const float* xz, int count, float* heights, float* normals);
+
+	// Returns the widest instruction set the CPU and OS support.
+	Isa DetectIsa();
+
+	// Returns the kernel for isa, falling back to the widest supported one below it.
+	StencilRowFn GetStencilRow(Isa isa);
+
+	const char* IsaName(Isa isa);
+}
+
+#endif // WAVESKERNELS_H
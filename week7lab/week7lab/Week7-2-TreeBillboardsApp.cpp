@@ -6,16 +6,29 @@
  *   Hold the left mouse button down and move the mouse to rotate.
  *   Hold the right mouse button down and move the mouse to zoom in and out.
  *
+ *   Command line:
+ *   -waves=scalar|simd|tracked|spectral picks the water engine (simd by default, so a
+ *   frame that owes several steps advances them together with temporal blocking).
+ *
  *  @author Hooman Salamat
  */
 
 #include "../Common/d3dApp.h"
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
+#include "../Common/StagingBuffer.h"
 #include "../Common/GeometryGenerator.h"
+#include "../Common/MeshOptimizer.h"
+#include "../Common/Meshlets.h"
+#include "../Common/MeshSimplifier.h"
+#include "../Common/MeshCache.h"
+#include "../Common/VertexPacker.h"
 #include "../Common/Camera.h"
 #include "FrameResource.h"
 #include "Waves.h"
+#include "WaveSimulator.h"
+#include <cstdio>
+#include <cstring>
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -62,10 +75,25 @@ struct RenderItem
     // Primitive topology.
     D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
-    // DrawIndexedInstanced parameters.
+    // Name of the Geo->DrawArgs entry the item draws, and its DrawIndexedInstanced
+    // parameters.  The name links the item to that submesh's meshlets and levels.
+    std::string Submesh;
     UINT IndexCount = 0;
     UINT StartIndexLocation = 0;
     int BaseVertexLocation = 0;
+
+	// Meshlets of the submesh drawn, if it was split into any.  Only the ranges of the
+	// meshlets that survive culling are drawn, relative to StartIndexLocation.
+	const std::vector<Meshlets::Meshlet>* Clusters = nullptr;
+
+	// Object-space sphere around all of Clusters.  Simplified levels only drop
+	// vertices, so it bounds every level in Lods too.
+	XMFLOAT3 ClustersCenter = { 0.0f, 0.0f, 0.0f };
+	float ClustersRadius = 0.0f;
+
+	// Simplified levels of the submesh, if it has any, relative to StartIndexLocation.
+	// Level 0 is the submesh itself.
+	const std::vector<MeshSimplifier::Lod>* Lods = nullptr;
 };
 
 enum class RenderLayer : int
@@ -80,7 +108,7 @@ enum class RenderLayer : int
 class TreeBillboardsApp : public D3DApp
 {
 public:
-    TreeBillboardsApp(HINSTANCE hInstance);
+    TreeBillboardsApp(HINSTANCE hInstance, WaveEngine waveEngine = WaveEngine::Simd);
     TreeBillboardsApp(const TreeBillboardsApp& rhs) = delete;
     TreeBillboardsApp& operator=(const TreeBillboardsApp& rhs) = delete;
     ~TreeBillboardsApp();
@@ -103,6 +131,7 @@ private:
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateWaves(const GameTimer& gt); 
+	void SettleWaves();
 
 	void LoadTextures();
     void BuildRootSignature();
@@ -111,12 +140,16 @@ private:
     void BuildLandGeometry();
     void BuildWavesGeometry();
 	void BuildBoxGeometry();
+	void GenerateBoxGeometry(std::vector<Vertex>& vertices, std::vector<std::uint16_t>& indices,
+		std::unordered_map<std::string, SubmeshGeometry>& drawArgs);
+	std::unique_ptr<MeshGeometry> CreateMeshGeometry(const std::string& name, const MeshCacheData& data);
 	void BuildTreeSpritesGeometry();
     void BuildPSOs();
     void BuildFrameResources();
     void BuildMaterials();
     void BuildRenderItems();
-    void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+    void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems, bool cullBackfaces = true);
+	void DrawWaves(ID3D12GraphicsCommandList* cmdList);
 
 	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
 
@@ -146,13 +179,38 @@ private:
 
     RenderItem* mWavesRitem = nullptr;
 
+	// Upload only the wave heights each frame and rebuild the rest of the water
+	// vertices in WaterHeights.hlsl, instead of uploading full Vertex records.  Only
+	// engines whose surface is a plain height field can be drawn this way.
+	bool mWavesHeightOnly = true;
+
+	// The water grid is drawn in square chunks of quads that share one 16-bit index
+	// pattern, so the grid size is not limited by the index format.  Each chunk is
+	// culled against the camera frustum on its own.
+	std::vector<SubmeshGeometry> mWavesChunks;
+
+	// Meshlets of the boxGeo shapes by draw-arg name, and the per-item scratch list of
+	// index ranges that survive culling.
+	std::unordered_map<std::string, std::vector<Meshlets::Meshlet>> mMeshlets;
+	std::vector<Meshlets::IndexRange> mVisibleRanges;
+
+	// Simplified levels of the boxGeo spheres and pillars by draw-arg name.  An item
+	// draws the coarsest level whose error covers at most mLodPixelError pixels.
+	std::unordered_map<std::string, std::vector<MeshSimplifier::Lod>> mLods;
+	float mLodPixelError = 1.0f;
+
+	// Finished landGeo and boxGeo buffers from earlier runs, keyed by the generator
+	// calls that produced them.
+	MeshCache mMeshCache{ "MeshCache" };
+
 	// List of all the render items.
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
-	std::unique_ptr<Waves> mWaves;
+	WaveEngine mWaveEngine = WaveEngine::Simd;
+	std::unique_ptr<WaveSimulator> mWaves;
 
     PassConstants mMainPassCB;
 
@@ -180,7 +238,18 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 
     try
     {
-        TreeBillboardsApp theApp(hInstance);
+        // -waves=<name> selects the water engine without a rebuild.
+        WaveEngine waveEngine = WaveEngine::Simd;
+        const char* wavesArg = strstr(cmdLine, "-waves=");
+        if(wavesArg != nullptr)
+        {
+            std::string name(wavesArg + strlen("-waves="));
+            name = name.substr(0, name.find(' '));
+            if(!ParseWaveEngine(name.c_str(), waveEngine))
+                OutputDebugStringA(("Unknown water engine '" + name + "', using simd.\n").c_str());
+        }
+
+        TreeBillboardsApp theApp(hInstance, waveEngine);
         if(!theApp.Initialize())
             return 0;
 
@@ -193,8 +262,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
     }
 }
 
-TreeBillboardsApp::TreeBillboardsApp(HINSTANCE hInstance)
-    : D3DApp(hInstance)
+TreeBillboardsApp::TreeBillboardsApp(HINSTANCE hInstance, WaveEngine waveEngine)
+    : D3DApp(hInstance), mWaveEngine(waveEngine)
 {
 }
 
@@ -216,7 +285,16 @@ bool TreeBillboardsApp::Initialize()
 	// so we have to query this information.
     mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
-    mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+    WaveSimulatorDesc wavesDesc;
+    wavesDesc.Rows = 128;
+    wavesDesc.Columns = 128;
+    wavesDesc.SpatialStep = 1.0f;
+    wavesDesc.TimeStep = 0.03f;
+    wavesDesc.Speed = 4.0f;
+    wavesDesc.Damping = 0.2f;
+    mWaves = CreateWaveSimulator(mWaveEngine, wavesDesc);
+    mWavesHeightOnly = mWavesHeightOnly && mWaves->IsHeightField();
+    SettleWaves();
  
 	LoadTextures();
     BuildRootSignature();
@@ -312,12 +390,15 @@ void TreeBillboardsApp::Draw(const GameTimer& gt)
 
     DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
 
+	// The alpha-tested pipeline draws both faces, so its meshlets are only frustum culled.
 	mCommandList->SetPipelineState(mPSOs["alphaTested"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::AlphaTested]);
+	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::AlphaTested], false);
 
 	mCommandList->SetPipelineState(mPSOs["treeSprites"].Get());
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::AlphaTestedTreeSprites]);
 
+	DrawWaves(mCommandList.Get());
+
 	mCommandList->SetPipelineState(mPSOs["transparent"].Get());
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Transparent]);
 
@@ -592,25 +673,73 @@ void TreeBillboardsApp::UpdateWaves(const GameTimer& gt)
 	// Update the wave simulation.
 	mWaves->Update(gt.DeltaTime());
 
-	// Update the wave vertex buffer with the new solution.
-	auto currWavesVB = mCurrFrameResource->WavesVB.get();
-	for(int i = 0; i < mWaves->VertexCount(); ++i)
+	// The simulation runs at a fixed rate; blend the last two steps so the water
+	// moves smoothly at any frame rate.
+	float alpha = mWaves->InterpolationAlpha();
+
+	// Each frame resource has its own copy of the wave vertices, so a tile that changed
+	// has to be rewritten in every one of them before it can be skipped again.  An
+	// engine without tiles reports none, and the whole surface is written every frame.
+	const auto& dirtyTiles = mWaves->DirtyTiles();
+	for(auto& frameResource : mFrameResources)
 	{
-		Vertex v;
+		auto& pending = frameResource->WavesPendingTiles;
+		if(pending.empty())
+			pending.assign(dirtyTiles.size(), 1);
 
-		v.Pos = mWaves->Position(i);
-		v.Normal = mWaves->Normal(i);
-		
-		// Derive tex-coords from position by 
-		// mapping [-w/2,w/2] --> [0,1]
-		v.TexC.x = 0.5f + v.Pos.x / mWaves->Width();
-		v.TexC.y = 0.5f - v.Pos.z / mWaves->Depth();
+		for(size_t t = 0; t < dirtyTiles.size(); ++t)
+			pending[t] |= dirtyTiles[t];
+	}
+	mWaves->ClearDirtyTiles();
+
+	// Update the wave vertex buffer with the new solution.  The simulation writes the
+	// vertices of the changed tiles straight into the mapped upload memory.
+	static_assert(sizeof(Vertex) == sizeof(WaveSimulator::VertexRecord), "Vertex must match the water vertex layout.");
 
-		currWavesVB->CopyData(i, v);
+	auto& pendingTiles = mCurrFrameResource->WavesPendingTiles;
+	const unsigned char* tileMask = pendingTiles.empty() ? nullptr : pendingTiles.data();
+	UINT waveVertCount = (UINT)mWaves->VertexCount();
+	if(mWavesHeightOnly)
+	{
+		// 4 bytes per vertex instead of 32; the vertex shader rebuilds the rest.
+		auto currHeightVB = mCurrFrameResource->WavesHeightVB.get();
+		mWaves->WriteHeights(currHeightVB->MapRange(0, waveVertCount), waveVertCount, alpha, tileMask);
 	}
+	else
+	{
+		auto currWavesVB = mCurrFrameResource->WavesVB.get();
+		mWaves->WriteVertices(currWavesVB->MapRange(0, waveVertCount), waveVertCount*sizeof(Vertex),
+			alpha, tileMask);
 
-	// Set the dynamic VB of the wave renderitem to the current frame VB.
-	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+		// Set the dynamic VB of the wave renderitem to the current frame VB.
+		mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+	}
+	std::fill(pendingTiles.begin(), pendingTiles.end(), (unsigned char)0);
+}
+
+void TreeBillboardsApp::SettleWaves()
+{
+	// The finite-difference grid starts flat.  Open with water that is already moving:
+	// restore it from the snapshot of an earlier run, or simulate ten seconds of the
+	// disturbances UpdateWaves makes and save the result for next time.
+	auto waves = dynamic_cast<Waves*>(mWaves.get());
+	if(waves == nullptr)
+		return;
+
+	const char* snapshotPath = "WavesSnapshot.bin";
+	if(waves->LoadSnapshot(snapshotPath))
+		return;
+
+	const int stepsPerDisturbance = 8;
+	for(int d = 0; d < 40; ++d)
+	{
+		int i = MathHelper::Rand(4, waves->RowCount() - 5);
+		int j = MathHelper::Rand(4, waves->ColumnCount() - 5);
+		waves->Disturb(i, j, MathHelper::RandF(0.2f, 0.5f));
+		waves->Simulate(stepsPerDisturbance);
+	}
+
+	waves->SaveSnapshot(snapshotPath);
 }
 
 void TreeBillboardsApp::LoadTextures()
@@ -708,7 +837,7 @@ void TreeBillboardsApp::BuildRootSignature()
 	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
 
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+    CD3DX12_ROOT_PARAMETER slotRootParameter[6];
 
 	// Perfomance TIP: Order from most frequent to least frequent.
 	slotRootParameter[0].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
@@ -716,10 +845,14 @@ void TreeBillboardsApp::BuildRootSignature()
     slotRootParameter[2].InitAsConstantBufferView(1);
     slotRootParameter[3].InitAsConstantBufferView(2);
 
+	// Height-only water: per-vertex heights (t1) and the grid layout (b3).
+	slotRootParameter[4].InitAsShaderResourceView(1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	slotRootParameter[5].InitAsConstants(4, 3, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+
 	auto staticSamplers = GetStaticSamplers();
 
     // A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(6, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -862,6 +995,8 @@ void TreeBillboardsApp::BuildShadersAndInputLayouts()
 	mShaders["treeSpriteGS"] = d3dUtil::CompileShader(L"Shaders\\TreeSprite.hlsl", nullptr, "GS", "gs_5_1");
 	mShaders["treeSpritePS"] = d3dUtil::CompileShader(L"Shaders\\TreeSprite.hlsl", alphaTestDefines, "PS", "ps_5_1");
 
+	mShaders["waterHeightsVS"] = d3dUtil::CompileShader(L"Shaders\\WaterHeights.hlsl", nullptr, "WaterVS", "vs_5_1");
+
     mStdInputLayout =
     {
         { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
@@ -876,54 +1011,243 @@ void TreeBillboardsApp::BuildShadersAndInputLayouts()
 	};
 }
 
-void TreeBillboardsApp::BuildLandGeometry()
+// Reports how much MeshOptimizer cut the vertex shader work of a generated mesh.
+static void LogMeshOptimization(const char* name, const MeshOptimizer::Report& report)
+{
+	char text[160];
+	snprintf(text, sizeof(text), "%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", name,
+		report.Before.Acmr, report.After.Acmr, report.Before.Atvr, report.After.Atvr);
+	OutputDebugStringA(text);
+}
+
+// Bump these when a change to the code behind a cached mesh changes its output; the
+// cache keys only cover the parameters hashed into them.
+static const std::uint32_t LandGeoRevision = 1;
+static const std::uint32_t BoxGeoRevision = 4;
+
+// The app's Vertex as packed from GeometryGenerator output; the tangent is dropped.
+using PackedVertex = VertexPacker::Layout<Vertex,
+	VertexPacker::Field<VertexPacker::Attribute::Position, offsetof(Vertex, Pos)>,
+	VertexPacker::Field<VertexPacker::Attribute::Normal, offsetof(Vertex, Normal)>,
+	VertexPacker::Field<VertexPacker::Attribute::TexC, offsetof(Vertex, TexC)>>;
+
+// One generator call behind a boxGeo shape.
+struct ShapeDesc
 {
-    GeometryGenerator geoGen;
-    GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f, 160.0f, 50, 50);
+	enum Kind { Box, Grid, Sphere, Cylinder };
 
-    //
-    // Extract the vertex elements we are interested and apply the height function to
-    // each vertex.  In addition, color the vertices based on their height so we have
-    // sandy looking beaches, grassy low hills, and snow mountain peaks.
-    //
+	const char* Name;
+	Kind Type;
 
-    std::vector<Vertex> vertices(grid.Vertices.size());
-    for(size_t i = 0; i < grid.Vertices.size(); ++i)
-    {
-        auto& p = grid.Vertices[i].Position;
-        vertices[i].Pos = p;
-        vertices[i].Pos.y = 1.1+ GetHillsHeight(p.x, p.z);
-        vertices[i].Normal = GetHillsNormal(p.x, p.z);
-		vertices[i].TexC = grid.Vertices[i].TexC;
-    }
+	// Box: width, height, depth.  Grid: width, depth.  Sphere: radius.
+	// Cylinder: bottom radius, top radius, height.
+	float Size[3];
 
-    const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+	// Box: subdivisions.  Grid: rows, columns.  Sphere and cylinder: slices, stacks.
+	UINT Tessellation[2];
+};
 
-    std::vector<std::uint16_t> indices = grid.GetIndices16();
-    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+// The boxGeo shapes, in the order they sit in its buffers.
+static const ShapeDesc BoxGeoShapes[] =
+{
+	{ "box", ShapeDesc::Box, { 1.0f, 1.0f, 1.0f }, { 3, 0 } },
+	{ "wall", ShapeDesc::Box, { 9.0f, 2.0f, 1.0f }, { 1, 0 } },
+	{ "grid", ShapeDesc::Grid, { 20.0f, 30.0f, 0.0f }, { 60, 40 } },
+	{ "sphere", ShapeDesc::Sphere, { 0.5f, 0.0f, 0.0f }, { 20, 20 } },
+	{ "wallPillar", ShapeDesc::Cylinder, { 1.0f, 1.0f, 3.0f }, { 4, 4 } },
+	{ "fountainPillar", ShapeDesc::Cylinder, { 1.0f, 1.0f, 3.0f }, { 8, 8 } },
+	{ "wallPillarTop", ShapeDesc::Cylinder, { 1.0f, 0.0f, 1.0f }, { 4, 5 } },
+	{ "fountainPillarTop", ShapeDesc::Cylinder, { 1.0f, 0.0f, 1.0f }, { 8, 1 } },
+	{ "centerFountain", ShapeDesc::Cylinder, { 2.0f, 0.0f, 1.0f }, { 4, 5 } },
+	{ "mazeWall", ShapeDesc::Box, { 1.0f, 5.0f, 0.5f }, { 1, 0 } },
+};
 
-	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "landGeo";
+static GeometryGenerator::MeshData CreateShape(GeometryGenerator& geoGen, const ShapeDesc& shape)
+{
+	switch(shape.Type)
+	{
+	case ShapeDesc::Box:
+		return geoGen.CreateBox(shape.Size[0], shape.Size[1], shape.Size[2], shape.Tessellation[0]);
+	case ShapeDesc::Grid:
+		return geoGen.CreateGrid(shape.Size[0], shape.Size[1], shape.Tessellation[0], shape.Tessellation[1]);
+	case ShapeDesc::Sphere:
+		return geoGen.CreateSphere(shape.Size[0], shape.Tessellation[0], shape.Tessellation[1]);
+	default:
+		return geoGen.CreateCylinder(shape.Size[0], shape.Size[1], shape.Size[2], shape.Tessellation[0], shape.Tessellation[1]);
+	}
+}
+
+static void AddToKey(MeshCacheKey& key, const MeshOptimizer::Options& options)
+{
+	key.Add(options.CacheSize).Add(options.Overdraw).Add(options.OverdrawThreshold);
+}
+
+static MeshCacheKey BoxGeoKey()
+{
+	MeshCacheKey key("boxGeo", BoxGeoRevision);
+	key.Add((std::uint32_t)sizeof(Vertex));
+
+	for(const ShapeDesc& shape : BoxGeoShapes)
+	{
+		key.Add(shape.Name).Add(shape.Type);
+		for(float size : shape.Size)
+			key.Add(size);
+		for(UINT tessellation : shape.Tessellation)
+			key.Add(tessellation);
+	}
+
+	// GenerateBoxGeometry runs every pass with its default settings.
+	AddToKey(key, MeshOptimizer::Options());
+	key.Add(Meshlets::MaxVertices).Add(Meshlets::MaxTriangles);
+
+	const MeshSimplifier::LodOptions lodOptions;
+	for(float ratio : lodOptions.Ratios)
+		key.Add(ratio);
+	key.Add(lodOptions.MaxError);
+	return key;
+}
+
+// Named arrays, such as the meshlets and levels of detail, kept with a cache entry.
+template<typename T>
+static void WriteNamedArrays(MeshCacheWriter& writer, const std::unordered_map<std::string, std::vector<T>>& arrays)
+{
+	writer.Write((std::uint32_t)arrays.size());
+	for(const auto& entry : arrays)
+	{
+		writer.WriteString(entry.first);
+		writer.WriteArray(entry.second);
+	}
+}
 
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+template<typename T>
+static bool ReadNamedArrays(MeshCacheReader& reader, std::unordered_map<std::string, std::vector<T>>& arrays)
+{
+	std::uint32_t count = 0;
+	reader.Read(count);
+	for(std::uint32_t i = 0; i < count && !reader.Failed(); ++i)
+	{
+		std::string name;
+		reader.ReadString(name);
+		reader.ReadArray(arrays[name]);
+	}
+	return !reader.Failed();
+}
+
+static void WriteDrawArgs(MeshCacheWriter& writer, const std::unordered_map<std::string, SubmeshGeometry>& drawArgs)
+{
+	writer.Write((std::uint32_t)drawArgs.size());
+	for(const auto& arg : drawArgs)
+	{
+		writer.WriteString(arg.first);
+		writer.Write(arg.second.IndexCount);
+		writer.Write(arg.second.StartIndexLocation);
+		writer.Write(arg.second.BaseVertexLocation);
+	}
+}
+
+static bool ReadDrawArgs(MeshCacheReader& reader, std::unordered_map<std::string, SubmeshGeometry>& drawArgs)
+{
+	std::uint32_t count = 0;
+	reader.Read(count);
+	for(std::uint32_t i = 0; i < count && !reader.Failed(); ++i)
+	{
+		std::string name;
+		reader.ReadString(name);
+
+		SubmeshGeometry& submesh = drawArgs[name];
+		reader.Read(submesh.IndexCount);
+		reader.Read(submesh.StartIndexLocation);
+		reader.Read(submesh.BaseVertexLocation);
+	}
+	return !reader.Failed();
+}
 
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+// Creates the default-heap buffers of a mesh from its finished vertices and indices,
+// whether they were just generated or mapped from the mesh cache.  Nothing reads the
+// geometry back on the CPU, so no system-memory copy is kept: each buffer is copied
+// once, into its upload heap.
+std::unique_ptr<MeshGeometry> TreeBillboardsApp::CreateMeshGeometry(const std::string& name, const MeshCacheData& data)
+{
+	const UINT vbByteSize = (UINT)data.VertexBytes;
+	const UINT ibByteSize = (UINT)data.IndexBytes;
+
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = name;
 
+	// CreateDefaultBuffer copies into its upload buffer before returning, so a mapped
+	// cache entry may be closed as soon as this returns.
 	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+		mCommandList.Get(), data.Vertices, vbByteSize, geo->VertexBufferUploader);
 
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+		mCommandList.Get(), data.Indices, ibByteSize, geo->IndexBufferUploader);
 
-	geo->VertexByteStride = sizeof(Vertex);
+	geo->VertexByteStride = data.VertexStride;
 	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+	geo->IndexFormat = data.IndexStride == sizeof(std::uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
+	return geo;
+}
+
+void TreeBillboardsApp::BuildLandGeometry()
+{
+	const float landWidth = 160.0f;
+	const float landDepth = 160.0f;
+	const UINT landRows = 50;
+	const UINT landColumns = 50;
+
+	// The hills are added below, after the grid is optimized, so its flat
+	// positions would give the overdraw sort nothing to work with.
+	MeshOptimizer::Options landOptions;
+	landOptions.Overdraw = false;
+
+	MeshCacheKey key("landGeo", LandGeoRevision);
+	key.Add((std::uint32_t)sizeof(Vertex)).Add(landWidth).Add(landDepth).Add(landRows).Add(landColumns);
+	AddToKey(key, landOptions);
+
+	MappedFile cached;
+	MeshCacheData data;
+	GeometryGenerator::MeshData grid;
+	std::vector<Vertex> vertices;
+	if(!mMeshCache.Load(key, cached, data) || data.VertexStride != sizeof(Vertex))
+	{
+		GeometryGenerator geoGen;
+		grid = geoGen.CreateGrid(landWidth, landDepth, landRows, landColumns);
+		LogMeshOptimization("landGeo", MeshOptimizer::Optimize(grid, landOptions));
+
+		//
+		// Extract the vertex elements we are interested and apply the height function to
+		// each vertex.  In addition, color the vertices based on their height so we have
+		// sandy looking beaches, grassy low hills, and snow mountain peaks.
+		//
+
+		vertices.resize(grid.Vertices.size());
+		PackedVertex::Pack(grid.Vertices.data(), grid.Vertices.size(), vertices.data(),
+			[this](const GeometryGenerator::Vertex& source, Vertex& vertex)
+		{
+			auto& p = source.Position;
+			vertex.Pos.y = 1.1+ GetHillsHeight(p.x, p.z);
+			vertex.Normal = GetHillsNormal(p.x, p.z);
+		});
+
+		// Upload straight from the mesh's own index buffer, at whatever width it chose.
+		GeometryGenerator::IndexView indices = grid.GetIndexView();
+
+		data = MeshCacheData();
+		data.Vertices = vertices.data();
+		data.VertexBytes = vertices.size() * sizeof(Vertex);
+		data.VertexStride = sizeof(Vertex);
+		data.Indices = indices.Data;
+		data.IndexBytes = indices.ByteSize();
+		data.IndexStride = (std::uint32_t)indices.Stride;
+		mMeshCache.Store(key, data);
+	}
+
+	auto geo = CreateMeshGeometry("landGeo", data);
+
 	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
+	submesh.IndexCount = (UINT)(data.IndexBytes / data.IndexStride);
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
 
@@ -934,31 +1258,84 @@ void TreeBillboardsApp::BuildLandGeometry()
 
 void TreeBillboardsApp::BuildWavesGeometry()
 {
-    std::vector<std::uint16_t> indices(3 * mWaves->TriangleCount()); // 3 indices per face
-	assert(mWaves->VertexCount() < 0x0000ffff);
-
-    // Iterate over each quad.
     int m = mWaves->RowCount();
     int n = mWaves->ColumnCount();
-    int k = 0;
-    for(int i = 0; i < m - 1; ++i)
-    {
-        for(int j = 0; j < n - 1; ++j)
-        {
-            indices[k] = i*n + j ;
-            indices[k + 1] = i*n + j + 1;
-            indices[k + 2] = (i + 1)*n + j;
 
-            indices[k + 3] = (i + 1)*n + j;
-            indices[k + 4] = i*n + j + 1;
-            indices[k + 5] = (i + 1)*n + j + 1;
+	// Chunks index their vertices relative to the chunk's top-left vertex with the grid's
+	// full row stride, so the largest local index is chunk*n + chunk.  Pick the largest
+	// chunk (up to 64 quads) whose local indices still fit in 16 bits.
+	int chunk = MathHelper::Min(64, 0xffff / (n + 1));
+	assert(chunk >= 1);
+
+	int quadRows = m - 1;
+	int quadCols = n - 1;
+	int lastCols = quadCols % chunk;
+
+	// One chunk x chunk pattern, plus a narrower one for the last chunk column when the
+	// grid does not divide evenly.  Quads are emitted row by row, so a shorter chunk in
+	// the last chunk row just draws a prefix of its pattern.  The patterns are written
+	// straight into the index buffer's upload heap, in order.
+	const UINT indexCount = 6 * chunk * (chunk + lastCols);
+	StagingBuffer indexStaging(md3dDevice.Get(), indexCount*sizeof(std::uint16_t));
+	std::uint16_t* indices = indexStaging.Elements<std::uint16_t>();
+	UINT k = 0;
 
-            k += 6; // next quad
-        }
-    }
+	auto appendPattern = [indices, &k, chunk, n](int cols)
+	{
+		for(int i = 0; i < chunk; ++i)
+		{
+			for(int j = 0; j < cols; ++j)
+			{
+				indices[k++] = (std::uint16_t)(i*n + j);
+				indices[k++] = (std::uint16_t)(i*n + j + 1);
+				indices[k++] = (std::uint16_t)((i + 1)*n + j);
+
+				indices[k++] = (std::uint16_t)((i + 1)*n + j);
+				indices[k++] = (std::uint16_t)(i*n + j + 1);
+				indices[k++] = (std::uint16_t)((i + 1)*n + j + 1);
+			}
+		}
+	};
+
+	appendPattern(chunk);
+	UINT narrowStart = k;
+	if(lastCols != 0)
+		appendPattern(lastCols);
+	assert(k == indexCount);
+
+	// Chunk bounds are built from the rest grid, as WaterHeights.hlsl rebuilds x and z.
+	// The height-only path draws the surface without horizontal displacement, so only
+	// the vertex path needs the sideways padding.
+	const float dx = mWaves->SpatialStep();
+	const float halfWidth = 0.5f*(n - 1)*dx;
+	const float halfDepth = 0.5f*(mWaves->RowCount() - 1)*dx;
+	const float maxAmplitude = mWaves->MaxAmplitude();
+	const float sidePadding = mWavesHeightOnly ? 0.0f : maxAmplitude;
+
+	mWavesChunks.clear();
+	for(int r0 = 0; r0 < quadRows; r0 += chunk)
+	{
+		for(int c0 = 0; c0 < quadCols; c0 += chunk)
+		{
+			int rows = MathHelper::Min(chunk, quadRows - r0);
+			int cols = MathHelper::Min(chunk, quadCols - c0);
+
+			SubmeshGeometry submesh;
+			submesh.IndexCount = 6 * rows * cols;
+			submesh.StartIndexLocation = (cols == chunk) ? 0 : narrowStart;
+			submesh.BaseVertexLocation = r0*n + c0;
+
+			float x0 = -halfWidth + c0*dx;
+			float z0 = halfDepth - r0*dx;
+			submesh.Bounds.Center = XMFLOAT3(x0 + 0.5f*cols*dx, 0.0f, z0 - 0.5f*rows*dx);
+			submesh.Bounds.Extents = XMFLOAT3(0.5f*cols*dx + sidePadding, maxAmplitude, 0.5f*rows*dx + sidePadding);
+
+			mWavesChunks.push_back(submesh);
+		}
+	}
 
 	UINT vbByteSize = mWaves->VertexCount()*sizeof(Vertex);
-	UINT ibByteSize = (UINT)indices.size()*sizeof(std::uint16_t);
+	UINT ibByteSize = indexCount*sizeof(std::uint16_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "waterGeo";
@@ -967,19 +1344,16 @@ void TreeBillboardsApp::BuildWavesGeometry()
 	geo->VertexBufferCPU = nullptr;
 	geo->VertexBufferGPU = nullptr;
 
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+	geo->IndexBufferGPU = indexStaging.Finish(mCommandList.Get(), geo->IndexBufferUploader);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
+	// The full-size pattern, for code that looks the water up by name.
 	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
+	submesh.IndexCount = 6 * chunk * chunk;
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
 
@@ -989,18 +1363,111 @@ void TreeBillboardsApp::BuildWavesGeometry()
 }
 
 void TreeBillboardsApp::BuildBoxGeometry()
+{
+	// Generating, optimizing, clustering and simplifying the shapes only has to happen
+	// once; later runs map the finished buffers and their draw metadata from the cache.
+	const MeshCacheKey key = BoxGeoKey();
+
+	std::unordered_map<std::string, SubmeshGeometry> drawArgs;
+	MappedFile cached;
+	MeshCacheData data;
+	bool loaded = mMeshCache.Load(key, cached, data) &&
+		data.VertexStride == sizeof(Vertex) && data.IndexStride == sizeof(std::uint16_t);
+	if(loaded)
+	{
+		MeshCacheReader reader(data.Extra, data.ExtraBytes);
+		loaded = ReadDrawArgs(reader, drawArgs) && ReadNamedArrays(reader, mMeshlets) &&
+			ReadNamedArrays(reader, mLods) && reader.AtEnd();
+	}
+
+	std::vector<Vertex> vertices;
+	std::vector<std::uint16_t> indices;
+	MeshCacheWriter metadata;
+	if(!loaded)
+	{
+		drawArgs.clear();
+		mMeshlets.clear();
+		mLods.clear();
+		GenerateBoxGeometry(vertices, indices, drawArgs);
+
+		WriteDrawArgs(metadata, drawArgs);
+		WriteNamedArrays(metadata, mMeshlets);
+		WriteNamedArrays(metadata, mLods);
+
+		data = MeshCacheData();
+		data.Vertices = vertices.data();
+		data.VertexBytes = vertices.size() * sizeof(Vertex);
+		data.VertexStride = sizeof(Vertex);
+		data.Indices = indices.data();
+		data.IndexBytes = indices.size() * sizeof(std::uint16_t);
+		data.IndexStride = sizeof(std::uint16_t);
+		data.Extra = metadata.Bytes().data();
+		data.ExtraBytes = metadata.Bytes().size();
+		mMeshCache.Store(key, data);
+	}
+
+	auto geo = CreateMeshGeometry("boxGeo", data);
+	geo->DrawArgs = std::move(drawArgs);
+
+	mGeometries["boxGeo"] = std::move(geo);
+}
+
+// Builds the boxGeo buffers and draw args from BoxGeoShapes, filling in mMeshlets and
+// mLods on the way.
+void TreeBillboardsApp::GenerateBoxGeometry(std::vector<Vertex>& vertices, std::vector<std::uint16_t>& indices,
+	std::unordered_map<std::string, SubmeshGeometry>& drawArgs)
 {
 	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData box = geoGen.CreateBox(1.0f, 1.0f, 1.0f, 3);
-	GeometryGenerator::MeshData wall = geoGen.CreateBox(9.0f, 2.0f, 1.0f, 1);
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f, 30.0f, 60, 40);
-	GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
-	GeometryGenerator::MeshData wallPillar = geoGen.CreateCylinder(1.0f, 1.0f, 3.0f, 4, 4);
-	GeometryGenerator::MeshData fountainPillar = geoGen.CreateCylinder(1.0f, 1.0f, 3.0f, 8, 8);
-	GeometryGenerator::MeshData wallPillarTop = geoGen.CreateCylinder(1.0f, 0.0f, 1.0f, 4, 5);
-	GeometryGenerator::MeshData fountainPillarTop = geoGen.CreateCylinder(1.0f, 0.0f, 1.0f, 8, 1);
-	GeometryGenerator::MeshData centerFountain = geoGen.CreateCylinder(2.0f, 0.0f, 1.0f, 4, 5);
-	GeometryGenerator::MeshData mazeWall = geoGen.CreateBox(1.0f, 5.0f, 0.5f, 1.0f);
+	GeometryGenerator::MeshData meshes[_countof(BoxGeoShapes)];
+	for(size_t i = 0; i < _countof(BoxGeoShapes); ++i)
+		meshes[i] = CreateShape(geoGen, BoxGeoShapes[i]);
+
+	GeometryGenerator::MeshData& box = meshes[0];
+	GeometryGenerator::MeshData& wall = meshes[1];
+	GeometryGenerator::MeshData& grid = meshes[2];
+	GeometryGenerator::MeshData& sphere = meshes[3];
+	GeometryGenerator::MeshData& wallPillar = meshes[4];
+	GeometryGenerator::MeshData& fountainPillar = meshes[5];
+	GeometryGenerator::MeshData& wallPillarTop = meshes[6];
+	GeometryGenerator::MeshData& fountainPillarTop = meshes[7];
+	GeometryGenerator::MeshData& centerFountain = meshes[8];
+	GeometryGenerator::MeshData& mazeWall = meshes[9];
+
+	// Split every shape into meshlets; this reorders its indices, so it has to happen
+	// before they are copied into the shared buffer.  Building regroups the triangles
+	// of the optimized order, so each meshlet is then sorted for the vertex cache again;
+	// that keeps every meshlet's range where it is.
+	const MeshOptimizer::Options optimizeOptions;
+	for(size_t i = 0; i < _countof(BoxGeoShapes); ++i)
+	{
+		GeometryGenerator::MeshData& mesh = meshes[i];
+		MeshOptimizer::Report report = MeshOptimizer::Optimize(mesh, optimizeOptions);
+
+		const std::vector<Meshlets::Meshlet>& meshlets = mMeshlets[BoxGeoShapes[i].Name] = Meshlets::Build(mesh);
+		mesh.VisitIndices([&](auto* indices)
+		{
+			for(const Meshlets::Meshlet& meshlet : meshlets)
+			{
+				MeshOptimizer::OptimizeVertexCache(indices + meshlet.IndexStart, meshlet.IndexCount,
+					mesh.Vertices.size(), optimizeOptions.CacheSize);
+			}
+
+			report.After = MeshOptimizer::AnalyzeVertexCache(indices, mesh.IndexCount(),
+				mesh.Vertices.size(), optimizeOptions.CacheSize);
+		});
+		LogMeshOptimization(BoxGeoShapes[i].Name, report);
+	}
+
+	// The simplified levels go after each shape's own triangles, so the meshlet ranges
+	// above still index level 0.
+	const std::pair<const char*, GeometryGenerator::MeshData*> lodShapes[] =
+	{
+		{ "sphere", &sphere }, { "wallPillar", &wallPillar }, { "fountainPillar", &fountainPillar },
+		{ "wallPillarTop", &wallPillarTop }, { "fountainPillarTop", &fountainPillarTop },
+		{ "centerFountain", &centerFountain },
+	};
+	for(const auto& shape : lodShapes)
+		mLods[shape.first] = MeshSimplifier::BuildLodChain(*shape.second);
 
 	// if things dont work, add the offset stuff here
 	UINT boxVertexOffset = 0;
@@ -1014,14 +1481,14 @@ void TreeBillboardsApp::BuildBoxGeometry()
 	UINT centerFountainVertexOffset = fountainPillarTopVertexOffset + (UINT)fountainPillarTop.Vertices.size();
 
 	UINT boxIndexOffset = 0;
-	UINT wallIndexOffset = (UINT)box.Indices32.size();
-	UINT gridIndexOffset = wallIndexOffset + (UINT)wall.Indices32.size();
-	UINT sphereIndexOffset = gridIndexOffset + (UINT)grid.Indices32.size();
-	UINT wallPillarIndexOffset = sphereIndexOffset + (UINT)sphere.Indices32.size();
-	UINT fountainPillarIndexOffset = wallPillarIndexOffset + (UINT)wallPillar.Indices32.size();
-	UINT wallPillarTopIndexOffset = fountainPillarIndexOffset + (UINT)fountainPillar.Indices32.size();
-	UINT fountainPillarTopIndexOffset = wallPillarTopIndexOffset + (UINT)wallPillarTop.Indices32.size();
-	UINT centerFountainIndexOffset = fountainPillarTopIndexOffset + (UINT)fountainPillarTop.Indices32.size();
+	UINT wallIndexOffset = (UINT)box.IndexCount();
+	UINT gridIndexOffset = wallIndexOffset + (UINT)wall.IndexCount();
+	UINT sphereIndexOffset = gridIndexOffset + (UINT)grid.IndexCount();
+	UINT wallPillarIndexOffset = sphereIndexOffset + (UINT)sphere.IndexCount();
+	UINT fountainPillarIndexOffset = wallPillarIndexOffset + (UINT)wallPillar.IndexCount();
+	UINT wallPillarTopIndexOffset = fountainPillarIndexOffset + (UINT)fountainPillar.IndexCount();
+	UINT fountainPillarTopIndexOffset = wallPillarTopIndexOffset + (UINT)wallPillarTop.IndexCount();
+	UINT centerFountainIndexOffset = fountainPillarTopIndexOffset + (UINT)fountainPillarTop.IndexCount();
 
 	auto totalVertexCount =
 		box.Vertices.size() +
@@ -1035,185 +1502,93 @@ void TreeBillboardsApp::BuildBoxGeometry()
 		centerFountain.Vertices.size() +
 		mazeWall.Vertices.size();
 
-	std::vector<Vertex> vertices(totalVertexCount);
-
-	UINT k = 0;
-
-	// if things dont work, change the each for loop auto p into auto x, y, z etc.
-
-	for (size_t i = 0; i < box.Vertices.size(); ++i, ++k)
-	{
-		auto& p = box.Vertices[i].Position;
-		vertices[k].Pos = p;
-		vertices[k].Normal = box.Vertices[i].Normal;
-		vertices[k].TexC = box.Vertices[i].TexC;
-	}
-
-	for (size_t i = 0; i < wall.Vertices.size(); ++i, ++k)
-	{
-		auto& p = wall.Vertices[i].Position;
-		vertices[k].Pos = p;
-		vertices[k].Normal = wall.Vertices[i].Normal;
-		vertices[k].TexC = box.Vertices[i].TexC;
-	}
-
-	for (size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
-	{
-		auto& p = grid.Vertices[i].Position;
-		vertices[k].Pos = p;
-		vertices[k].Normal = grid.Vertices[i].Normal;
-		vertices[k].TexC = grid.Vertices[i].TexC;
-	}
-
-	for (size_t i = 0; i < sphere.Vertices.size(); ++i, ++k)
-	{
-		auto& p = sphere.Vertices[i].Position;
-		vertices[k].Pos = p;
-		vertices[k].Normal = sphere.Vertices[i].Normal;
-		vertices[k].TexC = sphere.Vertices[i].TexC;
-	}
-
-	for (size_t i = 0; i < wallPillar.Vertices.size(); ++i, ++k)
-	{
-		auto& p = wallPillar.Vertices[i].Position;
-		vertices[k].Pos = p;
-		vertices[k].Normal = wallPillar.Vertices[i].Normal;
-		vertices[k].TexC = wallPillar.Vertices[i].TexC;
-	}
-
-	for (size_t i = 0; i < fountainPillar.Vertices.size(); ++i, ++k)
-	{
-		auto& p = fountainPillar.Vertices[i].Position;
-		vertices[k].Pos = p;
-		vertices[k].Normal = fountainPillar.Vertices[i].Normal;
-		vertices[k].TexC = fountainPillar.Vertices[i].TexC;
-	}
-
-	for (size_t i = 0; i < wallPillarTop.Vertices.size(); ++i, ++k)
-	{
-		auto& p = wallPillarTop.Vertices[i].Position;
-		vertices[k].Pos = p;
-		vertices[k].Normal = wallPillarTop.Vertices[i].Normal;
-		vertices[k].TexC = wallPillarTop.Vertices[i].TexC;
-	}
+	vertices.resize(totalVertexCount);
 
-	for (size_t i = 0; i < fountainPillarTop.Vertices.size(); ++i, ++k)
+	Vertex* packed = vertices.data();
+	for(const GeometryGenerator::MeshData& mesh : meshes)
 	{
-		auto& p = fountainPillarTop.Vertices[i].Position;
-		vertices[k].Pos = p;
-		vertices[k].Normal = fountainPillarTop.Vertices[i].Normal;
-		vertices[k].TexC = fountainPillarTop.Vertices[i].TexC;
+		PackedVertex::Pack(mesh.Vertices.data(), mesh.Vertices.size(), packed);
+		packed += mesh.Vertices.size();
 	}
 
-	for (size_t i = 0; i < centerFountain.Vertices.size(); ++i, ++k)
+	// The shared buffer is 16-bit; every shape here is small enough to have chosen
+	// that width for its own indices.
+	indices.clear();
+	for(const GeometryGenerator::MeshData& mesh : meshes)
 	{
-		auto& p = centerFountain.Vertices[i].Position;
-		vertices[k].Pos = p;
-		vertices[k].Normal = centerFountain.Vertices[i].Normal;
-		vertices[k].TexC = centerFountain.Vertices[i].TexC;
+		const std::uint16_t* shapeIndices = mesh.Indices16();
+		assert(shapeIndices != nullptr);
+		indices.insert(indices.end(), shapeIndices, shapeIndices + mesh.IndexCount());
 	}
 
-	for (size_t i = 0; i < mazeWall.Vertices.size(); ++i, ++k)
-	{
-		auto& p = mazeWall.Vertices[i].Position;
-		vertices[k].Pos = p;
-		vertices[k].Normal = mazeWall.Vertices[i].Normal;
-		vertices[k].TexC = mazeWall.Vertices[i].TexC;
-	}
-
-	std::vector<std::uint16_t> indices;
-	indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
-	indices.insert(indices.end(), std::begin(wall.GetIndices16()), std::end(wall.GetIndices16()));
-	indices.insert(indices.end(), std::begin(grid.GetIndices16()), std::end(grid.GetIndices16()));
-	indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
-	indices.insert(indices.end(), std::begin(wallPillar.GetIndices16()), std::end(wallPillar.GetIndices16()));
-	indices.insert(indices.end(), std::begin(fountainPillar.GetIndices16()), std::end(fountainPillar.GetIndices16()));
-	indices.insert(indices.end(), std::begin(wallPillarTop.GetIndices16()), std::end(wallPillarTop.GetIndices16()));
-	indices.insert(indices.end(), std::begin(fountainPillarTop.GetIndices16()), std::end(fountainPillarTop.GetIndices16()));
-	indices.insert(indices.end(), std::begin(centerFountain.GetIndices16()), std::end(centerFountain.GetIndices16()));
-	indices.insert(indices.end(), std::begin(mazeWall.GetIndices16()), std::end(mazeWall.GetIndices16()));
-
-
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
-
-	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "boxGeo";
-
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
-	geo->VertexByteStride = sizeof(Vertex);
-	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
-	geo->IndexBufferByteSize = ibByteSize;
-
 	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)box.Indices32.size();
+	submesh.IndexCount = (UINT)box.IndexCount();
 	submesh.StartIndexLocation = boxIndexOffset;
 	submesh.BaseVertexLocation = boxVertexOffset;
 
 	SubmeshGeometry wallSubmesh;
-	wallSubmesh.IndexCount = (UINT)wall.Indices32.size();
+	wallSubmesh.IndexCount = (UINT)wall.IndexCount();
 	wallSubmesh.StartIndexLocation = wallIndexOffset;
 	wallSubmesh.BaseVertexLocation = wallVertexOffset;
 
 	SubmeshGeometry gridSubmesh;
-	gridSubmesh.IndexCount = (UINT)grid.Indices32.size();
+	gridSubmesh.IndexCount = (UINT)grid.IndexCount();
 	gridSubmesh.StartIndexLocation = gridIndexOffset;
 	gridSubmesh.BaseVertexLocation = gridVertexOffset;
 
 	SubmeshGeometry sphereSubmesh;
-	sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
+	sphereSubmesh.IndexCount = mLods["sphere"][0].IndexCount;
 	sphereSubmesh.StartIndexLocation = sphereIndexOffset;
 	sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
 
 	SubmeshGeometry wallPillarSubmesh;
-	wallPillarSubmesh.IndexCount = (UINT)wallPillar.Indices32.size();
+	wallPillarSubmesh.IndexCount = mLods["wallPillar"][0].IndexCount;
 	wallPillarSubmesh.StartIndexLocation = wallPillarIndexOffset;
 	wallPillarSubmesh.BaseVertexLocation = wallPillarVertexOffset;
 
 	SubmeshGeometry fountainPillarSubmesh;
-	fountainPillarSubmesh.IndexCount = (UINT)wall.Indices32.size();
+	fountainPillarSubmesh.IndexCount = mLods["fountainPillar"][0].IndexCount;
 	fountainPillarSubmesh.StartIndexLocation = fountainPillarIndexOffset;
 	fountainPillarSubmesh.BaseVertexLocation = fountainPillarVertexOffset;
 
 	SubmeshGeometry wallPillarTopSubmesh;
-	wallPillarTopSubmesh.IndexCount = (UINT)wall.Indices32.size();
+	wallPillarTopSubmesh.IndexCount = mLods["wallPillarTop"][0].IndexCount;
 	wallPillarTopSubmesh.StartIndexLocation = wallPillarTopIndexOffset;
 	wallPillarTopSubmesh.BaseVertexLocation = wallPillarTopVertexOffset;
 
 	SubmeshGeometry fountainPillarTopSubmesh;
-	fountainPillarTopSubmesh.IndexCount = (UINT)wall.Indices32.size();
+	fountainPillarTopSubmesh.IndexCount = mLods["fountainPillarTop"][0].IndexCount;
 	fountainPillarTopSubmesh.StartIndexLocation = fountainPillarTopIndexOffset;
 	fountainPillarTopSubmesh.BaseVertexLocation = fountainPillarTopVertexOffset;
 
 	SubmeshGeometry centerFountainSubmesh;
-	centerFountainSubmesh.IndexCount = (UINT)wall.Indices32.size();
+	centerFountainSubmesh.IndexCount = mLods["centerFountain"][0].IndexCount;
 	centerFountainSubmesh.StartIndexLocation = centerFountainIndexOffset;
 	centerFountainSubmesh.BaseVertexLocation = centerFountainVertexOffset;
 
-	geo->DrawArgs["box"] = submesh;
-	geo->DrawArgs["wall"] = wallSubmesh;
-	geo->DrawArgs["grid"] = gridSubmesh;
-	geo->DrawArgs["sphere"] = sphereSubmesh;
-	geo->DrawArgs["wallPillar"] = wallPillarSubmesh;
-	geo->DrawArgs["fountainPillar"] = fountainPillarSubmesh;
-	geo->DrawArgs["wallPillarTop"] = wallPillarTopSubmesh;
-	geo->DrawArgs["fountainPillarTop"] = fountainPillarTopSubmesh;
-	geo->DrawArgs["centerFountain"] = centerFountainSubmesh;
-
-	mGeometries["boxGeo"] = std::move(geo);
+	drawArgs["box"] = submesh;
+	drawArgs["wall"] = wallSubmesh;
+	drawArgs["grid"] = gridSubmesh;
+	drawArgs["sphere"] = sphereSubmesh;
+	drawArgs["wallPillar"] = wallPillarSubmesh;
+	drawArgs["fountainPillar"] = fountainPillarSubmesh;
+	drawArgs["wallPillarTop"] = wallPillarTopSubmesh;
+	drawArgs["fountainPillarTop"] = fountainPillarTopSubmesh;
+	drawArgs["centerFountain"] = centerFountainSubmesh;
+
+	// One draw arg per simplified level, named "<shape>Lod<level>".
+	for(const auto& lods : mLods)
+	{
+		const SubmeshGeometry lod0 = drawArgs[lods.first];
+		for(size_t i = 1; i < lods.second.size(); ++i)
+		{
+			SubmeshGeometry lodSubmesh;
+			lodSubmesh.IndexCount = lods.second[i].IndexCount;
+			lodSubmesh.StartIndexLocation = lod0.StartIndexLocation + lods.second[i].IndexStart;
+			lodSubmesh.BaseVertexLocation = lod0.BaseVertexLocation;
+			drawArgs[lods.first + std::string("Lod") + std::to_string(i)] = lodSubmesh;
+		}
+	}
 }
 
 void TreeBillboardsApp::BuildTreeSpritesGeometry()
@@ -1282,12 +1657,6 @@ void TreeBillboardsApp::BuildTreeSpritesGeometry()
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "treeSpritesGeo";
 
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
 	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
@@ -1369,6 +1738,18 @@ void TreeBillboardsApp::BuildPSOs()
 	transparentPsoDesc.BlendState.RenderTarget[0] = transparencyBlendDesc;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&transparentPsoDesc, IID_PPV_ARGS(&mPSOs["transparent"])));
 
+	//
+	// PSO for the height-only water; the vertex shader fetches its own data.
+	//
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC waterHeightsPsoDesc = transparentPsoDesc;
+	waterHeightsPsoDesc.InputLayout = { nullptr, 0 };
+	waterHeightsPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["waterHeightsVS"]->GetBufferPointer()),
+		mShaders["waterHeightsVS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&waterHeightsPsoDesc, IID_PPV_ARGS(&mPSOs["waterHeights"])));
+
 	//
 	// PSO for alpha tested objects
 	//
@@ -1414,7 +1795,7 @@ void TreeBillboardsApp::BuildFrameResources()
     for(int i = 0; i < gNumFrameResources; ++i)
     {
         mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-            1, (UINT)mAllRitems.size(), (UINT)mMaterials.size(), mWaves->VertexCount()));
+            1, (UINT)mAllRitems.size(), (UINT)mMaterials.size(), mWaves->VertexCount(), mWavesHeightOnly));
     }
 }
 
@@ -1532,13 +1913,14 @@ void TreeBillboardsApp::BuildRenderItems()
 	wavesRitem->Mat = mMaterials["water"].get();
 	wavesRitem->Geo = mGeometries["waterGeo"].get();
 	wavesRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	wavesRitem->Submesh = "grid";
 	wavesRitem->IndexCount = wavesRitem->Geo->DrawArgs["grid"].IndexCount;
 	wavesRitem->StartIndexLocation = wavesRitem->Geo->DrawArgs["grid"].StartIndexLocation;
 	wavesRitem->BaseVertexLocation = wavesRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
 
     mWavesRitem = wavesRitem.get();
 
-	mRitemLayer[(int)RenderLayer::Transparent].push_back(wavesRitem.get());
+	// Drawn chunk by chunk in DrawWaves rather than through a render layer.
 
     auto gridRitem = std::make_unique<RenderItem>();
     gridRitem->World = MathHelper::Identity4x4();
@@ -1547,6 +1929,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	gridRitem->Mat = mMaterials["grass"].get();
 	gridRitem->Geo = mGeometries["landGeo"].get();
 	gridRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+    gridRitem->Submesh = "grid";
     gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
     gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
     gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
@@ -1560,6 +1943,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	centerFountainRitem->Mat = mMaterials["stone"].get();
 	centerFountainRitem->Geo = mGeometries["boxGeo"].get();
 	centerFountainRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	centerFountainRitem->Submesh = "centerFountain";
 	centerFountainRitem->IndexCount = centerFountainRitem->Geo->DrawArgs["centerFountain"].IndexCount;
 	centerFountainRitem->StartIndexLocation = centerFountainRitem->Geo->DrawArgs["centerFountain"].StartIndexLocation;
 	centerFountainRitem->BaseVertexLocation = centerFountainRitem->Geo->DrawArgs["centerFountain"].BaseVertexLocation;
@@ -1574,6 +1958,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	treeSpritesRitem->Geo = mGeometries["treeSpritesGeo"].get();
 	//step2
 	treeSpritesRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_POINTLIST;
+	treeSpritesRitem->Submesh = "points";
 	treeSpritesRitem->IndexCount = treeSpritesRitem->Geo->DrawArgs["points"].IndexCount;
 	treeSpritesRitem->StartIndexLocation = treeSpritesRitem->Geo->DrawArgs["points"].StartIndexLocation;
 	treeSpritesRitem->BaseVertexLocation = treeSpritesRitem->Geo->DrawArgs["points"].BaseVertexLocation;
@@ -1594,6 +1979,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemFront1->Mat = mMaterials["brickType1"].get();
 		wallRitemFront1->Geo = mGeometries["boxGeo"].get();
 		wallRitemFront1->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemFront1->Submesh = "wall";
 		wallRitemFront1->IndexCount = wallRitemFront1->Geo->DrawArgs["wall"].IndexCount;
 		wallRitemFront1->StartIndexLocation = wallRitemFront1->Geo->DrawArgs["wall"].StartIndexLocation;
 		wallRitemFront1->BaseVertexLocation = wallRitemFront1->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -1605,6 +1991,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemFront2->Mat = mMaterials["brickType1"].get();
 		wallRitemFront2->Geo = mGeometries["boxGeo"].get();
 		wallRitemFront2->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemFront2->Submesh = "wall";
 		wallRitemFront2->IndexCount = wallRitemFront2->Geo->DrawArgs["wall"].IndexCount;
 		wallRitemFront2->StartIndexLocation = wallRitemFront2->Geo->DrawArgs["wall"].StartIndexLocation;
 		wallRitemFront2->BaseVertexLocation = wallRitemFront2->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -1616,6 +2003,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemBack->Mat = mMaterials["brickType1"].get();
 		wallRitemBack->Geo = mGeometries["boxGeo"].get();
 		wallRitemBack->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemBack->Submesh = "wall";
 		wallRitemBack->IndexCount = wallRitemBack->Geo->DrawArgs["wall"].IndexCount;
 		wallRitemBack->StartIndexLocation = wallRitemBack->Geo->DrawArgs["wall"].StartIndexLocation;
 		wallRitemBack->BaseVertexLocation = wallRitemBack->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -1627,6 +2015,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemLeft->Mat = mMaterials["brickType1"].get();
 		wallRitemLeft->Geo = mGeometries["boxGeo"].get();
 		wallRitemLeft->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemLeft->Submesh = "wall";
 		wallRitemLeft->IndexCount = wallRitemLeft->Geo->DrawArgs["wall"].IndexCount;
 		wallRitemLeft->StartIndexLocation = wallRitemLeft->Geo->DrawArgs["wall"].StartIndexLocation;
 		wallRitemLeft->BaseVertexLocation = wallRitemLeft->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -1639,6 +2028,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemRight->Mat = mMaterials["brickType1"].get();
 		wallRitemRight->Geo = mGeometries["boxGeo"].get();
 		wallRitemRight->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemRight->Submesh = "wall";
 		wallRitemRight->IndexCount = wallRitemRight->Geo->DrawArgs["wall"].IndexCount;
 		wallRitemRight->StartIndexLocation = wallRitemRight->Geo->DrawArgs["wall"].StartIndexLocation;
 		wallRitemRight->BaseVertexLocation = wallRitemRight->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -1676,6 +2066,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemFront1FenceFront->Mat = mMaterials["wirefence"].get();
 		wallRitemFront1FenceFront->Geo = mGeometries["boxGeo"].get();
 		wallRitemFront1FenceFront->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemFront1FenceFront->Submesh = "box";
 		wallRitemFront1FenceFront->IndexCount = wallRitemFront1FenceFront->Geo->DrawArgs["box"].IndexCount;
 		wallRitemFront1FenceFront->StartIndexLocation = wallRitemFront1FenceFront->Geo->DrawArgs["box"].StartIndexLocation;
 		wallRitemFront1FenceFront->BaseVertexLocation = wallRitemFront1FenceFront->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1687,6 +2078,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemFront2FenceFront->Mat = mMaterials["wirefence"].get();
 		wallRitemFront2FenceFront->Geo = mGeometries["boxGeo"].get();
 		wallRitemFront2FenceFront->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemFront2FenceFront->Submesh = "box";
 		wallRitemFront2FenceFront->IndexCount = wallRitemFront2FenceFront->Geo->DrawArgs["box"].IndexCount;
 		wallRitemFront2FenceFront->StartIndexLocation = wallRitemFront2FenceFront->Geo->DrawArgs["box"].StartIndexLocation;
 		wallRitemFront2FenceFront->BaseVertexLocation = wallRitemFront2FenceFront->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1698,6 +2090,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemBackFenceFront->Mat = mMaterials["wirefence"].get();
 		wallRitemBackFenceFront->Geo = mGeometries["boxGeo"].get();
 		wallRitemBackFenceFront->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemBackFenceFront->Submesh = "box";
 		wallRitemBackFenceFront->IndexCount = wallRitemBackFenceFront->Geo->DrawArgs["box"].IndexCount;
 		wallRitemBackFenceFront->StartIndexLocation = wallRitemBackFenceFront->Geo->DrawArgs["box"].StartIndexLocation;
 		wallRitemBackFenceFront->BaseVertexLocation = wallRitemBackFenceFront->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1709,6 +2102,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemLeftFenceFront->Mat = mMaterials["wirefence"].get();
 		wallRitemLeftFenceFront->Geo = mGeometries["boxGeo"].get();
 		wallRitemLeftFenceFront->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemLeftFenceFront->Submesh = "box";
 		wallRitemLeftFenceFront->IndexCount = wallRitemLeftFenceFront->Geo->DrawArgs["box"].IndexCount;
 		wallRitemLeftFenceFront->StartIndexLocation = wallRitemLeftFenceFront->Geo->DrawArgs["box"].StartIndexLocation;
 		wallRitemLeftFenceFront->BaseVertexLocation = wallRitemLeftFenceFront->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1720,6 +2114,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemRightFenceFront->Mat = mMaterials["wirefence"].get();
 		wallRitemRightFenceFront->Geo = mGeometries["boxGeo"].get();
 		wallRitemRightFenceFront->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemRightFenceFront->Submesh = "box";
 		wallRitemRightFenceFront->IndexCount = wallRitemRightFenceFront->Geo->DrawArgs["box"].IndexCount;
 		wallRitemRightFenceFront->StartIndexLocation = wallRitemRightFenceFront->Geo->DrawArgs["box"].StartIndexLocation;
 		wallRitemRightFenceFront->BaseVertexLocation = wallRitemRightFenceFront->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1732,6 +2127,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemFront1FenceBack->Mat = mMaterials["wirefence"].get();
 		wallRitemFront1FenceBack->Geo = mGeometries["boxGeo"].get();
 		wallRitemFront1FenceBack->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemFront1FenceBack->Submesh = "box";
 		wallRitemFront1FenceBack->IndexCount = wallRitemFront1FenceBack->Geo->DrawArgs["box"].IndexCount;
 		wallRitemFront1FenceBack->StartIndexLocation = wallRitemFront1FenceBack->Geo->DrawArgs["box"].StartIndexLocation;
 		wallRitemFront1FenceBack->BaseVertexLocation = wallRitemFront1FenceBack->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1743,6 +2139,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemFront2FenceBack->Mat = mMaterials["wirefence"].get();
 		wallRitemFront2FenceBack->Geo = mGeometries["boxGeo"].get();
 		wallRitemFront2FenceBack->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemFront2FenceBack->Submesh = "box";
 		wallRitemFront2FenceBack->IndexCount = wallRitemFront2FenceBack->Geo->DrawArgs["box"].IndexCount;
 		wallRitemFront2FenceBack->StartIndexLocation = wallRitemFront2FenceBack->Geo->DrawArgs["box"].StartIndexLocation;
 		wallRitemFront2FenceBack->BaseVertexLocation = wallRitemFront2FenceBack->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1754,6 +2151,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemBackFenceBack->Mat = mMaterials["wirefence"].get();
 		wallRitemBackFenceBack->Geo = mGeometries["boxGeo"].get();
 		wallRitemBackFenceBack->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemBackFenceBack->Submesh = "box";
 		wallRitemBackFenceBack->IndexCount = wallRitemBackFenceBack->Geo->DrawArgs["box"].IndexCount;
 		wallRitemBackFenceBack->StartIndexLocation = wallRitemBackFenceBack->Geo->DrawArgs["box"].StartIndexLocation;
 		wallRitemBackFenceBack->BaseVertexLocation = wallRitemBackFenceBack->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1765,6 +2163,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemLeftFenceBack->Mat = mMaterials["wirefence"].get();
 		wallRitemLeftFenceBack->Geo = mGeometries["boxGeo"].get();
 		wallRitemLeftFenceBack->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemLeftFenceBack->Submesh = "box";
 		wallRitemLeftFenceBack->IndexCount = wallRitemLeftFenceBack->Geo->DrawArgs["box"].IndexCount;
 		wallRitemLeftFenceBack->StartIndexLocation = wallRitemLeftFenceBack->Geo->DrawArgs["box"].StartIndexLocation;
 		wallRitemLeftFenceBack->BaseVertexLocation = wallRitemLeftFenceBack->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1776,6 +2175,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemRightFenceBack->Mat = mMaterials["wirefence"].get();
 		wallRitemRightFenceBack->Geo = mGeometries["boxGeo"].get();
 		wallRitemRightFenceBack->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemRightFenceBack->Submesh = "box";
 		wallRitemRightFenceBack->IndexCount = wallRitemRightFenceBack->Geo->DrawArgs["box"].IndexCount;
 		wallRitemRightFenceBack->StartIndexLocation = wallRitemRightFenceBack->Geo->DrawArgs["box"].StartIndexLocation;
 		wallRitemRightFenceBack->BaseVertexLocation = wallRitemRightFenceBack->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1788,6 +2188,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemFront1FenceSide->Mat = mMaterials["wirefence"].get();
 		wallRitemFront1FenceSide->Geo = mGeometries["boxGeo"].get();
 		wallRitemFront1FenceSide->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemFront1FenceSide->Submesh = "box";
 		wallRitemFront1FenceSide->IndexCount = wallRitemFront1FenceSide->Geo->DrawArgs["box"].IndexCount;
 		wallRitemFront1FenceSide->StartIndexLocation = wallRitemFront1FenceSide->Geo->DrawArgs["box"].StartIndexLocation;
 		wallRitemFront1FenceSide->BaseVertexLocation = wallRitemFront1FenceSide->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1799,6 +2200,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallRitemFront2FenceSide->Mat = mMaterials["wirefence"].get();
 		wallRitemFront2FenceSide->Geo = mGeometries["boxGeo"].get();
 		wallRitemFront2FenceSide->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitemFront2FenceSide->Submesh = "box";
 		wallRitemFront2FenceSide->IndexCount = wallRitemFront2FenceSide->Geo->DrawArgs["box"].IndexCount;
 		wallRitemFront2FenceSide->StartIndexLocation = wallRitemFront2FenceSide->Geo->DrawArgs["box"].StartIndexLocation;
 		wallRitemFront2FenceSide->BaseVertexLocation = wallRitemFront2FenceSide->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1836,6 +2238,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarFLRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarFLRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarFLRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarFLRitem->Submesh = "wallPillar";
 		wallPillarFLRitem->IndexCount = wallPillarFLRitem->Geo->DrawArgs["wallPillar"].IndexCount;
 		wallPillarFLRitem->StartIndexLocation = wallPillarFLRitem->Geo->DrawArgs["wallPillar"].StartIndexLocation;
 		wallPillarFLRitem->BaseVertexLocation = wallPillarFLRitem->Geo->DrawArgs["wallPillar"].BaseVertexLocation;
@@ -1848,6 +2251,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarFRRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarFRRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarFRRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarFRRitem->Submesh = "wallPillar";
 		wallPillarFRRitem->IndexCount = wallPillarFRRitem->Geo->DrawArgs["wallPillar"].IndexCount;
 		wallPillarFRRitem->StartIndexLocation = wallPillarFRRitem->Geo->DrawArgs["wallPillar"].StartIndexLocation;
 		wallPillarFRRitem->BaseVertexLocation = wallPillarFRRitem->Geo->DrawArgs["wallPillar"].BaseVertexLocation;
@@ -1859,6 +2263,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarBLRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarBLRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarBLRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarBLRitem->Submesh = "wallPillar";
 		wallPillarBLRitem->IndexCount = wallPillarBLRitem->Geo->DrawArgs["wallPillar"].IndexCount;
 		wallPillarBLRitem->StartIndexLocation = wallPillarBLRitem->Geo->DrawArgs["wallPillar"].StartIndexLocation;
 		wallPillarBLRitem->BaseVertexLocation = wallPillarBLRitem->Geo->DrawArgs["wallPillar"].BaseVertexLocation;
@@ -1870,6 +2275,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarBRRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarBRRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarBRRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarBRRitem->Submesh = "wallPillar";
 		wallPillarBRRitem->IndexCount = wallPillarBRRitem->Geo->DrawArgs["wallPillar"].IndexCount;
 		wallPillarBRRitem->StartIndexLocation = wallPillarBRRitem->Geo->DrawArgs["wallPillar"].StartIndexLocation;
 		wallPillarBRRitem->BaseVertexLocation = wallPillarBRRitem->Geo->DrawArgs["wallPillar"].BaseVertexLocation;
@@ -1897,6 +2303,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarFLTopRitem->Mat = mMaterials["stone"].get();
 		wallPillarFLTopRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarFLTopRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarFLTopRitem->Submesh = "wallPillarTop";
 		wallPillarFLTopRitem->IndexCount = wallPillarFLTopRitem->Geo->DrawArgs["wallPillarTop"].IndexCount;
 		wallPillarFLTopRitem->StartIndexLocation = wallPillarFLTopRitem->Geo->DrawArgs["wallPillarTop"].StartIndexLocation;
 		wallPillarFLTopRitem->BaseVertexLocation = wallPillarFLTopRitem->Geo->DrawArgs["wallPillarTop"].BaseVertexLocation;
@@ -1908,6 +2315,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarFRTopRitem->Mat = mMaterials["stone"].get();
 		wallPillarFRTopRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarFRTopRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarFRTopRitem->Submesh = "wallPillarTop";
 		wallPillarFRTopRitem->IndexCount = wallPillarFRTopRitem->Geo->DrawArgs["wallPillarTop"].IndexCount;
 		wallPillarFRTopRitem->StartIndexLocation = wallPillarFRTopRitem->Geo->DrawArgs["wallPillarTop"].StartIndexLocation;
 		wallPillarFRTopRitem->BaseVertexLocation = wallPillarFRTopRitem->Geo->DrawArgs["wallPillarTop"].BaseVertexLocation;
@@ -1919,6 +2327,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarBLTopRitem->Mat = mMaterials["stone"].get();
 		wallPillarBLTopRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarBLTopRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarBLTopRitem->Submesh = "wallPillarTop";
 		wallPillarBLTopRitem->IndexCount = wallPillarBLTopRitem->Geo->DrawArgs["wallPillarTop"].IndexCount;
 		wallPillarBLTopRitem->StartIndexLocation = wallPillarBLTopRitem->Geo->DrawArgs["wallPillarTop"].StartIndexLocation;
 		wallPillarBLTopRitem->BaseVertexLocation = wallPillarBLTopRitem->Geo->DrawArgs["wallPillarTop"].BaseVertexLocation;
@@ -1930,6 +2339,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarBRTopRitem->Mat = mMaterials["stone"].get();
 		wallPillarBRTopRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarBRTopRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarBRTopRitem->Submesh = "wallPillarTop";
 		wallPillarBRTopRitem->IndexCount = wallPillarBRTopRitem->Geo->DrawArgs["wallPillarTop"].IndexCount;
 		wallPillarBRTopRitem->StartIndexLocation = wallPillarBRTopRitem->Geo->DrawArgs["wallPillarTop"].StartIndexLocation;
 		wallPillarBRTopRitem->BaseVertexLocation = wallPillarBRTopRitem->Geo->DrawArgs["wallPillarTop"].BaseVertexLocation;
@@ -1976,6 +2386,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarFLTopFLBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarFLTopFLBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarFLTopFLBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarFLTopFLBlockRitem->Submesh = "box";
 		wallPillarFLTopFLBlockRitem->IndexCount = wallPillarFLTopFLBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarFLTopFLBlockRitem->StartIndexLocation = wallPillarFLTopFLBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarFLTopFLBlockRitem->BaseVertexLocation = wallPillarFLTopFLBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1987,6 +2398,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarFLTopFRBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarFLTopFRBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarFLTopFRBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarFLTopFRBlockRitem->Submesh = "box";
 		wallPillarFLTopFRBlockRitem->IndexCount = wallPillarFLTopFRBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarFLTopFRBlockRitem->StartIndexLocation = wallPillarFLTopFRBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarFLTopFRBlockRitem->BaseVertexLocation = wallPillarFLTopFRBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1998,6 +2410,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarFLTopBLBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarFLTopBLBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarFLTopBLBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarFLTopBLBlockRitem->Submesh = "box";
 		wallPillarFLTopBLBlockRitem->IndexCount = wallPillarFLTopBLBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarFLTopBLBlockRitem->StartIndexLocation = wallPillarFLTopBLBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarFLTopBLBlockRitem->BaseVertexLocation = wallPillarFLTopBLBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2009,6 +2422,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarFLTopBRBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarFLTopBRBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarFLTopBRBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarFLTopBRBlockRitem->Submesh = "box";
 		wallPillarFLTopBRBlockRitem->IndexCount = wallPillarFLTopBRBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarFLTopBRBlockRitem->StartIndexLocation = wallPillarFLTopBRBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarFLTopBRBlockRitem->BaseVertexLocation = wallPillarFLTopBRBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2021,6 +2435,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarFRTopFLBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarFRTopFLBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarFRTopFLBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarFRTopFLBlockRitem->Submesh = "box";
 		wallPillarFRTopFLBlockRitem->IndexCount = wallPillarFRTopFLBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarFRTopFLBlockRitem->StartIndexLocation = wallPillarFRTopFLBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarFRTopFLBlockRitem->BaseVertexLocation = wallPillarFRTopFLBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2032,6 +2447,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarFRTopFRBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarFRTopFRBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarFRTopFRBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarFRTopFRBlockRitem->Submesh = "box";
 		wallPillarFRTopFRBlockRitem->IndexCount = wallPillarFRTopFRBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarFRTopFRBlockRitem->StartIndexLocation = wallPillarFRTopFRBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarFRTopFRBlockRitem->BaseVertexLocation = wallPillarFRTopFRBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2042,6 +2458,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarFRTopBLBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarFRTopBLBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarFRTopBLBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarFRTopBLBlockRitem->Submesh = "box";
 		wallPillarFRTopBLBlockRitem->IndexCount = wallPillarFRTopBLBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarFRTopBLBlockRitem->StartIndexLocation = wallPillarFRTopBLBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarFRTopBLBlockRitem->BaseVertexLocation = wallPillarFRTopBLBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2052,6 +2469,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarFRTopBRBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarFRTopBRBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarFRTopBRBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarFRTopBRBlockRitem->Submesh = "box";
 		wallPillarFRTopBRBlockRitem->IndexCount = wallPillarFRTopBRBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarFRTopBRBlockRitem->StartIndexLocation = wallPillarFRTopBRBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarFRTopBRBlockRitem->BaseVertexLocation = wallPillarFRTopBRBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2064,6 +2482,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarBLTopFLBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarBLTopFLBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarBLTopFLBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarBLTopFLBlockRitem->Submesh = "box";
 		wallPillarBLTopFLBlockRitem->IndexCount = wallPillarBLTopFLBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarBLTopFLBlockRitem->StartIndexLocation = wallPillarBLTopFLBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarBLTopFLBlockRitem->BaseVertexLocation = wallPillarBLTopFLBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2075,6 +2494,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarBLTopFRBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarBLTopFRBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarBLTopFRBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarBLTopFRBlockRitem->Submesh = "box";
 		wallPillarBLTopFRBlockRitem->IndexCount = wallPillarBLTopFRBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarBLTopFRBlockRitem->StartIndexLocation = wallPillarBLTopFRBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarBLTopFRBlockRitem->BaseVertexLocation = wallPillarBLTopFRBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2085,6 +2505,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarBLTopBLBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarBLTopBLBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarBLTopBLBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarBLTopBLBlockRitem->Submesh = "box";
 		wallPillarBLTopBLBlockRitem->IndexCount = wallPillarBLTopBLBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarBLTopBLBlockRitem->StartIndexLocation = wallPillarBLTopBLBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarBLTopBLBlockRitem->BaseVertexLocation = wallPillarBLTopBLBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2095,6 +2516,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarBLTopBRBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarBLTopBRBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarBLTopBRBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarBLTopBRBlockRitem->Submesh = "box";
 		wallPillarBLTopBRBlockRitem->IndexCount = wallPillarBLTopBRBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarBLTopBRBlockRitem->StartIndexLocation = wallPillarBLTopBRBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarBLTopBRBlockRitem->BaseVertexLocation = wallPillarBLTopBRBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2107,6 +2529,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarBRTopFLBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarBRTopFLBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarBRTopFLBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarBRTopFLBlockRitem->Submesh = "box";
 		wallPillarBRTopFLBlockRitem->IndexCount = wallPillarBRTopFLBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarBRTopFLBlockRitem->StartIndexLocation = wallPillarBRTopFLBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarBRTopFLBlockRitem->BaseVertexLocation = wallPillarBRTopFLBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2118,6 +2541,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarBRTopFRBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarBRTopFRBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarBRTopFRBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarBRTopFRBlockRitem->Submesh = "box";
 		wallPillarBRTopFRBlockRitem->IndexCount = wallPillarBRTopFRBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarBRTopFRBlockRitem->StartIndexLocation = wallPillarBRTopFRBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarBRTopFRBlockRitem->BaseVertexLocation = wallPillarBRTopFRBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2128,6 +2552,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarBRTopBLBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarBRTopBLBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarBRTopBLBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarBRTopBLBlockRitem->Submesh = "box";
 		wallPillarBRTopBLBlockRitem->IndexCount = wallPillarBRTopBLBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarBRTopBLBlockRitem->StartIndexLocation = wallPillarBRTopBLBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarBRTopBLBlockRitem->BaseVertexLocation = wallPillarBRTopBLBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2138,6 +2563,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		wallPillarBRTopBRBlockRitem->Mat = mMaterials["brickType2"].get();
 		wallPillarBRTopBRBlockRitem->Geo = mGeometries["boxGeo"].get();
 		wallPillarBRTopBRBlockRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallPillarBRTopBRBlockRitem->Submesh = "box";
 		wallPillarBRTopBRBlockRitem->IndexCount = wallPillarBRTopBRBlockRitem->Geo->DrawArgs["box"].IndexCount;
 		wallPillarBRTopBRBlockRitem->StartIndexLocation = wallPillarBRTopBRBlockRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallPillarBRTopBRBlockRitem->BaseVertexLocation = wallPillarBRTopBRBlockRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2183,6 +2609,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		centerPillarFrontRitem->Mat = mMaterials["brickType2"].get();
 		centerPillarFrontRitem->Geo = mGeometries["boxGeo"].get();
 		centerPillarFrontRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		centerPillarFrontRitem->Submesh = "fountainPillar";
 		centerPillarFrontRitem->IndexCount = centerPillarFrontRitem->Geo->DrawArgs["fountainPillar"].IndexCount;
 		centerPillarFrontRitem->StartIndexLocation = centerPillarFrontRitem->Geo->DrawArgs["fountainPillar"].StartIndexLocation;
 		centerPillarFrontRitem->BaseVertexLocation = centerPillarFrontRitem->Geo->DrawArgs["fountainPillar"].BaseVertexLocation;
@@ -2194,6 +2621,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		centerPillarBackRitem->Mat = mMaterials["brickType2"].get();
 		centerPillarBackRitem->Geo = mGeometries["boxGeo"].get();
 		centerPillarBackRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		centerPillarBackRitem->Submesh = "fountainPillar";
 		centerPillarBackRitem->IndexCount = centerPillarBackRitem->Geo->DrawArgs["fountainPillar"].IndexCount;
 		centerPillarBackRitem->StartIndexLocation = centerPillarBackRitem->Geo->DrawArgs["fountainPillar"].StartIndexLocation;
 		centerPillarBackRitem->BaseVertexLocation = centerPillarBackRitem->Geo->DrawArgs["fountainPillar"].BaseVertexLocation;
@@ -2205,6 +2633,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		centerPillarLeftRitem->Mat = mMaterials["brickType2"].get();
 		centerPillarLeftRitem->Geo = mGeometries["boxGeo"].get();
 		centerPillarLeftRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		centerPillarLeftRitem->Submesh = "fountainPillar";
 		centerPillarLeftRitem->IndexCount = centerPillarLeftRitem->Geo->DrawArgs["fountainPillar"].IndexCount;
 		centerPillarLeftRitem->StartIndexLocation = centerPillarLeftRitem->Geo->DrawArgs["fountainPillar"].StartIndexLocation;
 		centerPillarLeftRitem->BaseVertexLocation = centerPillarLeftRitem->Geo->DrawArgs["fountainPillar"].BaseVertexLocation;
@@ -2216,6 +2645,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		centerPillarRightRitem->Mat = mMaterials["brickType2"].get();
 		centerPillarRightRitem->Geo = mGeometries["boxGeo"].get();
 		centerPillarRightRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		centerPillarRightRitem->Submesh = "fountainPillar";
 		centerPillarRightRitem->IndexCount = centerPillarRightRitem->Geo->DrawArgs["fountainPillar"].IndexCount;
 		centerPillarRightRitem->StartIndexLocation = centerPillarRightRitem->Geo->DrawArgs["fountainPillar"].StartIndexLocation;
 		centerPillarRightRitem->BaseVertexLocation = centerPillarRightRitem->Geo->DrawArgs["fountainPillar"].BaseVertexLocation;
@@ -2244,6 +2674,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		centerPillarFrontTopRitem->Mat = mMaterials["stone"].get();
 		centerPillarFrontTopRitem->Geo = mGeometries["boxGeo"].get();
 		centerPillarFrontTopRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		centerPillarFrontTopRitem->Submesh = "fountainPillarTop";
 		centerPillarFrontTopRitem->IndexCount = centerPillarFrontTopRitem->Geo->DrawArgs["fountainPillarTop"].IndexCount;
 		centerPillarFrontTopRitem->StartIndexLocation = centerPillarFrontTopRitem->Geo->DrawArgs["fountainPillarTop"].StartIndexLocation;
 		centerPillarFrontTopRitem->BaseVertexLocation = centerPillarFrontTopRitem->Geo->DrawArgs["fountainPillarTop"].BaseVertexLocation;
@@ -2255,6 +2686,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		centerPillarBackTopRitem->Mat = mMaterials["stone"].get();
 		centerPillarBackTopRitem->Geo = mGeometries["boxGeo"].get();
 		centerPillarBackTopRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		centerPillarBackTopRitem->Submesh = "fountainPillarTop";
 		centerPillarBackTopRitem->IndexCount = centerPillarBackTopRitem->Geo->DrawArgs["fountainPillarTop"].IndexCount;
 		centerPillarBackTopRitem->StartIndexLocation = centerPillarBackTopRitem->Geo->DrawArgs["fountainPillarTop"].StartIndexLocation;
 		centerPillarBackTopRitem->BaseVertexLocation = centerPillarBackTopRitem->Geo->DrawArgs["fountainPillarTop"].BaseVertexLocation;
@@ -2266,6 +2698,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		centerPillarLeftTopRitem->Mat = mMaterials["stone"].get();
 		centerPillarLeftTopRitem->Geo = mGeometries["boxGeo"].get();
 		centerPillarLeftTopRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		centerPillarLeftTopRitem->Submesh = "fountainPillarTop";
 		centerPillarLeftTopRitem->IndexCount = centerPillarLeftTopRitem->Geo->DrawArgs["fountainPillarTop"].IndexCount;
 		centerPillarLeftTopRitem->StartIndexLocation = centerPillarLeftTopRitem->Geo->DrawArgs["fountainPillarTop"].StartIndexLocation;
 		centerPillarLeftTopRitem->BaseVertexLocation = centerPillarLeftTopRitem->Geo->DrawArgs["fountainPillarTop"].BaseVertexLocation;
@@ -2277,6 +2710,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		centerPillarRightTopRitem->Mat = mMaterials["stone"].get();
 		centerPillarRightTopRitem->Geo = mGeometries["boxGeo"].get();
 		centerPillarRightTopRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		centerPillarRightTopRitem->Submesh = "fountainPillarTop";
 		centerPillarRightTopRitem->IndexCount = centerPillarRightTopRitem->Geo->DrawArgs["fountainPillarTop"].IndexCount;
 		centerPillarRightTopRitem->StartIndexLocation = centerPillarRightTopRitem->Geo->DrawArgs["fountainPillarTop"].StartIndexLocation;
 		centerPillarRightTopRitem->BaseVertexLocation = centerPillarRightTopRitem->Geo->DrawArgs["fountainPillarTop"].BaseVertexLocation;
@@ -2306,6 +2740,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		door->Mat = mMaterials["wood"].get();
 		door->Geo = mGeometries["boxGeo"].get();
 		door->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		door->Submesh = "box";
 		door->IndexCount = door->Geo->DrawArgs["box"].IndexCount;
 		door->StartIndexLocation = door->Geo->DrawArgs["box"].StartIndexLocation;
 		door->BaseVertexLocation = door->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2318,6 +2753,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		leftAnchor->Mat = mMaterials["stone"].get();
 		leftAnchor->Geo = mGeometries["boxGeo"].get();
 		leftAnchor->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		leftAnchor->Submesh = "wallPillar";
 		leftAnchor->IndexCount = leftAnchor->Geo->DrawArgs["wallPillar"].IndexCount;
 		leftAnchor->StartIndexLocation = leftAnchor->Geo->DrawArgs["wallPillar"].StartIndexLocation;
 		leftAnchor->BaseVertexLocation = leftAnchor->Geo->DrawArgs["wallPillar"].BaseVertexLocation;
@@ -2328,6 +2764,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		rightAnchor->Mat = mMaterials["stone"].get();
 		rightAnchor->Geo = mGeometries["boxGeo"].get();
 		rightAnchor->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		rightAnchor->Submesh = "wallPillar";
 		rightAnchor->IndexCount = rightAnchor->Geo->DrawArgs["wallPillar"].IndexCount;
 		rightAnchor->StartIndexLocation = rightAnchor->Geo->DrawArgs["wallPillar"].StartIndexLocation;
 		rightAnchor->BaseVertexLocation = rightAnchor->Geo->DrawArgs["wallPillar"].BaseVertexLocation;
@@ -2350,6 +2787,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		floor->Mat = mMaterials["tile"].get();
 		floor->Geo = mGeometries["boxGeo"].get();
 		floor->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		floor->Submesh = "box";
 		floor->IndexCount = floor->Geo->DrawArgs["box"].IndexCount;
 		floor->StartIndexLocation = floor->Geo->DrawArgs["box"].StartIndexLocation;
 		floor->BaseVertexLocation = floor->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -2377,6 +2815,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWallLeft->Mat = mMaterials["hedge"].get();
 		mazeWallLeft->Geo = mGeometries["boxGeo"].get();
 		mazeWallLeft->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWallLeft->Submesh = "wall";
 		mazeWallLeft->IndexCount = mazeWallLeft->Geo->DrawArgs["wall"].IndexCount;
 		mazeWallLeft->StartIndexLocation = mazeWallLeft->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWallLeft->BaseVertexLocation = mazeWallLeft->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2387,6 +2826,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWallRight->Mat = mMaterials["hedge"].get();
 		mazeWallRight->Geo = mGeometries["boxGeo"].get();
 		mazeWallRight->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWallRight->Submesh = "wall";
 		mazeWallRight->IndexCount = mazeWallRight->Geo->DrawArgs["wall"].IndexCount;
 		mazeWallRight->StartIndexLocation = mazeWallRight->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWallRight->BaseVertexLocation = mazeWallRight->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2397,6 +2837,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWallFrontLeft->Mat = mMaterials["hedge"].get();
 		mazeWallFrontLeft->Geo = mGeometries["boxGeo"].get();
 		mazeWallFrontLeft->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWallFrontLeft->Submesh = "wall";
 		mazeWallFrontLeft->IndexCount = mazeWallFrontLeft->Geo->DrawArgs["wall"].IndexCount;
 		mazeWallFrontLeft->StartIndexLocation = mazeWallFrontLeft->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWallFrontLeft->BaseVertexLocation = mazeWallFrontLeft->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2407,6 +2848,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWallFrontRight->Mat = mMaterials["hedge"].get();
 		mazeWallFrontRight->Geo = mGeometries["boxGeo"].get();
 		mazeWallFrontRight->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWallFrontRight->Submesh = "wall";
 		mazeWallFrontRight->IndexCount = mazeWallFrontRight->Geo->DrawArgs["wall"].IndexCount;
 		mazeWallFrontRight->StartIndexLocation = mazeWallFrontRight->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWallFrontRight->BaseVertexLocation = mazeWallFrontRight->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2417,6 +2859,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWallBackLeft->Mat = mMaterials["hedge"].get();
 		mazeWallBackLeft->Geo = mGeometries["boxGeo"].get();
 		mazeWallBackLeft->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWallBackLeft->Submesh = "wall";
 		mazeWallBackLeft->IndexCount = mazeWallBackLeft->Geo->DrawArgs["wall"].IndexCount;
 		mazeWallBackLeft->StartIndexLocation = mazeWallBackLeft->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWallBackLeft->BaseVertexLocation = mazeWallBackLeft->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2427,6 +2870,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWallBackRight->Mat = mMaterials["hedge"].get();
 		mazeWallBackRight->Geo = mGeometries["boxGeo"].get();
 		mazeWallBackRight->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWallBackRight->Submesh = "wall";
 		mazeWallBackRight->IndexCount = mazeWallBackRight->Geo->DrawArgs["wall"].IndexCount;
 		mazeWallBackRight->StartIndexLocation = mazeWallBackRight->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWallBackRight->BaseVertexLocation = mazeWallBackRight->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2437,6 +2881,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWallCastleBack->Mat = mMaterials["hedge"].get();
 		mazeWallCastleBack->Geo = mGeometries["boxGeo"].get();
 		mazeWallCastleBack->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWallCastleBack->Submesh = "wall";
 		mazeWallCastleBack->IndexCount = mazeWallCastleBack->Geo->DrawArgs["wall"].IndexCount;
 		mazeWallCastleBack->StartIndexLocation = mazeWallCastleBack->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWallCastleBack->BaseVertexLocation = mazeWallCastleBack->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2478,6 +2923,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWall1->Mat = mMaterials["hedge"].get();
 		mazeWall1->Geo = mGeometries["boxGeo"].get();
 		mazeWall1->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWall1->Submesh = "wall";
 		mazeWall1->IndexCount = mazeWall1->Geo->DrawArgs["wall"].IndexCount;
 		mazeWall1->StartIndexLocation = mazeWall1->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWall1->BaseVertexLocation = mazeWall1->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2488,6 +2934,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWall2->Mat = mMaterials["hedge"].get();
 		mazeWall2->Geo = mGeometries["boxGeo"].get();
 		mazeWall2->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWall2->Submesh = "wall";
 		mazeWall2->IndexCount = mazeWall2->Geo->DrawArgs["wall"].IndexCount;
 		mazeWall2->StartIndexLocation = mazeWall2->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWall2->BaseVertexLocation = mazeWall2->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2498,6 +2945,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWall3->Mat = mMaterials["hedge"].get();
 		mazeWall3->Geo = mGeometries["boxGeo"].get();
 		mazeWall3->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWall3->Submesh = "wall";
 		mazeWall3->IndexCount = mazeWall3->Geo->DrawArgs["wall"].IndexCount;
 		mazeWall3->StartIndexLocation = mazeWall3->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWall3->BaseVertexLocation = mazeWall3->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2508,6 +2956,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWall4->Mat = mMaterials["hedge"].get();
 		mazeWall4->Geo = mGeometries["boxGeo"].get();
 		mazeWall4->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWall4->Submesh = "wall";
 		mazeWall4->IndexCount = mazeWall4->Geo->DrawArgs["wall"].IndexCount;
 		mazeWall4->StartIndexLocation = mazeWall4->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWall4->BaseVertexLocation = mazeWall4->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2519,6 +2968,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWall5->Mat = mMaterials["hedge"].get();
 		mazeWall5->Geo = mGeometries["boxGeo"].get();
 		mazeWall5->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWall5->Submesh = "wall";
 		mazeWall5->IndexCount = mazeWall5->Geo->DrawArgs["wall"].IndexCount;
 		mazeWall5->StartIndexLocation = mazeWall5->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWall5->BaseVertexLocation = mazeWall5->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2529,6 +2979,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWall6->Mat = mMaterials["hedge"].get();
 		mazeWall6->Geo = mGeometries["boxGeo"].get();
 		mazeWall6->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWall6->Submesh = "wall";
 		mazeWall6->IndexCount = mazeWall6->Geo->DrawArgs["wall"].IndexCount;
 		mazeWall6->StartIndexLocation = mazeWall6->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWall6->BaseVertexLocation = mazeWall6->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2539,6 +2990,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWall7->Mat = mMaterials["hedge"].get();
 		mazeWall7->Geo = mGeometries["boxGeo"].get();
 		mazeWall7->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWall7->Submesh = "wall";
 		mazeWall7->IndexCount = mazeWall7->Geo->DrawArgs["wall"].IndexCount;
 		mazeWall7->StartIndexLocation = mazeWall7->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWall7->BaseVertexLocation = mazeWall7->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2549,6 +3001,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWall8->Mat = mMaterials["hedge"].get();
 		mazeWall8->Geo = mGeometries["boxGeo"].get();
 		mazeWall8->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWall8->Submesh = "wall";
 		mazeWall8->IndexCount = mazeWall8->Geo->DrawArgs["wall"].IndexCount;
 		mazeWall8->StartIndexLocation = mazeWall8->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWall8->BaseVertexLocation = mazeWall8->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2559,6 +3012,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWall9->Mat = mMaterials["hedge"].get();
 		mazeWall9->Geo = mGeometries["boxGeo"].get();
 		mazeWall9->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWall9->Submesh = "wall";
 		mazeWall9->IndexCount = mazeWall9->Geo->DrawArgs["wall"].IndexCount;
 		mazeWall9->StartIndexLocation = mazeWall9->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWall9->BaseVertexLocation = mazeWall9->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2569,6 +3023,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWall10->Mat = mMaterials["hedge"].get();
 		mazeWall10->Geo = mGeometries["boxGeo"].get();
 		mazeWall10->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWall10->Submesh = "wall";
 		mazeWall10->IndexCount = mazeWall10->Geo->DrawArgs["wall"].IndexCount;
 		mazeWall10->StartIndexLocation = mazeWall10->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWall10->BaseVertexLocation = mazeWall10->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2579,6 +3034,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWall11->Mat = mMaterials["hedge"].get();
 		mazeWall11->Geo = mGeometries["boxGeo"].get();
 		mazeWall11->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWall11->Submesh = "wall";
 		mazeWall11->IndexCount = mazeWall11->Geo->DrawArgs["wall"].IndexCount;
 		mazeWall11->StartIndexLocation = mazeWall11->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWall11->BaseVertexLocation = mazeWall11->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2589,6 +3045,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWall12->Mat = mMaterials["hedge"].get();
 		mazeWall12->Geo = mGeometries["boxGeo"].get();
 		mazeWall12->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWall12->Submesh = "wall";
 		mazeWall12->IndexCount = mazeWall12->Geo->DrawArgs["wall"].IndexCount;
 		mazeWall12->StartIndexLocation = mazeWall12->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWall12->BaseVertexLocation = mazeWall12->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2599,6 +3056,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWall13->Mat = mMaterials["hedge"].get();
 		mazeWall13->Geo = mGeometries["boxGeo"].get();
 		mazeWall13->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWall13->Submesh = "wall";
 		mazeWall13->IndexCount = mazeWall13->Geo->DrawArgs["wall"].IndexCount;
 		mazeWall13->StartIndexLocation = mazeWall13->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWall13->BaseVertexLocation = mazeWall13->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2609,6 +3067,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeWall14->Mat = mMaterials["hedge"].get();
 		mazeWall14->Geo = mGeometries["boxGeo"].get();
 		mazeWall14->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeWall14->Submesh = "wall";
 		mazeWall14->IndexCount = mazeWall14->Geo->DrawArgs["wall"].IndexCount;
 		mazeWall14->StartIndexLocation = mazeWall14->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeWall14->BaseVertexLocation = mazeWall14->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2658,6 +3117,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall1->Mat = mMaterials["hedge"].get();
 		mazeVertWall1->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall1->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall1->Submesh = "wall";
 		mazeVertWall1->IndexCount = mazeVertWall1->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall1->StartIndexLocation = mazeVertWall1->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall1->BaseVertexLocation = mazeVertWall1->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2668,6 +3128,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall2->Mat = mMaterials["hedge"].get();
 		mazeVertWall2->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall2->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall2->Submesh = "wall";
 		mazeVertWall2->IndexCount = mazeVertWall2->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall2->StartIndexLocation = mazeVertWall2->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall2->BaseVertexLocation = mazeVertWall2->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2678,6 +3139,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall3->Mat = mMaterials["hedge"].get();
 		mazeVertWall3->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall3->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall3->Submesh = "wall";
 		mazeVertWall3->IndexCount = mazeVertWall3->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall3->StartIndexLocation = mazeVertWall3->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall3->BaseVertexLocation = mazeVertWall3->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2688,6 +3150,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall4->Mat = mMaterials["hedge"].get();
 		mazeVertWall4->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall4->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall4->Submesh = "wall";
 		mazeVertWall4->IndexCount = mazeVertWall4->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall4->StartIndexLocation = mazeVertWall4->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall4->BaseVertexLocation = mazeVertWall4->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2698,6 +3161,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall5->Mat = mMaterials["hedge"].get();
 		mazeVertWall5->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall5->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall5->Submesh = "wall";
 		mazeVertWall5->IndexCount = mazeVertWall5->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall5->StartIndexLocation = mazeVertWall5->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall5->BaseVertexLocation = mazeVertWall5->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2708,6 +3172,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall6->Mat = mMaterials["hedge"].get();
 		mazeVertWall6->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall6->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall6->Submesh = "wall";
 		mazeVertWall6->IndexCount = mazeVertWall6->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall6->StartIndexLocation = mazeVertWall6->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall6->BaseVertexLocation = mazeVertWall6->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2718,6 +3183,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall7->Mat = mMaterials["hedge"].get();
 		mazeVertWall7->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall7->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall7->Submesh = "wall";
 		mazeVertWall7->IndexCount = mazeVertWall7->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall7->StartIndexLocation = mazeVertWall7->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall7->BaseVertexLocation = mazeVertWall7->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2728,6 +3194,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall8->Mat = mMaterials["hedge"].get();
 		mazeVertWall8->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall8->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall8->Submesh = "wall";
 		mazeVertWall8->IndexCount = mazeVertWall8->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall8->StartIndexLocation = mazeVertWall8->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall8->BaseVertexLocation = mazeVertWall8->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2738,6 +3205,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall9->Mat = mMaterials["hedge"].get();
 		mazeVertWall9->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall9->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall9->Submesh = "wall";
 		mazeVertWall9->IndexCount = mazeVertWall9->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall9->StartIndexLocation = mazeVertWall9->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall9->BaseVertexLocation = mazeVertWall9->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2748,6 +3216,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall10->Mat = mMaterials["hedge"].get();
 		mazeVertWall10->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall10->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall10->Submesh = "wall";
 		mazeVertWall10->IndexCount = mazeVertWall10->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall10->StartIndexLocation = mazeVertWall10->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall10->BaseVertexLocation = mazeVertWall10->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2758,6 +3227,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall11->Mat = mMaterials["hedge"].get();
 		mazeVertWall11->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall11->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall11->Submesh = "wall";
 		mazeVertWall11->IndexCount = mazeVertWall11->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall11->StartIndexLocation = mazeVertWall11->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall11->BaseVertexLocation = mazeVertWall11->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2768,6 +3238,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall12->Mat = mMaterials["hedge"].get();
 		mazeVertWall12->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall12->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall12->Submesh = "wall";
 		mazeVertWall12->IndexCount = mazeVertWall12->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall12->StartIndexLocation = mazeVertWall12->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall12->BaseVertexLocation = mazeVertWall12->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2778,6 +3249,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall13->Mat = mMaterials["hedge"].get();
 		mazeVertWall13->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall13->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall13->Submesh = "wall";
 		mazeVertWall13->IndexCount = mazeVertWall13->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall13->StartIndexLocation = mazeVertWall13->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall13->BaseVertexLocation = mazeVertWall13->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2788,6 +3260,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall14->Mat = mMaterials["hedge"].get();
 		mazeVertWall14->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall14->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall14->Submesh = "wall";
 		mazeVertWall14->IndexCount = mazeVertWall14->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall14->StartIndexLocation = mazeVertWall14->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall14->BaseVertexLocation = mazeVertWall14->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2798,6 +3271,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall15->Mat = mMaterials["hedge"].get();
 		mazeVertWall15->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall15->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall15->Submesh = "wall";
 		mazeVertWall15->IndexCount = mazeVertWall15->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall15->StartIndexLocation = mazeVertWall15->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall15->BaseVertexLocation = mazeVertWall15->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2808,6 +3282,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall16->Mat = mMaterials["hedge"].get();
 		mazeVertWall16->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall16->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall16->Submesh = "wall";
 		mazeVertWall16->IndexCount = mazeVertWall16->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall16->StartIndexLocation = mazeVertWall16->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall16->BaseVertexLocation = mazeVertWall16->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2818,6 +3293,7 @@ void TreeBillboardsApp::BuildRenderItems()
 		mazeVertWall17->Mat = mMaterials["hedge"].get();
 		mazeVertWall17->Geo = mGeometries["boxGeo"].get();
 		mazeVertWall17->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mazeVertWall17->Submesh = "wall";
 		mazeVertWall17->IndexCount = mazeVertWall17->Geo->DrawArgs["wall"].IndexCount;
 		mazeVertWall17->StartIndexLocation = mazeVertWall17->Geo->DrawArgs["wall"].StartIndexLocation;
 		mazeVertWall17->BaseVertexLocation = mazeVertWall17->Geo->DrawArgs["wall"].BaseVertexLocation;
@@ -2851,9 +3327,40 @@ void TreeBillboardsApp::BuildRenderItems()
     mAllRitems.push_back(std::move(gridRitem));
 	mAllRitems.push_back(std::move(centerFountainRitem));
 	mAllRitems.push_back(std::move(treeSpritesRitem));
+
+	// Give every item that draws a whole boxGeo shape that shape's meshlets and levels
+	// of detail, looked up by the name of the submesh it was built from.  An item that
+	// draws only part of a shape keeps drawing its own range.
+	auto boxGeo = mGeometries["boxGeo"].get();
+	for(auto& ri : mAllRitems)
+	{
+		if(ri->Geo != boxGeo)
+			continue;
+
+		auto arg = boxGeo->DrawArgs.find(ri->Submesh);
+		if(arg == boxGeo->DrawArgs.end())
+			continue;
+
+		const SubmeshGeometry& submesh = arg->second;
+		if(ri->IndexCount != submesh.IndexCount ||
+			ri->StartIndexLocation != submesh.StartIndexLocation ||
+			ri->BaseVertexLocation != submesh.BaseVertexLocation)
+			continue;
+
+		auto meshlets = mMeshlets.find(ri->Submesh);
+		if(meshlets != mMeshlets.end())
+		{
+			ri->Clusters = &meshlets->second;
+			Meshlets::BoundingSphere(meshlets->second, ri->ClustersCenter, ri->ClustersRadius);
+		}
+
+		auto lods = mLods.find(ri->Submesh);
+		if(lods != mLods.end())
+			ri->Lods = &lods->second;
+	}
 }
 
-void TreeBillboardsApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
+void TreeBillboardsApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems, bool cullBackfaces)
 {
     UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
     UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
@@ -2861,6 +3368,12 @@ void TreeBillboardsApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, cons
 	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
 	auto matCB = mCurrFrameResource->MaterialCB->Resource();
 
+	XMMATRIX viewProj = XMMatrixMultiply(mCamera.GetView(), mCamera.GetProj());
+	XMVECTOR eyePos = mCamera.GetPosition();
+
+	// Pixels covered by one world unit at distance 1.
+	float pixelsPerUnit = 0.5f*mClientHeight*mCamera.GetProj4x4f()._22;
+
     // For each render item...
     for(size_t i = 0; i < ritems.size(); ++i)
     {
@@ -2881,10 +3394,113 @@ void TreeBillboardsApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, cons
         cmdList->SetGraphicsRootConstantBufferView(1, objCBAddress);
         cmdList->SetGraphicsRootConstantBufferView(3, matCBAddress);
 
-        cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		if(ri->Clusters == nullptr)
+		{
+			cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+			continue;
+		}
+
+		// Cull in the item's object space, where the meshlet bounds live.
+		XMMATRIX world = XMLoadFloat4x4(&ri->World);
+		Meshlets::CullParams cull = Meshlets::MakeCullParams(world, viewProj, eyePos, cullBackfaces);
+
+		if(ri->Lods != nullptr)
+		{
+			// A simplified level is drawn whole, so the item is culled as a whole.
+			if(!Meshlets::IsSphereVisible(ri->ClustersCenter, ri->ClustersRadius, cull))
+				continue;
+
+			const XMFLOAT4X4& w = ri->World;
+			float scale = std::sqrt(std::max({
+				w._11*w._11 + w._12*w._12 + w._13*w._13,
+				w._21*w._21 + w._22*w._22 + w._23*w._23,
+				w._31*w._31 + w._32*w._32 + w._33*w._33 }));
+			float distance = XMVectorGetX(XMVector3Length(XMVectorSet(w._41, w._42, w._43, 1.0f) - eyePos));
+
+			size_t level = MeshSimplifier::SelectLod(*ri->Lods, scale, distance, pixelsPerUnit, mLodPixelError);
+			if(level > 0)
+			{
+				const MeshSimplifier::Lod& lod = (*ri->Lods)[level];
+				cmdList->DrawIndexedInstanced(lod.IndexCount, 1, ri->StartIndexLocation + lod.IndexStart, ri->BaseVertexLocation, 0);
+				continue;
+			}
+		}
+
+		Meshlets::Cull(*ri->Clusters, cull, mVisibleRanges);
+
+		for(const auto& range : mVisibleRanges)
+			cmdList->DrawIndexedInstanced(range.Count, 1, ri->StartIndexLocation + range.Start, ri->BaseVertexLocation, 0);
     }
 }
 
+void TreeBillboardsApp::DrawWaves(ID3D12GraphicsCommandList* cmdList)
+{
+	auto ri = mWavesRitem;
+
+	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
+
+	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
+	auto matCB = mCurrFrameResource->MaterialCB->Resource();
+
+	// The height-only shader builds its vertices from SV_VertexID and binds no vertex buffer.
+	if(!mWavesHeightOnly)
+		cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+	cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+	cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+
+	cmdList->SetGraphicsRootDescriptorTable(0, tex);
+	cmdList->SetGraphicsRootConstantBufferView(1, objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex*objCBByteSize);
+	cmdList->SetGraphicsRootConstantBufferView(3, matCB->GetGPUVirtualAddress() + ri->Mat->MatCBIndex*matCBByteSize);
+
+	if(mWavesHeightOnly)
+	{
+		// The water vertex shader reads the heights and grid layout from root slots 4 and 5.
+		struct
+		{
+			UINT NumRows;
+			UINT NumCols;
+			float SpatialStep;
+			UINT BaseVertex;
+		} waterGrid = { (UINT)mWaves->RowCount(), (UINT)mWaves->ColumnCount(), mWaves->SpatialStep(), 0 };
+
+		cmdList->SetPipelineState(mPSOs["waterHeights"].Get());
+		cmdList->SetGraphicsRootShaderResourceView(4, mCurrFrameResource->WavesHeightVB->Resource()->GetGPUVirtualAddress());
+		cmdList->SetGraphicsRoot32BitConstants(5, 4, &waterGrid, 0);
+	}
+	else
+	{
+		cmdList->SetPipelineState(mPSOs["transparent"].Get());
+	}
+
+	// The water's world matrix is the identity, so the chunk bounds are already in world space.
+	BoundingFrustum frustum;
+	BoundingFrustum::CreateFromMatrix(frustum, mCamera.GetProj());
+	XMMATRIX view = mCamera.GetView();
+	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+	frustum.Transform(frustum, invView);
+
+	for(const auto& chunk : mWavesChunks)
+	{
+		if(frustum.Contains(chunk.Bounds) == DirectX::DISJOINT)
+			continue;
+
+		if(mWavesHeightOnly)
+		{
+			// SV_VertexID does not include the base vertex, so the shader adds it itself.
+			cmdList->SetGraphicsRoot32BitConstant(5, (UINT)chunk.BaseVertexLocation, 3);
+			cmdList->DrawIndexedInstanced(chunk.IndexCount, 1, chunk.StartIndexLocation, 0, 0);
+		}
+		else
+		{
+			cmdList->DrawIndexedInstanced(chunk.IndexCount, 1, chunk.StartIndexLocation, chunk.BaseVertexLocation, 0);
+		}
+	}
+}
+
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> TreeBillboardsApp::GetStaticSamplers()
 {
 	// Applications usually only need a handful of samplers.  So just define them all up front